@@ -0,0 +1,96 @@
+#ifndef _CARENDER_BENCH_HPP_INCLUDED
+#define _CARENDER_BENCH_HPP_INCLUDED
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace car
+{
+namespace bench
+{
+
+typedef void (*benchmark)(std::ostream &output);
+
+/**
+* Get the number of heap allocations made by the process so far.
+*/
+size_t Allocations();
+
+/**
+* Returns the registered benchmarks.
+*/
+inline std::vector<std::pair<std::string, benchmark>> &Benchmarks()
+{
+    static std::vector<std::pair<std::string, benchmark>> benchmarks;
+    return benchmarks;
+}
+
+/**
+* Registers a benchmark at static initialization time.
+*/
+class Registrar
+{
+public:
+    Registrar(const std::string &name, benchmark function)
+    {
+        Benchmarks().push_back(std::make_pair(name, function));
+    }
+};
+
+#define BENCHMARK(name, function) static car::bench::Registrar registrar_##function(name, function)
+
+/**
+* Runs `f` `repetitions` times and returns the fastest run in seconds.
+*/
+template <typename F>
+double Measure(F f, int repetitions = 5)
+{
+    auto best = 1e300;
+    for (int i = 0; i < repetitions; i++)
+    {
+        auto start = std::chrono::steady_clock::now();
+        f();
+        auto end = std::chrono::steady_clock::now();
+        best = std::min(best, std::chrono::duration<double>(end - start).count());
+    }
+    return best;
+}
+
+/**
+* Writes a result line with the time taken and the throughput over `bytes`.
+*/
+inline void Report(std::ostream &output, const std::string &name, double seconds, size_t bytes)
+{
+    output << std::left << std::setw(40) << name << std::right
+           << std::fixed << std::setprecision(3) << std::setw(10) << seconds * 1000.0 << " ms"
+           << std::setprecision(1) << std::setw(10) << bytes / seconds / (1024.0 * 1024.0) << " MiB/s"
+           << std::endl;
+}
+
+/**
+* Builds a report-like template of at least `size` bytes, `textRatio` controls the share of literal text.
+*/
+inline std::string SyntheticTemplate(size_t size, int textRatio = 1)
+{
+    const std::string text = "Lorem ipsum dolor sit amet, consectetur adipiscing elit, sed do eiusmod tempor.\n";
+    std::string result;
+    while (result.size() < size)
+    {
+        result += "Hello {{name}},\n{{#loop items item}}\n";
+        for (int i = 0; i < textRatio; i++)
+        {
+            result += text;
+        }
+        result += "I like {{item}}{{#ifeq item favorite}} very much{{/ifeq}}.\n{{/loop}}\n";
+    }
+    return result;
+}
+
+} // namespace bench
+} // namespace car
+
+#endif // _CARENDER_BENCH_HPP_INCLUDED
@@ -0,0 +1,95 @@
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "bench.hpp"
+#include "lexer.hpp"
+#include "scanner.hpp"
+
+using car::lexer::Lexer;
+using car::lexer::Token;
+
+namespace car
+{
+namespace bench
+{
+
+static void lexerEntryPoints(std::ostream &output)
+{
+    const auto input = SyntheticTemplate(8 * 1024 * 1024);
+    std::vector<Token> tokens;
+    std::stringstream error;
+
+    auto seconds = Measure([&]() {
+        std::stringstream stream(input);
+        tokens.clear();
+        Lexer().lex(stream, tokens, error);
+    });
+    Report(output, "lexer/istream", seconds, input.size());
+
+    seconds = Measure([&]() {
+        tokens.clear();
+        Lexer().lex(input.data(), input.data() + input.size(), tokens, error);
+    });
+    Report(output, "lexer/buffer", seconds, input.size());
+
+    auto before = Allocations();
+    std::vector<Token> fresh;
+    Lexer().lex(input.data(), input.data() + input.size(), fresh, error);
+    output << "lexer/buffer allocations: " << Allocations() - before << " for " << fresh.size() << " tokens" << std::endl;
+}
+
+static void lexerTextHeavy(std::ostream &output)
+{
+    const auto input = SyntheticTemplate(32 * 1024 * 1024, 40);
+    std::vector<Token> tokens;
+    std::stringstream error;
+
+    const char *names[] = {"scanner/scalar", "scanner/sse2", "scanner/avx2"};
+    for (auto isa : {scanner::Isa::Scalar, scanner::Isa::SSE2, scanner::Isa::AVX2})
+    {
+        if (!scanner::IsSupported(isa))
+        {
+            continue;
+        }
+        auto seconds = Measure([&]() {
+            auto it = input.data();
+            auto end = input.data() + input.size();
+            while ((it = scanner::Find(it, end, '{', isa)) != end)
+            {
+                it++;
+            }
+        });
+        Report(output, names[static_cast<int>(isa)], seconds, input.size());
+    }
+
+    auto seconds = Measure([&]() {
+        tokens.clear();
+        Lexer().lex(input.data(), input.data() + input.size(), tokens, error);
+    });
+    Report(output, "lexer/text-heavy", seconds, input.size());
+}
+
+static void lexerParallel(std::ostream &output)
+{
+    const auto input = SyntheticTemplate(256 * 1024 * 1024, 4);
+    std::vector<Token> tokens;
+    std::stringstream error;
+
+    for (unsigned threads = 1; threads <= 32; threads *= 2)
+    {
+        auto seconds = Measure([&]() {
+            tokens.clear();
+            Lexer().lex(input.data(), input.data() + input.size(), tokens, error, threads);
+        },
+                               3);
+        Report(output, "lexer/parallel/" + std::to_string(threads), seconds, input.size());
+    }
+}
+
+BENCHMARK("lexer/entry-points", lexerEntryPoints);
+BENCHMARK("lexer/text-heavy", lexerTextHeavy);
+BENCHMARK("lexer/parallel", lexerParallel);
+
+} // namespace bench
+} // namespace car
@@ -0,0 +1,49 @@
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <string>
+
+#include "bench.hpp"
+
+static size_t allocations = 0;
+
+void *operator new(size_t size)
+{
+    allocations++;
+    if (auto ptr = std::malloc(size == 0 ? 1 : size))
+    {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void *ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept
+{
+    std::free(ptr);
+}
+
+size_t car::bench::Allocations()
+{
+    return allocations;
+}
+
+int main(int argc, char *argv[])
+{
+    // An optional argument selects the benchmarks whose names start with it.
+    const std::string filter = argc > 1 ? argv[1] : "";
+
+    for (const auto &pair : car::bench::Benchmarks())
+    {
+        if (pair.first.compare(0, filter.size(), filter) == 0)
+        {
+            pair.second(std::cout);
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
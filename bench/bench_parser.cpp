@@ -0,0 +1,297 @@
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "bench.hpp"
+#include "cache.hpp"
+#include "carc.hpp"
+#include "lexer.hpp"
+#include "parser.hpp"
+#include "registry.hpp"
+
+using car::lexer::BufferTokenSource;
+using car::lexer::Lexer;
+using car::lexer::Token;
+using car::lexer::TokenStream;
+using car::parser::Ast;
+using car::parser::BlockNode;
+using car::parser::IfEqNode;
+using car::parser::LoopNode;
+using car::parser::Parser;
+using car::parser::ParserOptions;
+using car::parser::PrintNode;
+using car::parser::TextNode;
+using car::parser::Visitor;
+
+namespace car
+{
+namespace bench
+{
+
+static void parserTokenLayout(std::ostream &output)
+{
+    const auto input = SyntheticTemplate(8 * 1024 * 1024);
+    const auto options = ParserOptions({"name", "items", "favorite"});
+    std::stringstream error;
+
+    auto lexer = Lexer();
+    auto tokens = std::vector<Token>();
+    auto stream = TokenStream();
+    lexer.lex(input.data(), input.data() + input.size(), tokens, error);
+    lexer.lex(input.data(), input.data() + input.size(), stream, error);
+
+    output << "tokens/vector bytes per token: " << static_cast<double>(tokens.capacity() * sizeof(Token)) / tokens.size() << std::endl;
+    output << "tokens/stream bytes per token: " << static_cast<double>(stream.MemoryUsage()) / stream.size() << std::endl;
+
+    auto seconds = Measure([&]() {
+        auto nodes = Ast();
+        Parser(options).parse(tokens, nodes, error);
+    });
+    Report(output, "parser/vector", seconds, input.size());
+
+    seconds = Measure([&]() {
+        auto nodes = Ast();
+        Parser(options).parse(stream, nodes, error);
+    });
+    Report(output, "parser/stream", seconds, input.size());
+
+    // Steady state, the parser and the tree keep their storage between parses.
+    auto parser = Parser(options);
+    auto nodes = Ast();
+    seconds = Measure([&]() {
+        parser.parse(stream, nodes, error);
+    });
+    Report(output, "parser/stream-reused", seconds, input.size());
+}
+
+BENCHMARK("parser/token-layout", parserTokenLayout);
+
+static void parserFused(std::ostream &output)
+{
+    const auto input = SyntheticTemplate(8 * 1024 * 1024);
+    const auto options = ParserOptions({"name", "items", "favorite"});
+    std::stringstream error;
+
+    auto seconds = Measure([&]() {
+        auto lexer = Lexer();
+        auto stream = TokenStream();
+        auto nodes = Ast();
+        lexer.lex(input.data(), input.data() + input.size(), stream, error);
+        Parser(options).parse(stream, nodes, error);
+    });
+    Report(output, "lex+parse/stream", seconds, input.size());
+
+    seconds = Measure([&]() {
+        auto lexer = Lexer();
+        auto source = BufferTokenSource(lexer, input.data(), input.data() + input.size());
+        auto nodes = Ast();
+        Parser(options).parse(source, nodes, error);
+    });
+    Report(output, "lex+parse/fused", seconds, input.size());
+}
+
+BENCHMARK("parser/fused", parserFused);
+
+/**
+* Visits every node, so that traversal is measured without rendering.
+*/
+class CountingVisitor : public Visitor
+{
+public:
+    void visit(const TextNode &) override { this->count++; }
+    void visit(const PrintNode &) override { this->count++; }
+
+    void visit(const LoopNode &n) override
+    {
+        this->count++;
+        for (const auto &child : n.Children())
+        {
+            child.accept(*this);
+        }
+    }
+
+    void visit(const IfEqNode &n) override
+    {
+        this->count++;
+        for (const auto &child : n.Children())
+        {
+            child.accept(*this);
+        }
+    }
+
+    void visit(const BlockNode &n) override
+    {
+        this->count++;
+        for (const auto &child : n.Children())
+        {
+            child.accept(*this);
+        }
+    }
+
+    size_t count = 0;
+};
+
+static void parserAst(std::ostream &output)
+{
+    const auto input = SyntheticTemplate(8 * 1024 * 1024);
+    const auto options = ParserOptions({"name", "items", "favorite"});
+    std::stringstream error;
+
+    auto lexer = Lexer();
+    auto stream = TokenStream();
+    auto nodes = Ast();
+    lexer.lex(input.data(), input.data() + input.size(), stream, error);
+    Parser(options).parse(stream, nodes, error);
+
+    auto count = size_t(0);
+    auto seconds = Measure([&]() {
+        auto visitor = CountingVisitor();
+        for (const auto &n : nodes)
+        {
+            n.accept(visitor);
+        }
+        count = visitor.count;
+    });
+    Report(output, "ast/traverse", seconds, input.size());
+
+    output << "ast nodes: " << count << ", bytes per node: " << static_cast<double>(nodes.MemoryUsage()) / count << std::endl;
+}
+
+BENCHMARK("parser/ast", parserAst);
+
+static void parserCarc(std::ostream &output)
+{
+    // Cold start of a service with many templates, each a few KiB.
+    const auto templates = 5000;
+    const auto options = ParserOptions({"name", "items", "favorite"});
+    std::stringstream error;
+    auto inputs = std::vector<std::string>();
+    auto compiled = std::vector<std::string>();
+    size_t bytes = 0;
+    for (auto i = 0; i < templates; i++)
+    {
+        inputs.push_back("Template " + std::to_string(i) + "\n" + SyntheticTemplate(4096));
+        bytes += inputs.back().size();
+
+        auto lexer = Lexer();
+        auto nodes = Ast();
+        auto source = BufferTokenSource(lexer, inputs.back().data(), inputs.back().data() + inputs.back().size());
+        Parser(options).parse(source, nodes, error);
+        std::stringstream file;
+        car::carc::Writer().Write(nodes, file);
+        compiled.push_back(file.str());
+    }
+
+    auto trees = std::vector<Ast>(templates);
+    auto seconds = Measure([&]() {
+        for (auto i = 0; i < templates; i++)
+        {
+            auto lexer = Lexer();
+            auto source = BufferTokenSource(lexer, inputs[i].data(), inputs[i].data() + inputs[i].size());
+            Parser(options).parse(source, trees[i], error);
+        }
+    });
+    Report(output, "parser/5k-templates", seconds, bytes);
+
+    trees = std::vector<Ast>(templates);
+    seconds = Measure([&]() {
+        for (auto i = 0; i < templates; i++)
+        {
+            car::carc::Reader().Read(compiled[i].data(), compiled[i].data() + compiled[i].size(), trees[i], error);
+        }
+    });
+    Report(output, "carc/5k-templates", seconds, bytes);
+}
+
+BENCHMARK("parser/carc", parserCarc);
+
+static void parserCache(std::ostream &output)
+{
+    // A service that renders the same templates again and again.
+    const auto templates = 5000;
+    const auto options = ParserOptions({"name", "items", "favorite"});
+    std::stringstream error;
+    auto inputs = std::vector<std::string>();
+    size_t bytes = 0;
+    for (auto i = 0; i < templates; i++)
+    {
+        inputs.push_back("Template " + std::to_string(i) + "\n" + SyntheticTemplate(4096));
+        bytes += inputs.back().size();
+    }
+
+    auto compile = [&](const std::string &text, Ast &nodes) {
+        auto lexer = Lexer();
+        auto source = BufferTokenSource(lexer, text.data(), text.data() + text.size());
+        return Parser(options).parse(source, nodes, error);
+    };
+
+    auto seconds = Measure([&]() {
+        for (const auto &input : inputs)
+        {
+            auto nodes = Ast();
+            compile(input, nodes);
+        }
+    });
+    Report(output, "parser/5k-templates", seconds, bytes);
+
+    car::cache::TemplateCache cache(256 * 1024 * 1024);
+    for (const auto &input : inputs)
+    {
+        cache.Get(input, 0, compile);
+    }
+    seconds = Measure([&]() {
+        for (const auto &input : inputs)
+        {
+            cache.Get(input, 0, compile);
+        }
+    });
+    Report(output, "cache/5k-templates", seconds, bytes);
+
+    const auto stats = cache.Counters();
+    output << "cache hits: " << stats.hits << ", misses: " << stats.misses << ", bytes per template: "
+           << stats.bytes / stats.entries << std::endl;
+}
+
+BENCHMARK("parser/cache", parserCache);
+
+static void parserSharing(std::ostream &output)
+{
+    // Many templates with the same header and footer, and a body of their own.
+    const auto templates = 2000;
+    const auto options = ParserOptions({"name", "items", "favorite"});
+    const auto header = SyntheticTemplate(2048);
+    const auto footer = SyntheticTemplate(1024, 4);
+    std::stringstream error;
+    auto trees = std::vector<Ast>(templates);
+    auto inputs = std::vector<std::string>();
+    size_t bytes = 0;
+    for (auto i = 0; i < templates; i++)
+    {
+        inputs.push_back(header + "Template " + std::to_string(i) + "\n" + SyntheticTemplate(512) + footer);
+        bytes += inputs.back().size();
+
+        auto lexer = Lexer();
+        auto source = BufferTokenSource(lexer, inputs.back().data(), inputs.back().data() + inputs.back().size());
+        Parser(options).parse(source, trees[i], error);
+    }
+
+    for (auto isSharing : {false, true})
+    {
+        auto sharing = car::registry::Sharing();
+        auto seconds = Measure([&]() {
+            car::registry::TemplateRegistry registry(isSharing);
+            for (auto i = 0; i < templates; i++)
+            {
+                registry.Add(std::to_string(i), trees[i]);
+            }
+            sharing = registry.Report();
+        });
+        Report(output, isSharing ? "registry/shared" : "registry/copied", seconds, bytes);
+        output << sharing << std::endl;
+    }
+}
+
+BENCHMARK("parser/sharing", parserSharing);
+
+} // namespace bench
+} // namespace car
@@ -0,0 +1,556 @@
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "bench.hpp"
+#include "bytecode.hpp"
+#include "codegen.hpp"
+#include "lexer.hpp"
+#include "literal.hpp"
+#include "parser.hpp"
+#include "passes.hpp"
+#include "renderer.hpp"
+#include "sizing.hpp"
+
+using car::bytecode::Compiler;
+using car::bytecode::Machine;
+using car::bytecode::Program;
+using car::lexer::Lexer;
+using car::lexer::TokenStream;
+using car::parser::Ast;
+using car::parser::Parser;
+using car::parser::ParserOptions;
+using car::passes::PassManager;
+using car::renderer::Renderer;
+using car::renderer::Slots;
+
+// Generated from the bundled examples by the Makefile.
+CARENDER_TEMPLATE(render_examples_fruits_template);
+CARENDER_TEMPLATE(render_examples_bottles_template);
+
+#if __cplusplus >= 201703L
+// examples/fruits/template.car as a literal template.
+CARENDER_LITERAL(FruitsLiteral, "Hello {{name}},\n"
+                                "\n"
+                                "{{#loop items item}}\n"
+                                "I like {{item}}{{#ifeq item favorite}} very much{{/ifeq}}.\n"
+                                "{{/loop}}\n"
+                                "\n"
+                                "Cheers!");
+#endif
+
+namespace car
+{
+namespace bench
+{
+
+static void rendererNesting(std::ostream &output)
+{
+    auto symbols = std::unordered_map<std::string, std::string>({{"name", "Aragorn"}, {"favorite", "b"}});
+    auto rangeSymbols = std::unordered_map<std::string, std::vector<std::string>>({{"items", {"a", "b", "c"}}});
+    const auto options = ParserOptions({"name", "items", "favorite"});
+    std::stringstream error;
+
+    // Shallow templates, which blocks nest at most two deep in.
+    const auto shallow = SyntheticTemplate(8 * 1024 * 1024);
+    auto lexer = Lexer();
+    auto stream = TokenStream();
+    auto nodes = Ast();
+    lexer.lex(shallow.data(), shallow.data() + shallow.size(), stream, error);
+    Parser(options).parse(stream, nodes, error);
+
+    auto seconds = Measure([&]() {
+        std::stringstream rendered;
+        auto renderer = Renderer(symbols, rangeSymbols, rendered, error);
+        for (const auto &n : nodes)
+        {
+            n.accept(renderer);
+        }
+    });
+    Report(output, "render/shallow", seconds, shallow.size());
+
+    // Blocks nested deeper than a call stack could hold.
+    auto deep = std::string();
+    const auto depth = 1000000;
+    for (auto i = 0; i < depth; i++)
+    {
+        deep += "{{#ifeq name name}}";
+    }
+    deep += "{{name}}";
+    for (auto i = 0; i < depth; i++)
+    {
+        deep += "{{/ifeq}}";
+    }
+
+    auto deepStream = TokenStream();
+    lexer.lex(deep.data(), deep.data() + deep.size(), deepStream, error);
+    auto parser = Parser(options);
+    seconds = Measure([&]() {
+        parser.parse(deepStream, nodes, error);
+    });
+    Report(output, "parser/deep", seconds, deep.size());
+
+    seconds = Measure([&]() {
+        std::stringstream rendered;
+        auto renderer = Renderer(symbols, rangeSymbols, rendered, error);
+        for (const auto &n : nodes)
+        {
+            n.accept(renderer);
+        }
+    });
+    Report(output, "render/deep", seconds, deep.size());
+}
+
+BENCHMARK("renderer/nesting", rendererNesting);
+
+/**
+* A template with its symbols, read from a directory with the files of the bundled examples.
+*/
+struct Example
+{
+    std::string name;
+    std::string text;
+    std::unordered_map<std::string, std::string> symbols;
+    std::unordered_map<std::string, std::vector<std::string>> rangeSymbols;
+};
+
+static bool readExample(const std::string &name, Example &example)
+{
+    const auto directory = "examples/" + name + "/";
+    std::ifstream text(directory + "template.car");
+    std::ifstream symbols(directory + "symbols.txt");
+    std::ifstream ranges(directory + "ranges.txt");
+    if (!text || !symbols || !ranges)
+    {
+        return false;
+    }
+
+    example.name = name;
+    example.text.assign(std::istreambuf_iterator<char>(text), std::istreambuf_iterator<char>());
+
+    // `name value` lines, and range names followed by ` value` lines, as read by carender.
+    std::string line;
+    while (std::getline(symbols, line))
+    {
+        auto space = line.find(' ');
+        if (space != std::string::npos)
+        {
+            example.symbols[line.substr(0, space)] = line.substr(space + 1);
+        }
+    }
+
+    std::string range;
+    while (std::getline(ranges, line))
+    {
+        if (line.empty())
+        {
+            continue;
+        }
+        if (line[0] == ' ')
+        {
+            example.rangeSymbols[range].push_back(line.substr(1));
+        }
+        else
+        {
+            range = line;
+            example.rangeSymbols[range];
+        }
+    }
+
+    return true;
+}
+
+/**
+* Renders `nodes` with a Renderer and a Machine `repetitions` times each and reports both.
+*/
+static void compareEngines(std::ostream &output, const std::string &name, const Ast &nodes, size_t bytes, int repetitions,
+                           const std::unordered_map<std::string, std::string> &symbols,
+                           const std::unordered_map<std::string, std::vector<std::string>> &rangeSymbols)
+{
+    std::stringstream error;
+
+    auto seconds = Measure([&]() {
+        for (auto i = 0; i < repetitions; i++)
+        {
+            std::stringstream rendered;
+            auto renderer = Renderer(symbols, rangeSymbols, rendered, error);
+            for (const auto &n : nodes)
+            {
+                n.accept(renderer);
+            }
+        }
+    });
+    Report(output, name + "/visitor", seconds, bytes * repetitions);
+
+    auto program = Program();
+    Compiler().Compile(nodes, program);
+    seconds = Measure([&]() {
+        for (auto i = 0; i < repetitions; i++)
+        {
+            std::stringstream rendered;
+            Machine(symbols, rangeSymbols, rendered, error).Run(program);
+        }
+    });
+    Report(output, name + "/bytecode", seconds, bytes * repetitions);
+}
+
+static void rendererBytecode(std::ostream &output)
+{
+    std::stringstream error;
+
+    // The bundled examples are small, they are rendered many times.
+    for (const auto &name : {"fruits", "bottles"})
+    {
+        auto example = Example();
+        if (!readExample(name, example))
+        {
+            output << "examples/" << name << " not found, run from the repository root." << std::endl;
+            continue;
+        }
+
+        auto lexer = Lexer();
+        auto stream = TokenStream();
+        auto nodes = Ast();
+        lexer.lex(example.text.data(), example.text.data() + example.text.size(), stream, error);
+        Parser(ParserOptions()).parse(stream, nodes, error);
+        compareEngines(output, std::string("render/") + name, nodes, example.text.size(), 100000,
+                       example.symbols, example.rangeSymbols);
+    }
+
+    auto symbols = std::unordered_map<std::string, std::string>({{"name", "Aragorn"}, {"favorite", "b"}});
+    auto rangeSymbols = std::unordered_map<std::string, std::vector<std::string>>({{"items", {"a", "b", "c"}}});
+    for (auto textRatio : {0, 1})
+    {
+        const auto input = SyntheticTemplate(8 * 1024 * 1024, textRatio);
+        auto lexer = Lexer();
+        auto stream = TokenStream();
+        auto nodes = Ast();
+        lexer.lex(input.data(), input.data() + input.size(), stream, error);
+        Parser(ParserOptions()).parse(stream, nodes, error);
+        compareEngines(output, textRatio == 0 ? "render/synthetic-directives" : "render/synthetic", nodes, input.size(), 1,
+                       symbols, rangeSymbols);
+    }
+}
+
+BENCHMARK("renderer/bytecode", rendererBytecode);
+
+static void rendererCodegen(std::ostream &output)
+{
+    std::stringstream error;
+
+    for (const auto &name : {"fruits", "bottles"})
+    {
+        auto example = Example();
+        if (!readExample(name, example))
+        {
+            output << "examples/" << name << " not found, run from the repository root." << std::endl;
+            continue;
+        }
+
+        auto lexer = Lexer();
+        auto stream = TokenStream();
+        auto nodes = Ast();
+        lexer.lex(example.text.data(), example.text.data() + example.text.size(), stream, error);
+        Parser(ParserOptions()).parse(stream, nodes, error);
+
+        const auto repetitions = 100000;
+        auto seconds = Measure([&]() {
+            for (auto i = 0; i < repetitions; i++)
+            {
+                std::stringstream rendered;
+                auto renderer = Renderer(example.symbols, example.rangeSymbols, rendered, error);
+                for (const auto &n : nodes)
+                {
+                    n.accept(renderer);
+                }
+            }
+        });
+        Report(output, std::string("render/") + name + "/visitor", seconds, example.text.size() * repetitions);
+
+        const auto generated = std::string(name) == "fruits" ? render_examples_fruits_template : render_examples_bottles_template;
+        seconds = Measure([&]() {
+            for (auto i = 0; i < repetitions; i++)
+            {
+                std::string rendered;
+                generated(example.symbols, example.rangeSymbols, rendered, error);
+            }
+        });
+        Report(output, std::string("render/") + name + "/generated", seconds, example.text.size() * repetitions);
+    }
+}
+
+BENCHMARK("renderer/codegen", rendererCodegen);
+
+static void rendererSpecialize(std::ostream &output)
+{
+    // Everything but the greeting is known when the template is deployed.
+    auto symbols = std::unordered_map<std::string, std::string>({{"name", "Aragorn"}, {"favorite", "b"}});
+    auto rangeSymbols = std::unordered_map<std::string, std::vector<std::string>>({{"items", {}}});
+    for (auto i = 0; i < 100000; i++)
+    {
+        rangeSymbols["items"].push_back(std::to_string(i % 100));
+    }
+    auto assumptions = car::passes::Assumptions();
+    assumptions.symbols.insert("greeting");
+    assumptions.isExhaustive = true;
+
+    const auto text = std::string("{{greeting}} {{name}},\n{{#loop items item}}\nI like {{item}}{{#ifeq item favorite}} very much"
+                                  "{{/ifeq}}.\n{{/loop}}\nCheers!");
+    std::stringstream error;
+    auto lexer = Lexer();
+    auto stream = TokenStream();
+    auto nodes = Ast();
+    lexer.lex(text.data(), text.data() + text.size(), stream, error);
+    Parser(ParserOptions()).parse(stream, nodes, error);
+
+    auto residual = nodes;
+    auto passes = PassManager();
+    passes.Add(std::unique_ptr<car::passes::Pass>(new car::passes::Specializer(symbols, rangeSymbols, assumptions)));
+    car::passes::AddStandardPasses(passes, assumptions);
+    auto seconds = Measure([&]() {
+        residual = nodes;
+        passes.Run(residual);
+    });
+    Report(output, "specialize/fruits-100k", seconds, text.size());
+
+    symbols["greeting"] = "Hello";
+    std::stringstream rendered;
+    seconds = Measure([&]() {
+        rendered.str("");
+        auto renderer = Renderer(symbols, rangeSymbols, rendered, error);
+        for (const auto &n : nodes)
+        {
+            n.accept(renderer);
+        }
+    });
+    Report(output, "render/fruits-100k/parsed", seconds, rendered.str().size());
+
+    seconds = Measure([&]() {
+        rendered.str("");
+        auto renderer = Renderer(symbols, rangeSymbols, rendered, error);
+        for (const auto &n : residual)
+        {
+            n.accept(renderer);
+        }
+    });
+    Report(output, "render/fruits-100k/residual", seconds, rendered.str().size());
+}
+
+BENCHMARK("renderer/specialize", rendererSpecialize);
+
+static void rendererInvariants(std::ostream &output)
+{
+    auto symbols = std::unordered_map<std::string, std::string>({{"name", "Aragorn"}, {"favorite", "b"}});
+    auto rangeSymbols = std::unordered_map<std::string, std::vector<std::string>>({{"items", {}}, {"letters", {"a", "b", "c"}}});
+    for (auto i = 0; i < 100000; i++)
+    {
+        rangeSymbols["items"].push_back(std::to_string(i));
+    }
+
+    // The same loop, with a body that mostly does not depend on the element and with one that does.
+    const char *bodies[][2] = {
+        {"invariant", "{{#loop items item}}{{item}}: {{name}} likes {{#loop letters l}}{{l}}{{#ifeq l favorite}}!{{/ifeq}}{{/loop}}.\n{{/loop}}"},
+        {"variant", "{{#loop items item}}{{item}}: {{name}} likes {{#loop letters l}}{{l}}{{#ifeq l item}}!{{/ifeq}}{{/loop}}.\n{{/loop}}"},
+    };
+    std::stringstream error;
+    for (const auto &body : bodies)
+    {
+        const auto text = std::string(body[1]);
+        auto lexer = Lexer();
+        auto stream = TokenStream();
+        auto nodes = Ast();
+        lexer.lex(text.data(), text.data() + text.size(), stream, error);
+        Parser(ParserOptions()).parse(stream, nodes, error);
+
+        std::stringstream rendered;
+        auto seconds = Measure([&]() {
+            rendered.str("");
+            auto renderer = Renderer(symbols, rangeSymbols, rendered, error);
+            for (const auto &n : nodes)
+            {
+                n.accept(renderer);
+            }
+        });
+        Report(output, std::string("render/loop-100k/") + body[0], seconds, rendered.str().size());
+    }
+}
+
+BENCHMARK("renderer/invariants", rendererInvariants);
+
+static void rendererSlots(std::ostream &output)
+{
+    std::stringstream error;
+
+    // The bundled examples render with the symbols looked up by name, resolved per render and resolved once.
+    for (const auto &name : {"fruits", "bottles"})
+    {
+        auto example = Example();
+        if (!readExample(name, example))
+        {
+            output << "examples/" << name << " not found, run from the repository root." << std::endl;
+            continue;
+        }
+
+        auto lexer = Lexer();
+        auto stream = TokenStream();
+        auto nodes = Ast();
+        lexer.lex(example.text.data(), example.text.data() + example.text.size(), stream, error);
+        Parser(ParserOptions()).parse(stream, nodes, error);
+
+        const auto repetitions = 100000;
+        auto seconds = Measure([&]() {
+            for (auto i = 0; i < repetitions; i++)
+            {
+                std::stringstream rendered;
+                auto renderer = Renderer(example.symbols, example.rangeSymbols, rendered, error);
+                for (const auto &n : nodes)
+                {
+                    n.accept(renderer);
+                }
+            }
+        });
+        Report(output, std::string("render/") + name + "/names", seconds, example.text.size() * repetitions);
+
+        seconds = Measure([&]() {
+            for (auto i = 0; i < repetitions; i++)
+            {
+                std::stringstream rendered;
+                auto renderer = Renderer(Slots(nodes, example.symbols, example.rangeSymbols), rendered, error);
+                for (const auto &n : nodes)
+                {
+                    n.accept(renderer);
+                }
+            }
+        });
+        Report(output, std::string("render/") + name + "/slots", seconds, example.text.size() * repetitions);
+
+        const auto slots = Slots(nodes, example.symbols, example.rangeSymbols);
+        seconds = Measure([&]() {
+            for (auto i = 0; i < repetitions; i++)
+            {
+                std::stringstream rendered;
+                auto renderer = Renderer(slots, rendered, error);
+                for (const auto &n : nodes)
+                {
+                    n.accept(renderer);
+                }
+            }
+        });
+        Report(output, std::string("render/") + name + "/resolved", seconds, example.text.size() * repetitions);
+    }
+}
+
+BENCHMARK("renderer/slots", rendererSlots);
+
+static void rendererSizing(std::ostream &output)
+{
+    // A report of about 50 MiB, rendered to a string.
+    auto symbols = std::unordered_map<std::string, std::string>({{"name", "Aragorn"}, {"favorite", "b"}});
+    auto rangeSymbols = std::unordered_map<std::string, std::vector<std::string>>({{"rows", {}}, {"letters", {"a", "b", "c"}}});
+    for (auto i = 0; i < 500000; i++)
+    {
+        rangeSymbols["rows"].push_back(std::to_string(i));
+    }
+    const auto text = std::string("<table>\n{{#loop rows row}}<tr><td>{{row}}</td><td>{{name}}</td><td>"
+                                  "{{#loop letters l}}{{l}}{{#ifeq l favorite}}!{{/ifeq}}{{/loop}}</td>"
+                                  "<td>Lorem ipsum dolor sit amet, consectetur.</td></tr>\n{{/loop}}</table>\n");
+    std::stringstream error;
+    auto lexer = Lexer();
+    auto stream = TokenStream();
+    auto nodes = Ast();
+    lexer.lex(text.data(), text.data() + text.size(), stream, error);
+    Parser(ParserOptions()).parse(stream, nodes, error);
+    const auto slots = Slots(nodes, symbols, rangeSymbols);
+
+    auto rendered = std::string();
+    auto seconds = Measure([&]() {
+        std::stringstream buffer;
+        auto renderer = Renderer(slots, buffer, error);
+        for (const auto &n : nodes)
+        {
+            n.accept(renderer);
+        }
+        rendered = buffer.str();
+    });
+    Report(output, "render/report/stringstream", seconds, rendered.size());
+
+    seconds = Measure([&]() {
+        rendered = std::string();
+        car::sizing::StringBuffer buffer(rendered);
+        std::ostream stream(&buffer);
+        auto renderer = Renderer(slots, stream, error);
+        for (const auto &n : nodes)
+        {
+            n.accept(renderer);
+        }
+    });
+    Report(output, "render/report/string", seconds, rendered.size());
+
+    const auto formula = car::sizing::SizeFormula(nodes);
+    auto size = car::sizing::Size();
+    seconds = Measure([&]() { size = formula.Evaluate(slots); });
+    Report(output, "render/report/evaluate", seconds, rendered.size());
+
+    seconds = Measure([&]() {
+        rendered = std::string();
+        car::sizing::Render(nodes, formula, slots, rendered, error);
+    });
+    Report(output, "render/report/reserved", seconds, rendered.size());
+    output << "evaluated bytes: " << size.bytes << ", rendered bytes: " << rendered.size()
+           << (size.accuracy == car::sizing::Accuracy::Exact ? ", exact" : ", upper bound") << std::endl;
+}
+
+BENCHMARK("renderer/sizing", rendererSizing);
+
+#if __cplusplus >= 201703L
+
+static void rendererLiteral(std::ostream &output)
+{
+    auto example = Example();
+    if (!readExample("fruits", example))
+    {
+        output << "examples/fruits not found, run from the repository root." << std::endl;
+        return;
+    }
+
+    // The text is lexed and parsed on each repetition, as Driver::Render does.
+    std::stringstream error;
+    const auto repetitions = 100000;
+    auto seconds = Measure([&]() {
+        auto lexer = Lexer();
+        auto stream = TokenStream();
+        auto nodes = Ast();
+        auto parser = Parser(ParserOptions());
+        for (auto i = 0; i < repetitions; i++)
+        {
+            stream = TokenStream();
+            lexer.lex(example.text.data(), example.text.data() + example.text.size(), stream, error);
+            parser.parse(stream, nodes, error);
+            std::stringstream rendered;
+            auto renderer = Renderer(example.symbols, example.rangeSymbols, rendered, error);
+            for (const auto &n : nodes)
+            {
+                n.accept(renderer);
+            }
+        }
+    });
+    Report(output, "render/fruits/parsed", seconds, example.text.size() * repetitions);
+
+    seconds = Measure([&]() {
+        for (auto i = 0; i < repetitions; i++)
+        {
+            std::string rendered;
+            FruitsLiteral::Render(example.symbols, example.rangeSymbols, rendered, error);
+        }
+    });
+    Report(output, "render/fruits/literal", seconds, example.text.size() * repetitions);
+}
+
+BENCHMARK("renderer/literal", rendererLiteral);
+
+#endif // __cplusplus >= 201703L
+
+} // namespace bench
+} // namespace car
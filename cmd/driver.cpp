@@ -1,70 +1,532 @@
 #include <algorithm>
+#include <cerrno>
 #include <iostream>
+#include <iterator>
+#include <memory>
+#include <sstream>
 #include <string>
 #include <unordered_map>
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "carc.hpp"
+#include "codegen.hpp"
 #include "lexer.hpp"
 #include "parser.hpp"
 #include "renderer.hpp"
+#include "scanner.hpp"
+#include "sizing.hpp"
 #include "driver.hpp"
 
+using car::bytecode::Compiler;
+using car::bytecode::Machine;
+using car::bytecode::Program;
+using car::lexer::BufferTokenSource;
 using car::lexer::Lexer;
-using car::lexer::Token;
-using car::parser::Node;
+using car::parser::Ast;
+using car::parser::BlockNode;
+using car::parser::IfEqNode;
+using car::parser::LoopNode;
 using car::parser::Parser;
 using car::parser::ParserOptions;
+using car::parser::PrintNode;
+using car::parser::TextNode;
+using car::parser::Visitor;
 using car::renderer::Renderer;
+using car::renderer::Slots;
 
 namespace car
 {
 namespace driver
 {
 
+namespace
+{
+
+/**
+* Writes all of [begin, end) to `fd`, returns false on failure.
+*/
+bool writeAll(int fd, const char *begin, const char *end)
+{
+    while (begin != end)
+    {
+        auto count = write(fd, begin, end - begin);
+        if (count == -1)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return false;
+        }
+        begin += count;
+    }
+    return true;
+}
+
+/**
+* Contents of a file, mapped into memory if it is a regular file or read into a buffer otherwise.
+*/
+class File
+{
+public:
+    File() : fd(-1), mapping(nullptr), size(0) {}
+
+    File(const File &) = delete;
+    File &operator=(const File &) = delete;
+
+    ~File()
+    {
+        if (this->mapping != nullptr)
+        {
+            munmap(this->mapping, this->size);
+        }
+        if (this->fd != -1)
+        {
+            close(this->fd);
+        }
+    }
+
+    /**
+    * Opens the file at `path` without reading it, returns false and writes the reason to `error` on failure.
+    */
+    bool Open(const std::string &path, std::ostream &error)
+    {
+        this->path = path;
+        this->fd = open(path.c_str(), O_RDONLY);
+        if (this->fd == -1 || fstat(this->fd, &this->st) != 0)
+        {
+            error << "Cannot open `" << path << "`." << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    /**
+    * Reads the contents of the open file, returns false and writes the reason to `error` on failure.
+    */
+    bool Load(std::ostream &error)
+    {
+        auto result = this->IsRegular() && this->st.st_size > 0 ? this->map(this->st.st_size) : this->read();
+        if (!result)
+        {
+            error << "Cannot read `" << this->path << "`." << std::endl;
+        }
+        return result;
+    }
+
+    /**
+    * Sends the contents of the open regular file to `out` with `sendfile`, the file is not read into memory.
+    * Falls back to writing `bytes`, a copy of the contents, if `out` does not support it.
+    */
+    bool Send(int out, const std::string &bytes)
+    {
+        off_t offset = 0;
+        while (static_cast<size_t>(offset) < bytes.size())
+        {
+            if (sendfile(out, this->fd, &offset, bytes.size() - offset) <= 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                return writeAll(out, bytes.data() + offset, bytes.data() + bytes.size());
+            }
+        }
+        return true;
+    }
+
+    bool IsRegular() const { return S_ISREG(this->st.st_mode); }
+
+    Driver::FileIdentity Identity() const
+    {
+        return Driver::FileIdentity{
+            static_cast<uint64_t>(this->st.st_dev),
+            static_cast<uint64_t>(this->st.st_ino),
+            static_cast<uint64_t>(this->st.st_size),
+            static_cast<int64_t>(this->st.st_mtim.tv_sec),
+            static_cast<int64_t>(this->st.st_mtim.tv_nsec),
+        };
+    }
+
+    const char *Begin() const
+    {
+        return this->mapping != nullptr ? static_cast<const char *>(this->mapping) : this->buffer.data();
+    }
+
+    const char *End() const
+    {
+        return this->mapping != nullptr ? this->Begin() + this->size : this->buffer.data() + this->buffer.size();
+    }
+
+private:
+    bool map(size_t length)
+    {
+        auto address = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, this->fd, 0);
+        if (address == MAP_FAILED)
+        {
+            return this->read();
+        }
+
+        this->mapping = address;
+        this->size = length;
+        madvise(this->mapping, this->size, MADV_SEQUENTIAL);
+        return true;
+    }
+
+    bool read()
+    {
+        char chunk[65536];
+        ssize_t count;
+        while ((count = ::read(this->fd, chunk, sizeof(chunk))) > 0)
+        {
+            this->buffer.append(chunk, count);
+        }
+        return count == 0;
+    }
+
+    std::string path;
+    int fd;
+    struct stat st;
+    void *mapping;
+    size_t size;
+    std::string buffer;
+};
+
+/**
+* Finds out if nodes print the same output each time they are rendered by a driver,
+* which is the case for text and symbols but not for loops over ranges and conditions on them.
+*/
+class ConstantCheck : public Visitor
+{
+public:
+    void visit(const TextNode &) override {}
+    void visit(const PrintNode &) override {}
+    void visit(const LoopNode &) override { this->isConstant = false; }
+    void visit(const IfEqNode &) override { this->isConstant = false; }
+    void visit(const BlockNode &) override { this->isConstant = false; }
+
+    bool IsConstant() const { return this->isConstant; }
+
+private:
+    bool isConstant = true;
+};
+
+} // namespace
+
 bool Driver::Render(std::istream &input)
 {
-    auto symbolNames = std::unordered_set<std::string>();
-    std::transform(this->symbols.begin(), this->symbols.end(),
-                   std::inserter(symbolNames, symbolNames.end()),
-                   [](auto pair) { return pair.first; });
+    auto buffer = std::string(std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>());
 
-    std::transform(this->rangeSymbols.begin(), this->rangeSymbols.end(),
-                   std::inserter(symbolNames, symbolNames.end()),
-                   [](auto pair) { return pair.first; });
+    return this->render(buffer.data(), buffer.data() + buffer.size(), nullptr, this->output);
+}
 
-    // Lex.
-    auto lexer = Lexer();
-    auto tokens = std::vector<Token>();
+bool Driver::RenderFile(const std::string &path)
+{
+    File file;
+    if (!file.Open(path, this->error))
+    {
+        return false;
+    }
 
-    if (!lexer.lex(input, tokens, this->error))
+    const auto *entry = file.IsRegular() ? this->findStatic(path, file.Identity()) : nullptr;
+    if (entry != nullptr)
+    {
+        this->output.write(entry->bytes.data(), entry->bytes.size());
+        return true;
+    }
+
+    if (!file.Load(this->error))
+    {
+        return false;
+    }
+
+    auto identity = file.Identity();
+    return this->render(file.Begin(), file.End(), file.IsRegular() ? &path : nullptr, this->output, identity);
+}
+
+bool Driver::RenderFile(const std::string &path, int fd)
+{
+    File file;
+    if (!file.Open(path, this->error))
     {
-        this->error << "Driver cannot lex." << std::endl;
         return false;
     }
-    if (tokens.size() == 0)
+
+    const auto *entry = file.IsRegular() ? this->findStatic(path, file.Identity()) : nullptr;
+    if (entry == nullptr)
+    {
+        if (!file.Load(this->error))
+        {
+            return false;
+        }
+
+        // Output that is not kept is written from a buffer.
+        std::stringstream buffer;
+        auto identity = file.Identity();
+        if (!this->render(file.Begin(), file.End(), file.IsRegular() ? &path : nullptr, buffer, identity))
+        {
+            return false;
+        }
+
+        entry = file.IsRegular() ? this->findStatic(path, identity) : nullptr;
+        if (entry == nullptr)
+        {
+            auto rendered = buffer.str();
+            return writeAll(fd, rendered.data(), rendered.data() + rendered.size());
+        }
+    }
+
+    auto result = entry->isVerbatim ? file.Send(fd, entry->bytes)
+                                    : writeAll(fd, entry->bytes.data(), entry->bytes.data() + entry->bytes.size());
+    if (!result)
+    {
+        this->error << "Cannot write output." << std::endl;
+    }
+    return result;
+}
+
+bool Driver::EmitCpp(const std::string &path, const std::string &function, std::ostream &output)
+{
+    File file;
+    if (!file.Open(path, this->error) || !file.Load(this->error))
+    {
+        return false;
+    }
+
+    auto nodes = Ast();
+    if (!this->parse(file.Begin(), file.End(), nodes))
+    {
+        return false;
+    }
+
+    if (!codegen::Generator().Generate(nodes, function, output, this->error))
     {
-        // Empty input is not an error.
+        this->error << "Driver cannot generate." << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+bool Driver::Compile(const std::string &path, std::ostream &output)
+{
+    File file;
+    if (!file.Open(path, this->error) || !file.Load(this->error))
+    {
+        return false;
+    }
+
+    auto nodes = Ast();
+    if (!this->parse(file.Begin(), file.End(), nodes))
+    {
+        return false;
+    }
+
+    if (!carc::Writer().Write(nodes, output))
+    {
+        this->error << "Driver cannot write compiled template." << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+bool Driver::LoadCompiled(const std::string &path)
+{
+    auto file = std::make_shared<File>();
+    if (!file->Open(path, this->error) || !file->Load(this->error))
+    {
+        return false;
+    }
+
+    auto entry = CompiledTemplate{file, Ast()};
+    auto reader = this->blocks == nullptr ? carc::Reader() : carc::Reader(*this->blocks);
+    if (!reader.Read(file->Begin(), file->End(), entry.nodes, this->error))
+    {
+        this->error << "Driver cannot load `" << path << "`." << std::endl;
+        return false;
+    }
+
+    this->compiled[path] = std::move(entry);
+    return true;
+}
+
+bool Driver::RenderCompiled(const std::string &path)
+{
+    auto it = this->compiled.find(path);
+    if (it == this->compiled.end())
+    {
+        if (!this->LoadCompiled(path))
+        {
+            return false;
+        }
+        it = this->compiled.find(path);
+    }
+
+    return this->render(it->second.nodes, this->output);
+}
+
+const Driver::StaticTemplate *Driver::findStatic(const std::string &path, const FileIdentity &identity) const
+{
+    auto it = this->statics.find(path);
+    if (it == this->statics.end() || !(it->second.identity == identity))
+    {
+        return nullptr;
+    }
+    return &it->second;
+}
+
+bool Driver::render(const char *begin, const char *end, const std::string *path, std::ostream &output,
+                    const FileIdentity &identity)
+{
+    // Templates without directives are their own output, they are not lexed.
+    if (scanner::FindPair(begin, end, '{', '{') == end)
+    {
+        if (path != nullptr)
+        {
+            this->statics[*path] = StaticTemplate{identity, std::string(begin, end), true};
+        }
+        output.write(begin, end - begin);
         return true;
     }
 
-    // Parse.
-    auto options = ParserOptions(symbolNames);
+    // Cached templates refer to their own copy of the text.
+    auto nodes = Ast();
+    const auto *tree = &nodes;
+    auto cached = std::shared_ptr<const cache::TemplateCache::Entry>();
+    if (this->cache != nullptr)
+    {
+        cached = this->cache->Get(string_view(begin, end - begin), this->scope(), [this](const std::string &text, Ast &compiled) {
+            return this->parse(text.data(), text.data() + text.size(), compiled);
+        });
+        if (cached == nullptr)
+        {
+            return false;
+        }
+        tree = &cached->nodes;
+    }
+    else if (!this->parse(begin, end, nodes))
+    {
+        return false;
+    }
+
+    auto check = ConstantCheck();
+    for (auto const &n : *tree)
+    {
+        n.accept(check);
+    }
+
+    if (path == nullptr || !check.IsConstant())
+    {
+        return this->render(*tree, output);
+    }
+
+    // The output only depends on the symbols of the driver, later renders copy it. It is allocated once.
+    auto bytes = std::string();
+    bytes.reserve(sizing::SizeFormula(*tree).Evaluate(Slots(*tree, this->symbols, this->rangeSymbols)).bytes);
+    sizing::StringBuffer buffer(bytes);
+    std::ostream rendered(&buffer);
+    if (!this->render(*tree, rendered))
+    {
+        return false;
+    }
+
+    auto &entry = this->statics[*path] = StaticTemplate{identity, std::move(bytes), false};
+    output.write(entry.bytes.data(), entry.bytes.size());
+    return true;
+}
+
+bool Driver::parse(const char *begin, const char *end, Ast &nodes)
+{
+    // Lex and parse in one pass, tokens are lexed as the parser reaches them and text nodes refer to the input.
+    auto lexer = Lexer();
+    auto source = BufferTokenSource(lexer, begin, end);
+    auto options = this->blocks == nullptr ? ParserOptions(this->symbolNames) : ParserOptions(this->symbolNames, *this->blocks);
     auto parser = Parser(options);
-    std::vector<std::unique_ptr<Node>> nodes;
-    if (!parser.parse(tokens, nodes, error))
+    std::stringstream parserError;
+    auto parsed = parser.parse(source, nodes, parserError);
+
+    // Lexer errors are written to the parser errors as tokens are pulled.
+    if (source.HasError())
+    {
+        this->error << parserError.str();
+        this->error << "Driver cannot lex." << std::endl;
+        return false;
+    }
+
+    if (!parsed)
     {
-        // There are more than one Token, there should be Nodes.
+        this->error << parserError.str();
         this->error << "Driver cannot parse." << std::endl;
         return false;
     }
 
-    // Render.
-    auto renderer = Renderer(symbols, rangeSymbols, this->output, this->error);
-    for (auto const &n : nodes)
+    if (this->passes != nullptr)
+    {
+        this->passes->Run(nodes);
+    }
+
+    return true;
+}
+
+uint64_t Driver::scope() const
+{
+    const void *options[] = {this->blocks, this->passes};
+    return cache::Hash(reinterpret_cast<const char *>(options), sizeof(options), this->namesHash);
+}
+
+std::unordered_set<std::string> Driver::names(const std::unordered_map<std::string, std::string> &symbols,
+                                              const std::unordered_map<std::string, std::vector<std::string>> &rangeSymbols)
+{
+    auto symbolNames = std::unordered_set<std::string>();
+    std::transform(symbols.begin(), symbols.end(),
+                   std::inserter(symbolNames, symbolNames.end()),
+                   [](auto pair) { return pair.first; });
+
+    std::transform(rangeSymbols.begin(), rangeSymbols.end(),
+                   std::inserter(symbolNames, symbolNames.end()),
+                   [](auto pair) { return pair.first; });
+
+    return symbolNames;
+}
+
+uint64_t Driver::hash(const std::unordered_set<std::string> &names)
+{
+    // Names are summed, the order of a set does not matter.
+    uint64_t result = 0;
+    for (const auto &name : names)
+    {
+        result += cache::Hash(name.data(), name.size());
+    }
+    return result;
+}
+
+bool Driver::render(const Ast &nodes, std::ostream &output)
+{
+    auto hasError = false;
+    if (this->engine == Engine::Bytecode)
+    {
+        auto program = Program();
+        Compiler().Compile(nodes, program);
+        hasError = !Machine(this->symbols, this->rangeSymbols, output, this->error).Run(program);
+    }
+    else
     {
-        n->accept(renderer);
+        // Names are resolved once instead of copying the symbols into the renderer.
+        auto renderer = Renderer(Slots(nodes, this->symbols, this->rangeSymbols), output, this->error);
+        for (auto const &n : nodes)
+        {
+            n.accept(renderer);
+        }
+        hasError = renderer.HasError();
     }
 
-    if (renderer.HasError())
+    if (hasError)
     {
         this->error << "Driver cannot render." << std::endl;
         return false;
@@ -74,4 +536,4 @@ bool Driver::Render(std::istream &input)
 }
 
 } // namespace driver
-} // namespace car
+} // namespace car
\ No newline at end of file
@@ -2,16 +2,25 @@
 #define _CARENDER_DRIVER_HPP_INCLUDED
 
 #include <algorithm>
+#include <cstdint>
 #include <iostream>
+#include <memory>
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
+#include "bytecode.hpp"
+#include "cache.hpp"
+#include "carc.hpp"
 #include "lexer.hpp"
 #include "parser.hpp"
+#include "passes.hpp"
 #include "renderer.hpp"
 
 using car::lexer::Lexer;
 using car::lexer::Token;
+using car::lexer::TokenStream;
 using car::parser::Parser;
 using car::parser::ParserOptions;
 using car::renderer::Renderer;
@@ -24,20 +33,170 @@ namespace driver
 class Driver
 {
 public:
+    /**
+    * Identifies the contents of a regular file, a file that is modified gets a new identity.
+    */
+    struct FileIdentity
+    {
+        uint64_t device;
+        uint64_t inode;
+        uint64_t size;
+        int64_t seconds;
+        int64_t nanoseconds;
+
+        bool operator==(const FileIdentity &rhs) const
+        {
+            return device == rhs.device && inode == rhs.inode && size == rhs.size &&
+                   seconds == rhs.seconds && nanoseconds == rhs.nanoseconds;
+        }
+    };
+
+    /**
+    * Ways a driver renders templates, their output and errors are the same.
+    */
+    enum class Engine
+    {
+        // Visits the syntax tree with a Renderer.
+        Visitor,
+        // Compiles the syntax tree and runs it on a bytecode Machine.
+        Bytecode,
+    };
+
     Driver(
         const std::unordered_map<std::string, std::string> &symbols,
         const std::unordered_map<std::string, std::vector<std::string>> &rangeSymbols,
         std::ostream &output,
         std::ostream &error)
-        : symbols(symbols), rangeSymbols(rangeSymbols), output(output), error(error) {}
+        : symbols(symbols), rangeSymbols(rangeSymbols), output(output), error(error), blocks(nullptr), engine(Engine::Visitor),
+          passes(nullptr), cache(nullptr), symbolNames(names(symbols, rangeSymbols)), namesHash(hash(symbolNames)) {}
 
+    /**
+    * Constructs a driver whose templates may also use the block types in `blocks`, which must outlive it.
+    */
+    Driver(
+        const std::unordered_map<std::string, std::string> &symbols,
+        const std::unordered_map<std::string, std::vector<std::string>> &rangeSymbols,
+        std::ostream &output,
+        std::ostream &error,
+        const parser::BlockRegistry &blocks)
+        : symbols(symbols), rangeSymbols(rangeSymbols), output(output), error(error), blocks(&blocks), engine(Engine::Visitor),
+          passes(nullptr), cache(nullptr), symbolNames(names(symbols, rangeSymbols)), namesHash(hash(symbolNames)) {}
+
+    /**
+    * Selects how templates are rendered, the default is Engine::Visitor.
+    */
+    void UseEngine(Engine engine) { this->engine = engine; }
+
+    /**
+    * Rewrites the syntax trees of templates with `passes` once they are parsed. The passes must outlive the
+    * driver, and what they assume about the symbols must hold for the driver's symbols.
+    */
+    void UsePasses(passes::PassManager &passes) { this->passes = &passes; }
+
+    /**
+    * Keeps the templates the driver parses in `cache`, e.g. TemplateCache::Global(), so that rendering the same
+    * text again does not parse it. The cache must outlive the driver, and its passes must not change while it is used.
+    */
+    void UseCache(cache::TemplateCache &cache) { this->cache = &cache; }
+
+    /**
+    * Renders the template read from `input`. Lexing is fused into parsing, so the input is read into a buffer first.
+    */
     bool Render(std::istream &input);
 
+    /**
+    * Renders the template in the file at `path`. Regular files are mapped into memory and lexed in place,
+    * other files, e.g. pipes, are read into a buffer.
+    */
+    bool RenderFile(const std::string &path);
+
+    /**
+    * Renders the template in the file at `path` to the file descriptor `fd`.
+    * Templates without directives are sent from the file with `sendfile`.
+    */
+    bool RenderFile(const std::string &path, int fd);
+
+    /**
+    * Writes C++ source for the template in the file at `path`, which defines the template function `function`
+    * declared with CARENDER_TEMPLATE. Symbols of the driver are checked if it has any.
+    */
+    bool EmitCpp(const std::string &path, const std::string &function, std::ostream &output);
+
+    /**
+    * Writes the template in the file at `path` to `output` in the .carc format, parsed and rewritten as it would
+    * be for rendering. Symbols of the driver are checked if it has any.
+    */
+    bool Compile(const std::string &path, std::ostream &output);
+
+    /**
+    * Loads the template compiled to the .carc file at `path`, which is mapped into memory and not lexed or parsed.
+    * The template is kept until it is loaded again.
+    */
+    bool LoadCompiled(const std::string &path);
+
+    /**
+    * Renders the compiled template loaded from `path`, it is loaded first if it has not been.
+    */
+    bool RenderCompiled(const std::string &path);
+
 private:
+    /**
+    * Output of a template that does not depend on anything but the symbols of the driver.
+    */
+    struct StaticTemplate
+    {
+        FileIdentity identity;
+        std::string bytes;
+        // True if the template has no directives and its output is the file itself.
+        bool isVerbatim;
+    };
+
+    /**
+    * Renders the template in [begin, end) to `output`. If `path` is given, the output of a static template
+    * is kept for later renders of the file with the same identity.
+    */
+    bool render(const char *begin, const char *end, const std::string *path, std::ostream &output,
+                const FileIdentity &identity = FileIdentity());
+
+    /**
+    * A template loaded from a .carc file.
+    */
+    struct CompiledTemplate
+    {
+        // Contents of the file, which the nodes refer to.
+        std::shared_ptr<const void> file;
+        parser::Ast nodes;
+    };
+
+    const StaticTemplate *findStatic(const std::string &path, const FileIdentity &identity) const;
+
+    bool parse(const char *begin, const char *end, parser::Ast &nodes);
+
+    // Get a hash of what parsing depends on besides the text, which keys the cached templates.
+    uint64_t scope() const;
+
+    static std::unordered_set<std::string> names(const std::unordered_map<std::string, std::string> &symbols,
+                                                 const std::unordered_map<std::string, std::vector<std::string>> &rangeSymbols);
+    static uint64_t hash(const std::unordered_set<std::string> &names);
+
+    bool render(const parser::Ast &nodes, std::ostream &output);
+
+    // Templates rendered from regular files whose output is known, by path.
+    std::unordered_map<std::string, StaticTemplate> statics;
+    // Templates loaded from .carc files, by path.
+    std::unordered_map<std::string, CompiledTemplate> compiled;
+
     std::unordered_map<std::string, std::string> symbols;
     const std::unordered_map<std::string, std::vector<std::string>> rangeSymbols;
     std::ostream &output;
     std::ostream &error;
+    const parser::BlockRegistry *blocks;
+    Engine engine;
+    passes::PassManager *passes;
+    cache::TemplateCache *cache;
+    // Names of the symbols and range symbols the parser checks, and a hash of them.
+    const std::unordered_set<std::string> symbolNames;
+    const uint64_t namesHash;
 };
 
 } // namespace driver
@@ -3,7 +3,11 @@
 #include <string>
 #include <vector>
 #include <fstream>
+#include <sstream>
 
+#include <unistd.h>
+
+#include "codegen.hpp"
 #include "driver.hpp"
 
 using car::driver::Driver;
@@ -67,14 +71,23 @@ readRangeSymbols(std::istream &input)
 
 int main(int argc, char *argv[])
 {
-    if (argc != 2)
+    const auto isEmitCpp = argc == 3 && std::string(argv[1]) == "--emit-cpp";
+    const auto isCompile = argc == 4 && std::string(argv[1]) == "compile";
+    if (argc != 2 && !isEmitCpp && !isCompile)
     {
         std::cout << argv[0] << " reads input from stdin, writes output to stdout and errors to stderr." << std::endl;
         std::cout << "Symbols are read from text file in the environment variable SYMBOLS." << std::endl;
         std::cout << "Range Symbols are read from text file in the environment variable RANGE_SYMBOLS." << std::endl;
+        std::cout << "Templates are rendered on a bytecode machine if the environment variable ENGINE is `bytecode`." << std::endl;
+        std::cout << "Syntax trees are rewritten by the comma-separated passes in the environment variable PASSES, e.g. "
+                  << "`fold-ifeq,remove-empty,merge-text`." << std::endl;
         std::cout << std::endl;
         std::cout << "Example usage: " << std::endl;
         std::cout << "RANGE_SYMBOLS=ranges.txt SYMBOLS=symbols.txt " << argv[0] << " template.car > template.out" << std::endl;
+        std::cout << std::endl;
+        std::cout << argv[0] << " --emit-cpp template.car writes C++ source that renders the template to stdout." << std::endl;
+        std::cout << argv[0] << " compile template.car template.carc writes the parsed template to a file that "
+                  << argv[0] << " renders without parsing it again, e.g. " << argv[0] << " template.carc." << std::endl;
 
         return EXIT_FAILURE;
     }
@@ -110,9 +123,78 @@ int main(int argc, char *argv[])
         }
     }
     auto driver = Driver(symbols, rangeSymbols, std::cout, std::cerr);
+    if (isEmitCpp)
+    {
+        return driver.EmitCpp(argv[2], car::codegen::FunctionName(argv[2]), std::cout) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    if (const char *engine = std::getenv("ENGINE"))
+    {
+        if (std::string(engine) == "bytecode")
+        {
+            driver.UseEngine(Driver::Engine::Bytecode);
+        }
+    }
+
+    // The driver renders with exactly these symbols.
+    auto assumptions = car::passes::Assumptions();
+    for (const auto &pair : symbols)
+    {
+        assumptions.symbols.insert(pair.first);
+    }
+    for (const auto &pair : rangeSymbols)
+    {
+        assumptions.rangeSymbols.insert(pair.first);
+    }
+    assumptions.isExhaustive = true;
+
+    auto passes = car::passes::PassManager();
+    if (const char *names = std::getenv("PASSES"))
+    {
+        car::passes::AddStandardPasses(passes, assumptions);
+        for (const auto &name : {"fold-ifeq", "remove-empty", "merge-text"})
+        {
+            passes.Enable(name, false);
+        }
 
-    auto templ = std::ifstream(argv[1]);
-    auto result = driver.Render(templ) ? EXIT_SUCCESS : EXIT_FAILURE;
+        std::stringstream list(names);
+        std::string name;
+        while (std::getline(list, name, ','))
+        {
+            if (!passes.Enable(name, true))
+            {
+                std::cerr << "Unknown pass `" << name << "`." << std::endl;
+                return EXIT_FAILURE;
+            }
+        }
+        driver.UsePasses(passes);
+    }
+
+    // Passes rewrite the compiled template, they assume the symbols it is compiled with.
+    if (isCompile)
+    {
+        std::ofstream output(argv[3], std::ios::binary);
+        if (!output)
+        {
+            std::cerr << "Cannot open `" << argv[3] << "`." << std::endl;
+            return EXIT_FAILURE;
+        }
+        return driver.Compile(argv[2], output) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    // Compiled templates are not parsed, static templates are sent to stdout without being copied through the process.
+    const auto path = std::string(argv[1]);
+    const auto isCompiled = path.size() > 5 && path.compare(path.size() - 5, 5, ".carc") == 0;
+    auto isRendered = isCompiled ? driver.RenderCompiled(path) : driver.RenderFile(path, STDOUT_FILENO);
+    auto result = isRendered ? EXIT_SUCCESS : EXIT_FAILURE;
+
+    if (std::getenv("DEBUG"))
+    {
+        for (const auto &report : passes.Reports())
+        {
+            std::cerr << report << std::endl;
+        }
+    }
 
     return result;
 }
\ No newline at end of file
@@ -0,0 +1,109 @@
+#ifndef _CARENDER_BLOCKS_HPP_INCLUDED
+#define _CARENDER_BLOCKS_HPP_INCLUDED
+
+#include <cstddef>
+#include <deque>
+#include <ostream>
+#include <string>
+
+#include "interner.hpp"
+#include "stringview.hpp"
+
+namespace car
+{
+namespace parser
+{
+
+class BlockNode;
+
+/**
+* Renders a block of a registered type, it is given to the render hook of the type.
+*/
+class BlockScope
+{
+public:
+    virtual ~BlockScope() = default;
+
+    /**
+    * Get the value of the symbol at index of the block.
+    */
+    virtual const std::string &Value(size_t index) const = 0;
+
+    /**
+    * Get the stream the block renders to.
+    */
+    virtual std::ostream &Output() = 0;
+
+    /**
+    * Get the stream errors are written to.
+    */
+    virtual std::ostream &Error() = 0;
+
+    /**
+    * Renders the children of the block once more after the hook returns.
+    */
+    virtual void RenderChildren() = 0;
+};
+
+/**
+* A block keyword that is not built into the `car` template language.
+* `{{#keyword symbol...}} ... {{/keyword}}` takes `symbols` symbols, which must be defined, and has children.
+*/
+struct BlockType
+{
+    /**
+    * Checks a block once it is parsed, returns false and writes to `error` if it is invalid.
+    */
+    typedef bool (*parseHook)(const BlockNode &node, std::ostream &error);
+
+    /**
+    * Renders a block, returns false and writes to the error stream of `scope` if it cannot be rendered.
+    */
+    typedef bool (*renderHook)(const BlockNode &node, BlockScope &scope);
+
+    std::string keyword;
+    // At most two.
+    int symbols;
+    // Blocks are valid if it is nullptr.
+    parseHook parse;
+    // Children are rendered once if it is nullptr.
+    renderHook render;
+};
+
+/**
+* Block types a parser accepts in addition to `loop` and `ifeq`. Parsed nodes refer to their type,
+* so the registry must outlive them.
+*/
+class BlockRegistry
+{
+public:
+    /**
+    * Constructs a registry without block types.
+    */
+    BlockRegistry() {}
+
+    BlockRegistry(const BlockRegistry &) = delete;
+    BlockRegistry &operator=(const BlockRegistry &) = delete;
+
+    /**
+    * Registers a block type, returns nullptr if its keyword is built in or already registered
+    * or it takes more than two symbols.
+    */
+    const BlockType *Register(const BlockType &type);
+
+    /**
+    * Get the type registered for `keyword`, or nullptr.
+    */
+    const BlockType *Find(string_view keyword) const;
+
+private:
+    // Keywords are interned after the built-in ones, the type of a keyword is at its id minus Interner::Keywords.
+    Interner keywords;
+    // A deque does not move its elements when it grows, nodes refer to them.
+    std::deque<BlockType> types;
+};
+
+} // namespace parser
+} // namespace car
+
+#endif // _CARENDER_BLOCKS_HPP_INCLUDED
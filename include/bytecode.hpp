@@ -0,0 +1,183 @@
+#ifndef _CARENDER_BYTECODE_HPP_INCLUDED
+#define _CARENDER_BYTECODE_HPP_INCLUDED
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "blocks.hpp"
+#include "parser.hpp"
+
+namespace car
+{
+namespace bytecode
+{
+
+/**
+* Operations of the template machine.
+*/
+enum class Op : uint8_t
+{
+    // Writes the text [text, text + a).
+    EmitText,
+    // Writes the value of symbol a.
+    EmitSlot,
+    // Starts a loop over range symbol a with element symbol b, jumps to target if the range is empty.
+    LoopBegin,
+    // Moves to the next element of the innermost loop and jumps to target, or ends the loop.
+    LoopNext,
+    // Jumps to target if the values of symbols a and b differ.
+    JumpIfNe,
+    // Calls the render hook of a registered block, jumps to target if its children are not rendered.
+    BlockBegin,
+    // Renders the children of the innermost registered block again by jumping to target, or ends the block.
+    BlockNext,
+    // Ends the program.
+    Halt,
+};
+
+struct Instruction
+{
+    Op op;
+    // Interned ids of symbols or the size of the text.
+    uint32_t a;
+    uint32_t b;
+    uint32_t target;
+    union
+    {
+        const char *text;
+        // Node the instruction was compiled from, for errors and hooks.
+        const parser::NodeData *node;
+    };
+};
+
+/**
+* Instructions compiled from an Ast, which they refer to and which must outlive them.
+*/
+class Program
+{
+public:
+    /**
+    * Constructs an empty program.
+    */
+    Program() : ast(nullptr) {}
+
+    /**
+    * Get the instructions, the last one halts.
+    */
+    const std::vector<Instruction> &Code() const { return this->code; }
+
+    /**
+    * Get the tree the program was compiled from.
+    */
+    const parser::Ast &Source() const { return *this->ast; }
+
+private:
+    friend class Compiler;
+
+    std::vector<Instruction> code;
+    const parser::Ast *ast;
+};
+
+/**
+* Lowers a syntax tree into a program, without recursion.
+*/
+class Compiler : private parser::Visitor
+{
+public:
+    /**
+    * Compiles `nodes` into `output`, replacing its instructions and reusing their storage.
+    */
+    void Compile(const parser::Ast &nodes, Program &output);
+
+private:
+    void visit(const parser::TextNode &n) override;
+    void visit(const parser::PrintNode &n) override;
+    void visit(const parser::LoopNode &n) override;
+    void visit(const parser::IfEqNode &n) override;
+    void visit(const parser::BlockNode &n) override;
+
+    void emit(Op op, uint32_t a, uint32_t b, const parser::NodeData *node);
+    void open(Op end, const parser::NodeRange &children);
+
+    /**
+    * A block whose children are being compiled.
+    */
+    struct Frame
+    {
+        parser::NodeRange::iterator next;
+        parser::NodeRange::iterator end;
+        // Instruction that jumps past the block, and the operation that ends it or Halt if nothing jumps back.
+        size_t begin;
+        Op close;
+    };
+
+    std::vector<Instruction> *code = nullptr;
+    std::vector<Frame> frames;
+};
+
+/**
+* Executes programs and writes the result to output. Symbols are resolved once per run, not for each use.
+*/
+class Machine : private parser::BlockScope
+{
+public:
+    /**
+    * Constructs a machine that renders with the symbols, errors are the ones a Renderer reports.
+    */
+    Machine(
+        const std::unordered_map<std::string, std::string> &symbols,
+        const std::unordered_map<std::string, std::vector<std::string>> &rangeSymbols,
+        std::ostream &output,
+        std::ostream &error)
+        : symbols(symbols), rangeSymbols(rangeSymbols), output(output), error(error),
+          blockValues{nullptr, nullptr}, blockRenders(0), hasError(false) {}
+
+    /**
+    * Renders the program, returns false if it wrote an error.
+    */
+    bool Run(const Program &program);
+
+    /**
+    * Returns true if the machine has encountered an error and wrote it to the error stream.
+    */
+    bool HasError() const { return this->hasError; }
+
+private:
+    const std::string &Value(size_t index) const override { return *this->blockValues[index]; }
+    std::ostream &Output() override { return this->output; }
+    std::ostream &Error() override { return this->error; }
+    void RenderChildren() override { this->blockRenders++; }
+
+    void resolve(const Interner &names);
+    bool fail(const std::string &message, const std::string &name);
+
+    struct Loop
+    {
+        const std::vector<std::string> *range;
+        size_t index;
+        uint32_t element;
+    };
+
+    const std::unordered_map<std::string, std::string> &symbols;
+    const std::unordered_map<std::string, std::vector<std::string>> &rangeSymbols;
+    std::ostream &output;
+    std::ostream &error;
+
+    // Values by interned id, element symbols refer to the current element of their loop.
+    std::vector<const std::string *> slots;
+    std::vector<const std::vector<std::string> *> rangeSlots;
+    std::vector<Loop> loops;
+    // Remaining renders of the children of each open registered block.
+    std::vector<size_t> blocks;
+    const std::string *blockValues[2];
+    size_t blockRenders;
+    bool hasError;
+};
+
+} // namespace bytecode
+} // namespace car
+
+#endif // _CARENDER_BYTECODE_HPP_INCLUDED
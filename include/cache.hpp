@@ -0,0 +1,113 @@
+#ifndef _CARENDER_CACHE_HPP_INCLUDED
+#define _CARENDER_CACHE_HPP_INCLUDED
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "parser.hpp"
+
+namespace car
+{
+namespace cache
+{
+
+/**
+* Hashes [data, data + size) eight bytes at a time, for keys of whole templates.
+*/
+uint64_t Hash(const char *data, size_t size, uint64_t seed = 0);
+
+/**
+* Counters of a TemplateCache since it was constructed.
+*/
+struct Stats
+{
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+    // Entries cached and the bytes they use.
+    size_t entries;
+    size_t bytes;
+};
+
+/**
+* Compiled templates keyed by a hash of their text and of what they were compiled with, e.g. the symbol names a
+* parser checks. The least recently used templates are evicted when the cached ones use more than a budget of bytes.
+* A cache may be shared by threads, templates it returns stay valid after they are evicted.
+*/
+class TemplateCache
+{
+public:
+    /**
+    * A compiled template, its nodes refer to its copy of the text.
+    */
+    struct Entry
+    {
+        std::string text;
+        uint64_t scope;
+        parser::Ast nodes;
+    };
+
+    /**
+    * Compiles `text` into `nodes`, returns false if it is invalid.
+    */
+    typedef std::function<bool(const std::string &text, parser::Ast &nodes)> Compile;
+
+    /**
+    * Constructs an empty cache whose templates use at most `budget` bytes.
+    */
+    TemplateCache(size_t budget) : budget(budget), stats{0, 0, 0, 0, 0} {}
+
+    TemplateCache(const TemplateCache &) = delete;
+    TemplateCache &operator=(const TemplateCache &) = delete;
+
+    /**
+    * Get the cache shared by the process, its budget is 64 MiB unless it is changed.
+    */
+    static TemplateCache &Global();
+
+    /**
+    * Get the template compiled from `text` in `scope`, a hash of what `compile` depends on besides the text.
+    * Templates that are not cached are compiled and cached, nullptr is returned if they cannot be compiled.
+    */
+    std::shared_ptr<const Entry> Get(string_view text, uint64_t scope, const Compile &compile);
+
+    /**
+    * Changes the budget, templates are evicted until they fit.
+    */
+    void SetBudget(size_t budget);
+
+    /**
+    * Removes all templates, the counters are kept.
+    */
+    void Clear();
+
+    Stats Counters() const;
+
+private:
+    struct Slot
+    {
+        std::shared_ptr<const Entry> entry;
+        uint64_t key;
+        size_t bytes;
+    };
+
+    void evict();
+
+    mutable std::mutex mutex;
+    size_t budget;
+    Stats stats;
+    // Templates from the most to the least recently used, and their positions by key.
+    std::list<Slot> order;
+    std::unordered_map<uint64_t, std::list<Slot>::iterator> slots;
+};
+
+} // namespace cache
+} // namespace car
+
+#endif // _CARENDER_CACHE_HPP_INCLUDED
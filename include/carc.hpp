@@ -0,0 +1,110 @@
+#ifndef _CARENDER_CARC_HPP_INCLUDED
+#define _CARENDER_CARC_HPP_INCLUDED
+
+#include <cstdint>
+#include <ostream>
+
+#include "blocks.hpp"
+#include "parser.hpp"
+
+namespace car
+{
+namespace carc
+{
+
+/**
+* Version of the .carc format, files of other versions are not read.
+*/
+const uint32_t Version = 1;
+
+/**
+* Start of a .carc file. It is followed by the records of the nodes in the arena of the tree and of its top-level
+* nodes, the spans of the interned names and of the keywords of registered blocks, and the strings the spans and
+* TextNodes refer to. Numbers are in the byte order of the machine that wrote the file, which `byteOrder` records.
+*/
+struct Header
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t byteOrder;
+    uint32_t nodes;
+    uint32_t roots;
+    // Names interned after the keywords.
+    uint32_t names;
+    uint32_t blocks;
+    uint32_t reserved;
+    // Size of the strings.
+    uint64_t strings;
+};
+
+/**
+* A node as it is stored in a .carc file. Fields are the ones of NodeData, the children of a block precede it in the
+* arena.
+*/
+struct Record
+{
+    uint8_t type;
+    uint8_t isInvariant;
+    uint16_t reserved;
+    uint32_t symbols[2];
+    uint32_t first;
+    uint32_t count;
+    int32_t start;
+    int32_t end;
+    uint32_t padding;
+    // Offset of the text of a TextNode in the strings, or the index of the keyword of a registered block.
+    uint64_t text;
+};
+
+/**
+* A string in the strings of a .carc file.
+*/
+struct Span
+{
+    uint64_t offset;
+    uint64_t size;
+};
+
+/**
+* Writes syntax trees in the .carc format, which Reader loads without lexing or parsing them again.
+*/
+class Writer
+{
+public:
+    /**
+    * Writes `nodes`, whose blocks must be closed, to `output`. Returns false if the output cannot be written.
+    */
+    bool Write(const parser::Ast &nodes, std::ostream &output);
+};
+
+/**
+* Loads syntax trees from .carc files, e.g. files mapped into memory. Nodes are relocated to the file in one pass
+* over their records, the text of TextNodes is not copied.
+*/
+class Reader
+{
+public:
+    /**
+    * Constructs a reader of trees that use no registered blocks.
+    */
+    Reader() : blocks(nullptr) {}
+
+    /**
+    * Constructs a reader of trees that may use the block types in `blocks`, which must outlive the nodes read.
+    */
+    Reader(const parser::BlockRegistry &blocks) : blocks(&blocks) {}
+
+    /**
+    * Reads the .carc file in [begin, end) into `nodes`, replacing them. TextNodes refer to [begin, end), which must
+    * outlive them. Returns false and writes the reason to `error` if the file is not a valid .carc file.
+    */
+    bool Read(const char *begin, const char *end, parser::Ast &nodes, std::ostream &error);
+
+private:
+    const parser::BlockRegistry *blocks;
+};
+
+} // namespace carc
+} // namespace car
+
+#endif // _CARENDER_CARC_HPP_INCLUDED
@@ -0,0 +1,99 @@
+#ifndef _CARENDER_CODEGEN_HPP_INCLUDED
+#define _CARENDER_CODEGEN_HPP_INCLUDED
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "parser.hpp"
+
+/**
+* Declares or defines a template function generated by `carender --emit-cpp`. The function appends the output
+* to `output` and returns true, or writes the errors a Renderer would to `error` and returns false.
+*/
+#define CARENDER_TEMPLATE(name)                                                                   \
+    bool name(const std::unordered_map<std::string, std::string> &symbols,                       \
+              const std::unordered_map<std::string, std::vector<std::string>> &rangeSymbols,     \
+              std::string &output,                                                                \
+              std::ostream &error)
+
+namespace car
+{
+namespace codegen
+{
+
+/**
+* Looks up the values of `count` names, generated functions index the values instead of hashing names.
+*/
+void Resolve(const std::unordered_map<std::string, std::string> &symbols,
+             const std::unordered_map<std::string, std::vector<std::string>> &rangeSymbols,
+             const char *const *names,
+             size_t count,
+             const std::string **values,
+             const std::vector<std::string> **ranges);
+
+/**
+* Errors of generated functions, they return false.
+*/
+bool SymbolNotFound(std::ostream &error, const char *name);
+bool RangeSymbolNotFound(std::ostream &error, const char *name);
+bool Redefined(std::ostream &error, const char *name, const char *ctx);
+
+/**
+* Get the name of the function generated from the template at `path`, e.g. `render_examples_fruits_template`
+* for `examples/fruits/template.car`.
+*/
+std::string FunctionName(const std::string &path);
+
+/**
+* Generates C++ source for templates: text becomes string literals, prints become writes of resolved values,
+* loops and ifeqs become native control flow.
+*/
+class Generator : private parser::Visitor
+{
+public:
+    /**
+    * Writes the definition of a template function `function` that renders `nodes` to `output`.
+    * Returns false and writes to `error` if the nodes cannot be generated, e.g. registered blocks.
+    */
+    bool Generate(const parser::Ast &nodes, const std::string &function, std::ostream &output, std::ostream &error);
+
+private:
+    void visit(const parser::TextNode &n) override;
+    void visit(const parser::PrintNode &n) override;
+    void visit(const parser::LoopNode &n) override;
+    void visit(const parser::IfEqNode &n) override;
+    void visit(const parser::BlockNode &n) override;
+
+    // Get the index of the name with the interned id in the generated names.
+    size_t slot(uint32_t id);
+    std::ostream &line();
+
+    /**
+    * A block whose children are being generated, `element` is the slot of the element of a loop or -1.
+    */
+    struct Frame
+    {
+        parser::NodeRange::iterator next;
+        parser::NodeRange::iterator end;
+        long element;
+    };
+
+    const parser::Ast *nodes = nullptr;
+    std::stringstream body;
+    std::vector<Frame> frames;
+    // Slot of each interned id, or -1, and the ids of the slots.
+    std::vector<long> slots;
+    std::vector<uint32_t> ids;
+    // Keyword of the first registered block found, they cannot be generated.
+    std::string unsupported;
+};
+
+} // namespace codegen
+} // namespace car
+
+#endif // _CARENDER_CODEGEN_HPP_INCLUDED
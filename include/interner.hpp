@@ -0,0 +1,94 @@
+#ifndef _CARENDER_INTERNER_HPP_INCLUDED
+#define _CARENDER_INTERNER_HPP_INCLUDED
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <unordered_map>
+
+#include "stringview.hpp"
+
+namespace car
+{
+
+/**
+* Assigns dense ids to names, so that names can be compared as integers.
+* Keywords of the `car` template language are interned first and have fixed ids.
+*/
+class Interner
+{
+public:
+    /**
+    * Id of a name that has not been interned.
+    */
+    static const uint32_t None = UINT32_MAX;
+
+    /**
+    * Id of the `loop` keyword.
+    */
+    static const uint32_t Loop = 0;
+
+    /**
+    * Id of the `ifeq` keyword.
+    */
+    static const uint32_t IfEq = 1;
+
+    /**
+    * Number of keywords, the ids of other names follow them.
+    */
+    static const uint32_t Keywords = 2;
+
+    /**
+    * Constructs a table that contains only the keywords.
+    */
+    Interner();
+
+    Interner(const Interner &other);
+    Interner(Interner &&other) = default;
+    Interner &operator=(Interner other);
+
+    /**
+    * Returns the id of `name`, assigning the next id if it has not been interned yet.
+    */
+    uint32_t Intern(string_view name);
+
+    /**
+    * Returns the id of `name`, or None if it has not been interned.
+    */
+    uint32_t Find(string_view name) const;
+
+    /**
+    * Makes the table equal to `other`. Names that both have at the same ids are kept, so assigning a table
+    * with the same names again does not allocate.
+    */
+    void Assign(const Interner &other);
+
+    /**
+    * Removes the names with ids from `count` on.
+    */
+    void Truncate(size_t count);
+
+    /**
+    * Get the name with the id.
+    */
+    const std::string &Name(uint32_t id) const { return this->names[id]; }
+
+    /**
+    * Get the number of interned names.
+    */
+    size_t size() const { return this->names.size(); }
+
+private:
+    struct Hash
+    {
+        size_t operator()(string_view name) const;
+    };
+
+    // A deque does not move its elements when it grows, ids refer to them.
+    std::deque<std::string> names;
+    std::unordered_map<string_view, uint32_t, Hash> ids;
+};
+
+} // namespace car
+
+#endif // _CARENDER_INTERNER_HPP_INCLUDED
@@ -1,12 +1,16 @@
 #ifndef _CARENDER_LEXER_HPP_INCLUDED
 #define _CARENDER_LEXER_HPP_INCLUDED
 
+#include <cstdint>
 #include <string>
 #include <istream>
 #include <ostream>
 #include <vector>
+#include <forward_list>
 
 #include "context.hpp"
+#include "interner.hpp"
+#include "stringview.hpp"
 
 using Context = car::Context;
 
@@ -30,9 +34,10 @@ public:
 
     /**
     * Constructs a Token for the `car` template language.
+    * The token refers to `value` and does not copy it, `id` is the interned id of a Symbol or Keyword.
     */
-    Token(const Type type, const Context context, const std::string value = "")
-        : type(type), value(value), context(context) {}
+    Token(const Type type, const Context context, const string_view value = string_view(), const uint32_t id = Interner::None)
+        : type(type), id(id), value(value), context(context) {}
 
     friend std::ostream &operator<<(std::ostream &os, const Token &tok);
     friend std::ostream &operator<<(std::ostream &os, const Token::Type &type);
@@ -40,12 +45,16 @@ public:
     Token &operator=(const Token &other)
     {
         this->type = other.type;
+        this->id = other.id;
         this->value = other.value;
         this->context = other.context;
 
         return *this;
     }
 
+    /**
+    * Ids are not compared, they are only meaningful within the table that assigned them.
+    */
     bool operator==(const Token &rhs) const
     {
         return (type == rhs.type) && (value == rhs.value) && (context == rhs.context);
@@ -64,7 +73,12 @@ public:
     /**
     * Get value of the Token.
     */
-    const std::string &GetValue() const { return this->value; }
+    string_view GetValue() const { return this->value; }
+
+    /**
+    * Get the interned id of a Symbol or Keyword, or Interner::None.
+    */
+    uint32_t GetId() const { return this->id; }
 
     /**
     * Get context of the Token.
@@ -73,20 +87,129 @@ public:
 
 private:
     Type type;
-    std::string value;
+    uint32_t id;
+    string_view value;
     Context context;
 };
 
+class TokenStream
+{
+public:
+    /**
+    * Constructs an empty token stream.
+    */
+    TokenStream() : TokenStream(nullptr, nullptr) {}
+
+    /**
+    * Constructs an empty token stream for tokens lexed from the buffer [begin, end).
+    */
+    TokenStream(const char *begin, const char *end) : source(begin), sourceSize(end - begin) {}
+
+    /**
+    * Appends a token. Tokens whose value is the source range of their context are stored
+    * as a type and two offsets, other tokens are kept aside and refer to their value.
+    * Symbol and Keyword values are interned into the names of the stream.
+    */
+    void push_back(const Token &token);
+
+    /**
+    * Removes all tokens and makes the stream refer to the buffer [begin, end).
+    */
+    void reset(const char *begin, const char *end);
+
+    /**
+    * Removes the first `count` tokens, the rest are moved to the front. Interned names are kept.
+    */
+    void erase_front(size_t count);
+
+    /**
+    * Get the number of tokens.
+    */
+    size_t size() const { return this->types.size(); }
+
+    /**
+    * Get the type of the token at index.
+    */
+    Token::Type GetType(size_t index) const
+    {
+        return static_cast<Token::Type>(this->types[index] & typeMask);
+    }
+
+    /**
+    * Get the interned id of the Symbol or Keyword at index, or Interner::None.
+    */
+    uint32_t GetId(size_t index) const
+    {
+        if (this->types[index] & irregular)
+        {
+            return this->irregulars[this->starts[index]].GetId();
+        }
+        return hasId(this->GetType(index)) ? this->ends[index] : Interner::None;
+    }
+
+    /**
+    * Get the token at index.
+    */
+    Token operator[](size_t index) const;
+
+    /**
+    * Get the names interned by the tokens.
+    */
+    const Interner &Names() const { return this->names; }
+
+    /**
+    * Get the number of bytes used to store the tokens.
+    */
+    size_t MemoryUsage() const;
+
+private:
+    static const uint8_t typeMask = 0x7f;
+    static const uint8_t irregular = 0x80;
+
+    static bool hasId(Token::Type type)
+    {
+        return type == Token::Type::Keyword || type == Token::Type::Symbol;
+    }
+
+    const char *source;
+    size_t sourceSize;
+    Interner names;
+
+    std::vector<uint8_t> types;
+    std::vector<uint32_t> starts;
+    // Symbols and Keywords store their id instead, their end is the start plus the length of their name.
+    std::vector<uint32_t> ends;
+    // Tokens that cannot be restored from their type and offsets, indexed by their start.
+    std::vector<Token> irregulars;
+};
+
 class TokenFactory
 {
 public:
-    static const Token newStartDirective(const Context context);
-    static const Token newEndDirective(const Context context);
-    static const Token newStartBlock(const Context context);
-    static const Token newEndBlock(const Context context);
-    static const Token newKeyword(const std::string text, const Context context);
-    static const Token newSymbol(const std::string text, const Context context);
-    static const Token newText(const std::string text, const Context context);
+    static Token newStartDirective(const Context context);
+    static Token newEndDirective(const Context context);
+    static Token newStartBlock(const Context context);
+    static Token newEndBlock(const Context context);
+    static Token newKeyword(const string_view text, const Context context, const uint32_t id = Interner::None);
+    static Token newSymbol(const string_view text, const Context context, const uint32_t id = Interner::None);
+    static Token newText(const string_view text, const Context context);
+};
+
+class TokenSource
+{
+public:
+    virtual ~TokenSource() = default;
+
+    /**
+    * Appends the next tokens to `output`, returns false if there are no more tokens.
+    * Lexing errors are written to `error`.
+    */
+    virtual bool Pull(TokenStream &output, std::ostream &error) = 0;
+
+    /**
+    * Returns true if lexing has failed.
+    */
+    virtual bool HasError() const = 0;
 };
 
 class Lexer
@@ -99,16 +222,120 @@ public:
 
     /**
     * Lexes `car` template language into tokens.
+    * Token values refer to a copy of the input owned by the lexer, their ids to the names of the lexer.
     */
     bool lex(std::istream &input, std::vector<Token> &output, std::ostream &error);
 
+    /**
+    * Lexes `car` template language in the contiguous buffer [begin, end) into tokens.
+    * Token values refer to the buffer, which must outlive them, their ids to the names of the lexer.
+    */
+    bool lex(const char *begin, const char *end, std::vector<Token> &output, std::ostream &error);
+
+    /**
+    * Lexes `car` template language in the contiguous buffer [begin, end) into tokens on up to `threads` threads.
+    * The output is the same as lexing the buffer on a single thread.
+    */
+    bool lex(const char *begin, const char *end, std::vector<Token> &output, std::ostream &error, unsigned threads);
+
+    /**
+    * Lexes `car` template language into a token stream.
+    * Token values refer to a copy of the input owned by the lexer.
+    */
+    bool lex(std::istream &input, TokenStream &output, std::ostream &error);
+
+    /**
+    * Lexes `car` template language in the contiguous buffer [begin, end) into a token stream.
+    * An empty stream is reset to refer to the buffer, which must outlive it.
+    */
+    bool lex(const char *begin, const char *end, TokenStream &output, std::ostream &error);
+
+    /**
+    * Lexes the next chunk of `car` template language, which may split tokens at any character.
+    * Appends the tokens that are complete, the rest of the chunk is kept until more input is fed.
+    * Token values refer to input owned by the lexer and are valid until the next call to `feed` or `finish`,
+    * which also invalidates the values of tokens lexed from streams.
+    */
+    void feed(const char *begin, const char *end, std::vector<Token> &output);
+
+    /**
+    * Lexes the rest of the input fed in chunks and reports errors, including the ones in chunks already fed.
+    * A later `feed` starts a new input.
+    * Token values refer to input owned by the lexer and are valid until the next call to `feed` or `finish`.
+    */
+    bool finish(std::vector<Token> &output, std::ostream &error);
+
+    /**
+    * Get the names interned by the tokens lexed into vectors.
+    */
+    const Interner &Names() const { return this->names; }
+
 private:
-    const std::string readIdentifier(std::istream &input);
+    friend class BufferTokenSource;
+
+    template <typename Output>
+    bool lexBuffer(const char *begin, const char *end, long offset, Output &output, std::ostream &error);
+
+    const std::string &read(std::istream &input);
+
+    // Tokens lexed from input that may be incomplete, their ids are assigned once they are final.
+    struct Lookahead
+    {
+        void push_back(const Token &token) { this->tokens.push_back(token); }
+
+        std::vector<Token> tokens;
+    };
+
+    /**
+    * Lexes [begin, end) into the lookahead, returns the number of tokens that are final whatever follows the input.
+    * The token after them is the StartDirective lexing can resume at.
+    */
+    size_t lexAhead(const char *begin, const char *end, long offset);
+
+    // A TokenStream interns the values pushed to it.
+    uint32_t intern(std::vector<Token> &, string_view value) { return this->names.Intern(value); }
+    uint32_t intern(TokenStream &, string_view) { return Interner::None; }
+    uint32_t intern(Lookahead &, string_view) { return Interner::None; }
+
+    Interner names;
+
+    // Input read from streams and values that are not contiguous in the input, tokens refer to them.
+    std::forward_list<std::string> buffers;
+
+    // Input fed in chunks that has not been returned as tokens, starting at `offset` in the whole input.
+    // The first `consumed` characters are referred to by the tokens returned by the last call to `feed`.
+    std::string pending;
+    long offset = 0;
+    size_t consumed = 0;
+    Lookahead lookahead;
 
     bool isInDirective = false;
     bool isInBlock = false;
 };
 
+class BufferTokenSource : public TokenSource
+{
+public:
+    /**
+    * Constructs a source that lexes the contiguous buffer [begin, end) as its tokens are pulled,
+    * about `window` characters at a time. Token values refer to the buffer, which must outlive them.
+    */
+    BufferTokenSource(Lexer &lexer, const char *begin, const char *end, size_t window = 64 * 1024)
+        : lexer(lexer), begin(begin), position(begin), end(end), window(window), hasError(false) {}
+
+    bool Pull(TokenStream &output, std::ostream &error) override;
+
+    bool HasError() const override { return this->hasError; }
+
+private:
+    Lexer &lexer;
+    const char *const begin;
+    const char *position;
+    const char *const end;
+    size_t window;
+    bool hasError;
+};
+
 } // namespace lexer
 } // namespace car
 #endif // _CARENDER_LEXER_HPP_INCLUDED
\ No newline at end of file
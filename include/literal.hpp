@@ -0,0 +1,780 @@
+#ifndef _CARENDER_LITERAL_HPP_INCLUDED
+#define _CARENDER_LITERAL_HPP_INCLUDED
+
+// Literal templates are lexed and parsed by constexpr functions, which need C++17, e.g. `make CSTD=c++17`.
+#if __cplusplus >= 201703L
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "codegen.hpp"
+#include "context.hpp"
+#include "stringview.hpp"
+
+/**
+* Declares `name` as the literal template `text`, a string literal. The template is lexed and parsed while
+* compiling, syntax errors are compile errors.
+*/
+#define CARENDER_LITERAL(name, text)                                  \
+    struct name##Source                                               \
+    {                                                                 \
+        static constexpr car::string_view Text()                      \
+        {                                                             \
+            return car::string_view(text, sizeof(text) - 1);          \
+        }                                                             \
+    };                                                                \
+    using name = car::literal::Template<name##Source>
+
+namespace car
+{
+namespace literal
+{
+
+/**
+* Reports a syntax error of a literal template. It is not constexpr, calling it while compiling a template is a
+* compile error whose diagnostic points at the call and its message.
+*/
+inline void TemplateSyntaxError(const char *) {}
+
+enum class TokenType : uint8_t
+{
+    StartDirective,
+    EndDirective,
+    StartBlock,
+    EndBlock,
+    Text,
+    Keyword,
+    Symbol,
+};
+
+/**
+* A token of a literal template. Its value is the character at `head` followed by `size - 1` characters from
+* `tail`, the lexer drops whitespace after the first character of a symbol.
+*/
+struct Token
+{
+    TokenType type = TokenType::Text;
+    size_t head = 0;
+    size_t tail = 0;
+    size_t size = 0;
+    // Source range.
+    size_t start = 0;
+    size_t end = 0;
+};
+
+template <size_t Capacity>
+struct Tokens
+{
+    std::array<Token, Capacity> items{};
+    size_t size = 0;
+};
+
+enum class NodeType : uint8_t
+{
+    Text,
+    Print,
+    Loop,
+    IfEq,
+};
+
+/**
+* A node of a literal template. Blocks are followed by their children, `next` is the index after them.
+*/
+struct Node
+{
+    NodeType type = NodeType::Text;
+    // Text range, or the slots of the symbols.
+    size_t begin = 0;
+    size_t size = 0;
+    size_t symbols[2] = {0, 0};
+    size_t next = 0;
+    size_t count = 0;
+    // Context of a block.
+    int start = 0;
+    int end = 0;
+};
+
+/**
+* Nodes of a literal template in a flat array and the tokens that name each symbol slot.
+*/
+template <size_t Capacity>
+struct Tree
+{
+    std::array<Node, Capacity> nodes{};
+    size_t size = 0;
+    // Number of top-level nodes.
+    size_t roots = 0;
+    std::array<Token, Capacity> names{};
+    size_t slots = 0;
+    // Size of the names with their terminating nulls.
+    size_t nameBytes = 0;
+};
+
+constexpr bool isSpace(char c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\v' || c == '\f' || c == '\r';
+}
+
+constexpr char at(string_view text, const Token &token, size_t i)
+{
+    return i == 0 ? text[token.head] : text[token.tail + i - 1];
+}
+
+constexpr bool equal(string_view text, const Token &left, const Token &right)
+{
+    if (left.size != right.size)
+    {
+        return false;
+    }
+    for (size_t i = 0; i < left.size; i++)
+    {
+        if (at(text, left, i) != at(text, right, i))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+constexpr bool equal(string_view text, const Token &token, string_view value)
+{
+    if (token.size != value.size())
+    {
+        return false;
+    }
+    for (size_t i = 0; i < value.size(); i++)
+    {
+        if (at(text, token, i) != value[i])
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+* Lexes `text` as lexer::Lexer does, a template has at most as many tokens as characters.
+*/
+template <size_t Capacity>
+constexpr Tokens<Capacity> lex(string_view text)
+{
+    auto output = Tokens<Capacity>();
+    auto push = [&](TokenType type, size_t head, size_t tail, size_t size, size_t start, size_t end) {
+        output.items[output.size++] = Token{type, head, tail, size, start, end};
+    };
+    auto skipWhitespace = [&](size_t &it) {
+        while (it != text.size() && isSpace(text[it]))
+        {
+            it++;
+        }
+    };
+
+    auto isInDirective = false;
+    auto isInBlock = false;
+    char prevC = ' ';
+    size_t textPos = 0;
+    size_t textSize = 0;
+
+    for (size_t it = 0; it != text.size();)
+    {
+        const auto c = text[it++];
+        const auto hasNext = it != text.size();
+        if (isInDirective && isInBlock)
+        {
+            // Token can be a Symbol or an EndDirective.
+            if (isSpace(c))
+            {
+                push(TokenType::Symbol, textPos, textPos + 1, textSize, textPos, it - 1);
+                textSize = 0;
+                skipWhitespace(it);
+            }
+            else if (c == '}' && prevC == '}')
+            {
+                push(TokenType::EndDirective, 0, 0, 0, it - 2, it);
+                // Consume a single newline after EndDirective, do not consume spaces.
+                if (it != text.size() && text[it] == '\r')
+                {
+                    it++;
+                }
+                if (it != text.size() && text[it] == '\n')
+                {
+                    it++;
+                }
+                isInBlock = false;
+                isInDirective = false;
+            }
+            else if (c == '}' && hasNext && text[it] == '}')
+            {
+                if (textSize != 0)
+                {
+                    push(TokenType::Symbol, textPos, textPos + 1, textSize, textPos, textPos + textSize);
+                    textSize = 0;
+                }
+                prevC = c;
+                continue;
+            }
+            else
+            {
+                textPos = textSize == 0 ? it - 1 : textPos;
+                textSize++;
+            }
+        }
+        else if (isInDirective)
+        {
+            // Token can be a StartBlock, an EndBlock or a Symbol, which may be preceded by a keyword.
+            const auto symbolStart = it - 1;
+            auto isSymbol = false;
+            switch (c)
+            {
+            case '#':
+                push(TokenType::StartBlock, 0, 0, 0, it - 1, it);
+                break;
+            case '/':
+                push(TokenType::EndBlock, 0, 0, 0, it - 1, it);
+                break;
+            case '}':
+                if (hasNext && text[it] == '}')
+                {
+                    it++;
+                    isInBlock = false;
+                    isInDirective = false;
+                    push(TokenType::EndDirective, 0, 0, 0, it - 2, it);
+                    continue;
+                }
+                TemplateSyntaxError("Unexpected token '}'.");
+                return output;
+            default:
+                isSymbol = true;
+                break;
+            }
+
+            skipWhitespace(it);
+            const auto identifier = it;
+            while (it != text.size() && !isSpace(text[it]) && text[it] != '}')
+            {
+                it++;
+            }
+
+            if (!isSymbol && it == identifier)
+            {
+                TemplateSyntaxError("Expected keyword.");
+                return output;
+            }
+
+            if (isSymbol)
+            {
+                push(TokenType::Symbol, symbolStart, identifier, it - identifier + 1, symbolStart, it);
+            }
+            else
+            {
+                push(TokenType::Keyword, identifier, identifier + 1, it - identifier, identifier, it);
+            }
+            skipWhitespace(it);
+            isInBlock = !isSymbol;
+        }
+        else
+        {
+            // Token can be either a Text or a StartDirective.
+            if (c == '{' && prevC == '{')
+            {
+                if (textSize != 0)
+                {
+                    push(TokenType::Text, textPos, textPos + 1, textSize, textPos, it - 2);
+                    textSize = 0;
+                }
+                push(TokenType::StartDirective, 0, 0, 0, it - 2, it);
+                isInDirective = true;
+                skipWhitespace(it);
+            }
+            else if (c == '{' && hasNext && text[it] == '{')
+            {
+                prevC = c;
+                continue;
+            }
+            else
+            {
+                textPos = textSize == 0 ? it - 1 : textPos;
+                textSize++;
+            }
+        }
+
+        prevC = c;
+    }
+
+    if (textSize != 0)
+    {
+        push(TokenType::Text, textPos, textPos + 1, textSize, textPos, textPos + textSize);
+    }
+
+    if (isInBlock)
+    {
+        TemplateSyntaxError("Block not closed.");
+    }
+    else if (isInDirective)
+    {
+        TemplateSyntaxError("Directive not closed.");
+    }
+
+    return output;
+}
+
+/**
+* Lexes and parses `text` as lexer::Lexer and parser::Parser do without symbol checks and registered blocks.
+*/
+template <size_t Capacity>
+constexpr Tree<Capacity> compile(string_view text)
+{
+    const auto tokens = lex<Capacity>(text);
+    auto output = Tree<Capacity>();
+    // Indices of the open blocks.
+    std::array<size_t, Capacity> frames{};
+    size_t depth = 0;
+
+    auto add = [&](NodeType type) -> Node & {
+        if (depth == 0)
+        {
+            output.roots++;
+        }
+        else
+        {
+            output.nodes[frames[depth - 1]].count++;
+        }
+        auto &node = output.nodes[output.size++];
+        node.type = type;
+        node.next = output.size;
+        return node;
+    };
+
+    // Symbols get a slot per name in the order they first appear.
+    auto slot = [&](const Token &token) {
+        for (size_t i = 0; i < output.slots; i++)
+        {
+            if (equal(text, output.names[i], token))
+            {
+                return i;
+            }
+        }
+        output.names[output.slots] = token;
+        output.nameBytes += token.size + 1;
+        return output.slots++;
+    };
+
+    auto isType = [&](size_t index, TokenType type) {
+        return index < tokens.size && tokens.items[index].type == type;
+    };
+
+    size_t it = 0;
+    while (it < tokens.size)
+    {
+        if (isType(it, TokenType::Text))
+        {
+            auto &node = add(NodeType::Text);
+            node.begin = tokens.items[it].start;
+            node.size = tokens.items[it].size;
+            it++;
+            continue;
+        }
+
+        if (!isType(it, TokenType::StartDirective))
+        {
+            TemplateSyntaxError("Text or StartDirective expected.");
+            return output;
+        }
+
+        if (isType(it + 1, TokenType::Symbol))
+        {
+            if (!isType(it + 2, TokenType::EndDirective))
+            {
+                TemplateSyntaxError("Expected EndDirective after a symbol.");
+                return output;
+            }
+
+            auto &node = add(NodeType::Print);
+            node.symbols[0] = slot(tokens.items[it + 1]);
+            it += 3;
+            continue;
+        }
+
+        if (isType(it + 1, TokenType::StartBlock))
+        {
+            // {{#loop range element}} or {{#ifeq symbol symbol}}, children and {{/keyword}}.
+            if (!isType(it + 2, TokenType::Keyword))
+            {
+                TemplateSyntaxError("Expected Keyword.");
+                return output;
+            }
+
+            const auto &keyword = tokens.items[it + 2];
+            const auto isLoop = equal(text, keyword, "loop");
+            if (!isLoop && !equal(text, keyword, "ifeq"))
+            {
+                TemplateSyntaxError("Unsupported keyword.");
+                return output;
+            }
+
+            if (!isType(it + 3, TokenType::Symbol) || !isType(it + 4, TokenType::Symbol))
+            {
+                TemplateSyntaxError("Expected 2 symbols.");
+                return output;
+            }
+
+            if (!isType(it + 5, TokenType::EndDirective))
+            {
+                TemplateSyntaxError("Expected EndDirective after the symbols.");
+                return output;
+            }
+
+            const auto index = output.size;
+            auto &node = add(isLoop ? NodeType::Loop : NodeType::IfEq);
+            node.symbols[0] = slot(tokens.items[it + 3]);
+            node.symbols[1] = slot(tokens.items[it + 4]);
+            node.start = static_cast<int>(tokens.items[it + 3].start);
+            frames[depth++] = index;
+            it += 6;
+            continue;
+        }
+
+        if (isType(it + 1, TokenType::EndBlock))
+        {
+            if (depth == 0)
+            {
+                TemplateSyntaxError("Block closed that is not open.");
+                return output;
+            }
+
+            auto &block = output.nodes[frames[depth - 1]];
+            if (block.count == 0)
+            {
+                TemplateSyntaxError("Block node must have children.");
+                return output;
+            }
+
+            if (!isType(it + 2, TokenType::Keyword) ||
+                !equal(text, tokens.items[it + 2], block.type == NodeType::Loop ? "loop" : "ifeq"))
+            {
+                TemplateSyntaxError("Expected the Keyword of the open block.");
+                return output;
+            }
+
+            if (!isType(it + 3, TokenType::EndDirective))
+            {
+                TemplateSyntaxError("Expected EndDirective after the keyword.");
+                return output;
+            }
+
+            block.next = output.size;
+            block.end = static_cast<int>(tokens.items[it + 3].end);
+            depth--;
+            it += 4;
+            continue;
+        }
+
+        TemplateSyntaxError("Text or StartDirective expected.");
+        return output;
+    }
+
+    if (depth != 0)
+    {
+        TemplateSyntaxError("Block not closed before EOF.");
+    }
+
+    return output;
+}
+
+/**
+* A template lexed and parsed while compiling, `Source::Text()` returns its text.
+*/
+template <typename Source>
+struct Compiled
+{
+    static constexpr auto Capacity = Source::Text().size() + 1;
+    static constexpr auto tree = compile<Capacity>(Source::Text());
+    // Arrays of symbols have at least one element.
+    static constexpr auto Slots = tree.slots == 0 ? 1 : tree.slots;
+
+    // The names of the slots, each followed by a null.
+    static constexpr auto chars = []() {
+        auto output = std::array<char, tree.nameBytes + 1>();
+        size_t it = 0;
+        for (size_t i = 0; i < tree.slots; i++)
+        {
+            for (size_t c = 0; c < tree.names[i].size; c++)
+            {
+                output[it++] = at(Source::Text(), tree.names[i], c);
+            }
+            output[it++] = '\0';
+        }
+        return output;
+    }();
+
+    static constexpr auto offsets = []() {
+        auto output = std::array<size_t, Slots>();
+        size_t it = 0;
+        for (size_t i = 0; i < tree.slots; i++)
+        {
+            output[i] = it;
+            it += tree.names[i].size + 1;
+        }
+        return output;
+    }();
+
+    template <size_t... I>
+    static constexpr std::array<const char *, Slots> pointers(std::index_sequence<I...>)
+    {
+        return {{&chars[offsets[I]]...}};
+    }
+
+    static constexpr auto names = pointers(std::make_index_sequence<Slots>());
+};
+
+/**
+* Whether `Source::Text()` is a template, i.e. false where compiling it would be a compile error.
+*/
+template <typename Source, typename = void>
+struct IsValid : std::false_type
+{
+};
+
+template <typename Source>
+struct IsValid<Source, std::void_t<std::integral_constant<size_t, compile<Source::Text().size() + 1>(Source::Text()).size>>>
+    : std::true_type
+{
+};
+
+/**
+* Values of the symbol slots of a literal template while it is rendered.
+*/
+template <size_t Slots>
+struct Scope
+{
+    const std::string *values[Slots];
+    const std::vector<std::string> *ranges[Slots];
+    const char *const *names;
+    std::string &output;
+    std::ostream &error;
+};
+
+template <typename... Nodes>
+struct NodeList
+{
+    template <typename S>
+    static bool Render(S &scope)
+    {
+        return (Nodes::Render(scope) && ...);
+    }
+};
+
+template <typename Source, size_t Begin, size_t Size>
+struct Text
+{
+    template <typename S>
+    static bool Render(S &scope)
+    {
+        scope.output.append(Source::Text().data() + Begin, Size);
+        return true;
+    }
+};
+
+template <size_t Symbol>
+struct Print
+{
+    template <typename S>
+    static bool Render(S &scope)
+    {
+        if (scope.values[Symbol] == nullptr)
+        {
+            return codegen::SymbolNotFound(scope.error, scope.names[Symbol]);
+        }
+        scope.output += *scope.values[Symbol];
+        return true;
+    }
+};
+
+template <size_t Range, size_t Element, int Start, int End, typename Children>
+struct Loop
+{
+    template <typename S>
+    static bool Render(S &scope)
+    {
+        if (scope.ranges[Range] == nullptr)
+        {
+            return codegen::RangeSymbolNotFound(scope.error, scope.names[Range]);
+        }
+        if (scope.values[Element] != nullptr)
+        {
+            std::stringstream ctx;
+            ctx << Context(Start, End);
+            return codegen::Redefined(scope.error, scope.names[Element], ctx.str().c_str());
+        }
+
+        for (const auto &element : *scope.ranges[Range])
+        {
+            scope.values[Element] = &element;
+            if (!Children::Render(scope))
+            {
+                return false;
+            }
+        }
+        scope.values[Element] = nullptr;
+        return true;
+    }
+};
+
+template <size_t Left, size_t Right, typename Children>
+struct IfEq
+{
+    template <typename S>
+    static bool Render(S &scope)
+    {
+        if (scope.values[Left] == nullptr)
+        {
+            return codegen::SymbolNotFound(scope.error, scope.names[Left]);
+        }
+        if (scope.values[Right] == nullptr)
+        {
+            return codegen::SymbolNotFound(scope.error, scope.names[Right]);
+        }
+        return *scope.values[Left] != *scope.values[Right] || Children::Render(scope);
+    }
+};
+
+/**
+* Indices of the `Count` sibling nodes from `First` of a literal template.
+*/
+template <typename Source, size_t First, size_t Count>
+constexpr auto siblings = []() {
+    auto output = std::array<size_t, Count>();
+    auto it = First;
+    for (size_t i = 0; i < Count; i++)
+    {
+        output[i] = it;
+        it = Compiled<Source>::tree.nodes[it].next;
+    }
+    return output;
+}();
+
+template <typename Source, size_t First, typename Sequence>
+struct Children;
+
+template <typename Source, size_t Index, NodeType Type = Compiled<Source>::tree.nodes[Index].type>
+struct NodeAt;
+
+template <typename Source, size_t First, size_t... I>
+struct Children<Source, First, std::index_sequence<I...>>
+{
+    using type = NodeList<typename NodeAt<Source, siblings<Source, First, sizeof...(I)>[I]>::type...>;
+};
+
+template <typename Source, size_t Index>
+struct NodeAt<Source, Index, NodeType::Text>
+{
+    static constexpr auto node = Compiled<Source>::tree.nodes[Index];
+    using type = Text<Source, node.begin, node.size>;
+};
+
+template <typename Source, size_t Index>
+struct NodeAt<Source, Index, NodeType::Print>
+{
+    static constexpr auto node = Compiled<Source>::tree.nodes[Index];
+    using type = Print<node.symbols[0]>;
+};
+
+template <typename Source, size_t Index>
+struct NodeAt<Source, Index, NodeType::Loop>
+{
+    static constexpr auto node = Compiled<Source>::tree.nodes[Index];
+    using type = Loop<node.symbols[0], node.symbols[1], node.start, node.end,
+                      typename Children<Source, Index + 1, std::make_index_sequence<node.count>>::type>;
+};
+
+template <typename Source, size_t Index>
+struct NodeAt<Source, Index, NodeType::IfEq>
+{
+    static constexpr auto node = Compiled<Source>::tree.nodes[Index];
+    using type = IfEq<node.symbols[0], node.symbols[1],
+                      typename Children<Source, Index + 1, std::make_index_sequence<node.count>>::type>;
+};
+
+/**
+* A template whose text is known while compiling. Its nodes are a type, e.g.
+* `NodeList<Text<Source, 0, 6>, Print<0>>` for `Hello {{name}}`, which renders without a lexer or parser.
+*/
+template <typename Source>
+class Template
+{
+public:
+    using Nodes = typename Children<Source, 0, std::make_index_sequence<Compiled<Source>::tree.roots>>::type;
+
+    /**
+    * Get the text of the template.
+    */
+    static constexpr string_view Text() { return Source::Text(); }
+
+    /**
+    * Get the number of distinct symbol names of the template.
+    */
+    static constexpr size_t SymbolCount() { return Compiled<Source>::tree.slots; }
+
+    /**
+    * Appends the template rendered with the symbols to `output` and returns true, or writes the errors a
+    * Renderer would to `error` and returns false.
+    */
+    static bool Render(const std::unordered_map<std::string, std::string> &symbols,
+                       const std::unordered_map<std::string, std::vector<std::string>> &rangeSymbols,
+                       std::string &output,
+                       std::ostream &error)
+    {
+        using Data = Compiled<Source>;
+        auto scope = Scope<Data::Slots>{{}, {}, Data::names.data(), output, error};
+        codegen::Resolve(symbols, rangeSymbols, Data::names.data(), Data::tree.slots, scope.values, scope.ranges);
+        return Nodes::Render(scope);
+    }
+};
+
+#if __cpp_nontype_template_args >= 201911L
+
+/**
+* A string literal that can be a template argument in C++20.
+*/
+template <size_t N>
+struct FixedString
+{
+    constexpr FixedString(const char (&text)[N])
+    {
+        for (size_t i = 0; i < N; i++)
+        {
+            chars[i] = text[i];
+        }
+    }
+
+    char chars[N] = {};
+};
+
+template <FixedString S>
+struct FixedSource
+{
+    static constexpr string_view Text() { return string_view(S.chars, sizeof(S.chars) - 1); }
+};
+
+/**
+* A literal template in C++20, e.g. `car::literal::Literal<"Hello {{name}}">::Render(...)`.
+*/
+template <FixedString S>
+using Literal = Template<FixedSource<S>>;
+
+#endif // __cpp_nontype_template_args >= 201911L
+
+} // namespace literal
+} // namespace car
+
+#endif // __cplusplus >= 201703L
+
+#endif // _CARENDER_LITERAL_HPP_INCLUDED
@@ -1,25 +1,40 @@
 #ifndef _CARENDER_PARSER_HPP_INCLUDED
 #define _CARENDER_PARSER_HPP_INCLUDED
 
+#include <cstdint>
+#include <memory>
 #include <string>
 #include <vector>
 #include <unordered_map>
 #include <unordered_set>
-#include <memory>
 #include <iostream>
 
+#include "blocks.hpp"
 #include "context.hpp"
 #include "lexer.hpp"
 
 namespace car
 {
+namespace carc
+{
+class Reader;
+class Writer;
+} // namespace carc
+
+namespace registry
+{
+class TemplateRegistry;
+} // namespace registry
+
 namespace parser
 {
 
+class Ast;
 class TextNode;
 class PrintNode;
 class LoopNode;
 class IfEqNode;
+class BlockNode;
 
 class Visitor
 {
@@ -30,189 +45,399 @@ public:
     virtual void visit(const PrintNode &n) = 0;
     virtual void visit(const LoopNode &n) = 0;
     virtual void visit(const IfEqNode &n) = 0;
+    virtual void visit(const BlockNode &n) = 0;
+};
+
+/**
+* A node as it is stored in the arena of an Ast.
+*/
+struct NodeData
+{
+    enum class Type : uint8_t
+    {
+        Text,
+        Print,
+        Loop,
+        IfEq,
+        Block,
+    };
+
+    Type type;
+    // True unless the node uses the element of the loop it is a child of or renders a registered block with a hook,
+    // the node then renders the same on each iteration of the loop.
+    bool isInvariant;
+    // Interned ids of the printed symbol, the range and element symbols of a loop, the left and right symbols of an ifeq
+    // or the symbols of a registered block.
+    uint32_t symbols[2];
+    // Children of a block are the nodes [first, first + count) of the arena, the text of a TextNode is [text, text + count).
+    uint32_t first;
+    uint32_t count;
+    Context ctx;
+    union
+    {
+        const char *text;
+        // Type of a registered block.
+        const BlockType *block;
+    };
 };
 
+/**
+* A node of an Ast. Nodes are handles to the arena of their Ast, which must outlive them.
+*/
 class Node
 {
 public:
-    virtual ~Node() = default;
+    Node(const Ast &ast, const NodeData &data) : ast(&ast), data(&data) {}
 
     /**
-    * Accept a visitor.
+    * Accept a visitor, which visits the node as its concrete type.
     */
-    virtual void accept(Visitor &v) = 0;
+    void accept(Visitor &v) const;
 
     /**
     * Get context of the node.
     */
-    const Context &Ctx() const { return this->ctx; }
+    const Context &Ctx() const { return this->data->ctx; }
+
+    /**
+    * Get the entry of the node in the arena of its Ast.
+    */
+    const NodeData &Data() const { return *this->data; }
 
 protected:
-    Node(Context ctx) : ctx(ctx) {}
+    const std::string &name(size_t index) const;
 
-    const Context ctx;
+    const Ast *ast;
+    const NodeData *data;
 };
 
-class PrintNode : public Node
+/**
+* A range of sibling nodes, contiguous in the arena of their Ast.
+*/
+class NodeRange
 {
 public:
-    virtual ~PrintNode() = default;
+    class iterator
+    {
+    public:
+        iterator(const Ast &ast, const NodeData *data) : ast(&ast), data(data) {}
 
-    /**
-    * Constructs a PrintNode.
-    */
-    PrintNode(std::string symbol, Context ctx) : Node(ctx), symbol(symbol) {}
+        Node operator*() const { return Node(*this->ast, *this->data); }
 
-    void accept(Visitor &v) override
-    {
-        v.visit(*this);
-    }
+        iterator &operator++()
+        {
+            this->data++;
+            return *this;
+        }
+
+        bool operator!=(const iterator &rhs) const { return this->data != rhs.data; }
+        bool operator==(const iterator &rhs) const { return this->data == rhs.data; }
+
+    private:
+        const Ast *ast;
+        const NodeData *data;
+    };
+
+    NodeRange(const Ast &ast, const NodeData *first, size_t count) : ast(&ast), first(first), count(count) {}
+
+    iterator begin() const { return iterator(*this->ast, this->first); }
+    iterator end() const { return iterator(*this->ast, this->first + this->count); }
+    size_t size() const { return this->count; }
+
+private:
+    const Ast *ast;
+    const NodeData *first;
+    size_t count;
+};
+
+class PrintNode : public Node
+{
+public:
+    using Node::Node;
 
     /**
     * Get symbol name to be printed.
     */
-    const std::string &Symbol() const { return this->symbol; }
+    const std::string &Symbol() const { return this->name(0); }
 
-private:
-    const std::string symbol;
+    /**
+    * Get the interned id of the symbol to be printed.
+    */
+    uint32_t SymbolId() const { return this->data->symbols[0]; }
 };
 
 class TextNode : public Node
 {
 public:
-    virtual ~TextNode() = default;
+    using Node::Node;
 
     /**
-    * Constructs a TextNode.
+    * Get text of the node, which refers to the lexed buffer.
     */
-    TextNode(std::string text, Context ctx) : Node(ctx), text(text) {}
+    string_view Text() const { return string_view(this->data->text, this->data->count); }
+};
 
-    void accept(Visitor &v) override
-    {
-        v.visit(*this);
-    }
+class LoopNode : public Node
+{
+public:
+    using Node::Node;
+
+    /**
+    * Get the range symbol of the loop node.
+    */
+    const std::string &RangeSymbol() const { return this->name(0); }
 
     /**
-    * Get text of the node.
+    * Get the element symbol of the loop node.
     */
-    const std::string &Text() const { return this->text; }
+    const std::string &ElementSymbol() const { return this->name(1); }
 
-private:
-    const std::string text;
+    /**
+    * Get the interned id of the range symbol.
+    */
+    uint32_t RangeSymbolId() const { return this->data->symbols[0]; }
+
+    /**
+    * Get the interned id of the element symbol.
+    */
+    uint32_t ElementSymbolId() const { return this->data->symbols[1]; }
+
+    /**
+    * Get children of the loop node.
+    */
+    NodeRange Children() const;
 };
 
-class LoopNode : public Node
+class IfEqNode : public Node
 {
 public:
-    virtual ~LoopNode() = default;
+    using Node::Node;
 
     /**
-    * Constructs a LoopNode.
+    * Get the left symbol of the ifeq node.
     */
-    LoopNode(std::string rangeSymbol, std::string elementSymbol, Context ctx)
-        : Node(ctx), rangeSymbol(rangeSymbol), elementSymbol(elementSymbol), children(std::vector<std::shared_ptr<Node>>())
-    {
-    }
+    const std::string &LeftSymbol() const { return this->name(0); }
 
     /**
-    * Constructs a LoopNode.
+    * Get the right symbol of the ifeq node.
     */
-    LoopNode(std::string rangeSymbol, std::string elementSymbol, Context ctx, std::vector<std::shared_ptr<Node>> children)
-        : Node(ctx), rangeSymbol(rangeSymbol), elementSymbol(elementSymbol), children(children)
-    {
-    }
+    const std::string &RightSymbol() const { return this->name(1); }
 
-    void accept(Visitor &v) override
-    {
-        v.visit(*this);
-    }
+    /**
+    * Get the interned id of the left symbol.
+    */
+    uint32_t LeftSymbolId() const { return this->data->symbols[0]; }
 
     /**
-    * Get the range symbol of the loop node.
+    * Get the interned id of the right symbol.
     */
-    const std::string &RangeSymbol() const
-    {
-        return this->rangeSymbol;
-    }
+    uint32_t RightSymbolId() const { return this->data->symbols[1]; }
 
     /**
-    * Get the element symbol of the loop node.
+    * Get children of the ifeq node.
     */
-    const std::string &ElementSymbol() const
-    {
-        return this->elementSymbol;
-    }
+    NodeRange Children() const;
+};
+
+class BlockNode : public Node
+{
+public:
+    using Node::Node;
 
     /**
-    * Get children of the loop node.
+    * Get the registered type of the block node.
     */
-    const std::vector<std::shared_ptr<Node>> &Children() const
-    {
-        return this->children;
-    }
+    const BlockType &Type() const { return *this->data->block; }
 
-private:
-    const std::string rangeSymbol;
-    const std::string elementSymbol;
-    const std::vector<std::shared_ptr<Node>> children;
+    /**
+    * Get the keyword of the block node.
+    */
+    const std::string &Keyword() const { return this->data->block->keyword; }
+
+    /**
+    * Get the number of symbols of the block node.
+    */
+    size_t SymbolCount() const { return static_cast<size_t>(this->data->block->symbols); }
+
+    /**
+    * Get the symbol at index.
+    */
+    const std::string &Symbol(size_t index) const { return this->name(index); }
+
+    /**
+    * Get the interned id of the symbol at index.
+    */
+    uint32_t SymbolId(size_t index) const { return this->data->symbols[index]; }
+
+    /**
+    * Get children of the block node.
+    */
+    NodeRange Children() const;
 };
 
-class IfEqNode : public Node
+/**
+* Syntax tree of a template, all nodes are stored in one arena and blocks refer to their children by index.
+* Nodes are added in order, the nodes added between opening and closing a block are its children.
+*/
+class Ast
 {
 public:
-    virtual ~IfEqNode() = default;
+    /**
+    * Constructs an empty tree.
+    */
+    Ast() {}
 
     /**
-    * Constructs an IfEqNode.
+    * Appends a TextNode, which refers to `text` and does not copy it.
     */
-    IfEqNode(std::string leftSymbol, std::string rightSymbol, Context ctx)
-        : Node(ctx), leftSymbol(leftSymbol), rightSymbol(rightSymbol), children(std::vector<std::shared_ptr<Node>>())
-    {
-    }
+    void AddText(string_view text, Context ctx);
 
     /**
-    * Constructs a IfEqNode.
+    * Appends a PrintNode.
     */
-    IfEqNode(std::string leftSymbol, std::string rightSymbol, Context ctx, std::vector<std::shared_ptr<Node>> children)
-        : Node(ctx), leftSymbol(leftSymbol), rightSymbol(rightSymbol), children(children)
-    {
-    }
+    void AddPrint(string_view symbol, Context ctx);
 
-    void accept(Visitor &v) override
-    {
-        v.visit(*this);
-    }
+    /**
+    * Appends a LoopNode and opens it, nodes are added to its children until it is closed.
+    */
+    void OpenLoop(string_view rangeSymbol, string_view elementSymbol);
 
     /**
-    * Get the left symbol of the loop node.
+    * Appends an IfEqNode and opens it, nodes are added to its children until it is closed.
     */
-    const std::string &LeftSymbol() const
-    {
-        return this->leftSymbol;
-    }
+    void OpenIfEq(string_view leftSymbol, string_view rightSymbol);
 
     /**
-    * Get the right symbol of the loop node.
+    * Appends a block of a registered type and opens it, nodes are added to its children until it is closed.
+    * Symbols beyond the number the type takes are ignored.
     */
-    const std::string &RightSymbol() const
-    {
-        return this->rightSymbol;
-    }
+    void OpenBlock(const BlockType &type, string_view first = string_view(), string_view second = string_view());
 
     /**
-    * Get children of the loop node.
+    * Closes the innermost open block, `ctx` spans the whole block.
     */
-    const std::vector<std::shared_ptr<Node>> &Children() const
-    {
-        return this->children;
-    }
+    void Close(Context ctx);
+
+    /**
+    * Removes the innermost open block and the children added to it.
+    */
+    void Discard();
+
+    /**
+    * Appends `text` to the last node added, which must be a TextNode, and extends its context to the end of `ctx`.
+    * Text that follows the node's text in memory is not copied, other text is copied into the tree.
+    */
+    void AppendText(string_view text, Context ctx);
+
+    /**
+    * Adds a TextNode with a copy of `text`, which the tree owns.
+    */
+    void CopyText(string_view text, Context ctx);
+
+    /**
+    * Keeps the text owned by `other` as long as this tree, for nodes that are copied from it.
+    */
+    void Retain(const Ast &other);
+
+    /**
+    * Removes all nodes and names, the storage is kept for the next nodes.
+    */
+    void clear();
+
+    /**
+    * Get the top-level nodes, all blocks must be closed.
+    */
+    NodeRange Roots() const { return NodeRange(*this, this->pending.data(), this->pending.size()); }
+
+    NodeRange::iterator begin() const { return this->Roots().begin(); }
+    NodeRange::iterator end() const { return this->Roots().end(); }
+
+    /**
+    * Get the number of top-level nodes.
+    */
+    size_t size() const { return this->pending.size(); }
+
+    /**
+    * Get the names the symbol ids of the nodes refer to.
+    */
+    const Interner &Names() const { return this->names; }
+
+    /**
+    * Get the number of bytes used to store the nodes.
+    */
+    size_t MemoryUsage() const;
 
 private:
-    const std::string leftSymbol;
-    const std::string rightSymbol;
-    const std::vector<std::shared_ptr<Node>> children;
+    friend class Node;
+    friend class LoopNode;
+    friend class IfEqNode;
+    friend class BlockNode;
+    friend class Parser;
+    friend class carc::Reader;
+    friend class carc::Writer;
+    friend class registry::TemplateRegistry;
+
+    void clearNodes();
+    void add(NodeData::Type type, uint32_t first, uint32_t second, Context ctx, string_view text = string_view());
+    void open(NodeData::Type type, uint32_t first, uint32_t second);
+    void close(const NodeData &block);
+    // Sets the type of the innermost open block, which is registered.
+    void setBlockType(const BlockType &type);
+    // Marks the node being added and its open ancestors as variant in the loop that binds the symbol, if any.
+    void use(uint32_t id);
+    // Marks the node being added and its open ancestors as variant in all loops.
+    void useAll();
+
+    // Get the number of children added to the innermost open block.
+    size_t openChildren() const { return this->pending.size() - this->opened.back(); }
+
+    NodeRange children(const NodeData &data) const { return NodeRange(*this, this->nodes.data() + data.first, data.count); }
+
+    // Children of closed blocks, siblings are contiguous.
+    std::vector<NodeData> nodes;
+    // Top-level nodes followed by the open blocks and the children added to them so far.
+    std::vector<NodeData> pending;
+    // Index in `pending` of the first child of each open block, the block is the node before it.
+    std::vector<size_t> opened;
+    // Number of open blocks when the innermost open loop that binds each interned id was opened, 0 if none does,
+    // and the values they shadow.
+    std::vector<uint32_t> bindings;
+    std::vector<uint32_t> shadowed;
+    Interner names;
+    // Text copied into the tree, shared with the trees that retain it.
+    std::vector<std::shared_ptr<std::string>> texts;
 };
 
+inline const std::string &Node::name(size_t index) const { return this->ast->names.Name(this->data->symbols[index]); }
+
+inline NodeRange LoopNode::Children() const { return this->ast->children(*this->data); }
+
+inline NodeRange IfEqNode::Children() const { return this->ast->children(*this->data); }
+
+inline NodeRange BlockNode::Children() const { return this->ast->children(*this->data); }
+
+inline void Node::accept(Visitor &v) const
+{
+    switch (this->data->type)
+    {
+    case NodeData::Type::Text:
+        v.visit(TextNode(*this->ast, *this->data));
+        break;
+    case NodeData::Type::Print:
+        v.visit(PrintNode(*this->ast, *this->data));
+        break;
+    case NodeData::Type::Loop:
+        v.visit(LoopNode(*this->ast, *this->data));
+        break;
+    case NodeData::Type::IfEq:
+        v.visit(IfEqNode(*this->ast, *this->data));
+        break;
+    case NodeData::Type::Block:
+        v.visit(BlockNode(*this->ast, *this->data));
+        break;
+    }
+}
+
 class ParserOptions
 {
 public:
@@ -220,7 +445,16 @@ public:
     * Constructs an instance of the parser options for the `car` template language.
     */
     ParserOptions(const std::unordered_set<std::string> &symbols)
-        : symbols(symbols), symbolChecksEnabled(symbols.size() > 0)
+        : symbols(symbols), symbolChecksEnabled(symbols.size() > 0), blocks(nullptr)
+    {
+    }
+
+    /**
+    * Constructs an instance of the parser options that also accepts the block types in `blocks`,
+    * which must outlive the parser and the nodes it parses.
+    */
+    ParserOptions(const std::unordered_set<std::string> &symbols, const BlockRegistry &blocks)
+        : symbols(symbols), symbolChecksEnabled(symbols.size() > 0), blocks(&blocks)
     {
     }
 
@@ -248,9 +482,100 @@ public:
         return this->symbolChecksEnabled;
     }
 
+    /**
+    * Get the registered block types, or nullptr.
+    */
+    const BlockRegistry *Blocks()
+    {
+        return this->blocks;
+    }
+
 private:
     std::unordered_set<std::string> symbols;
     const bool symbolChecksEnabled;
+    const BlockRegistry *blocks;
+};
+
+class TokenReader
+{
+public:
+    /**
+    * Constructs a reader of all tokens in `tokens`.
+    */
+    TokenReader(const lexer::TokenStream &tokens)
+        : source(nullptr), window(nullptr), tokens(&tokens), error(nullptr), base(0) {}
+
+    /**
+    * Constructs a reader of the tokens pulled from `source` into `window`, which keeps only the last ones.
+    */
+    TokenReader(lexer::TokenSource &source, lexer::TokenStream &window, std::ostream &error)
+        : source(&source), window(&window), tokens(&window), error(&error), base(0) {}
+
+    /**
+    * Returns true if there is no token at index, pulls tokens up to index if necessary.
+    */
+    bool AtEnd(size_t index);
+
+    /**
+    * Get the type of the token at index, which must have been reached by AtEnd.
+    */
+    lexer::Token::Type GetType(size_t index) const { return this->tokens->GetType(index - this->base); }
+
+    /**
+    * Get the interned id of the Symbol or Keyword at index, or Interner::None.
+    */
+    uint32_t GetId(size_t index) const { return this->tokens->GetId(index - this->base); }
+
+    /**
+    * Get the token at index.
+    */
+    lexer::Token operator[](size_t index) const { return (*this->tokens)[index - this->base]; }
+
+    /**
+    * Get the names interned by the tokens.
+    */
+    const Interner &Names() const { return this->tokens->Names(); }
+
+private:
+    static const size_t windowSize = 4096;
+    static const size_t lookBehind = 8;
+
+    lexer::TokenSource *source;
+    lexer::TokenStream *window;
+    const lexer::TokenStream *tokens;
+    std::ostream *error;
+    size_t base;
+};
+
+/**
+* State of a parse, which is passed down the recursion. Nodes are emitted in place into the output
+* and the stacks keep their capacity, so parsing similar templates again does not allocate.
+*/
+struct ParseContext
+{
+    Ast *output = nullptr;
+    // Symbols of the directive being parsed.
+    std::vector<uint32_t> symbols;
+    // Symbols declared by the enclosing loops, innermost last.
+    std::vector<uint32_t> declared;
+    // Indexed by symbol id, true if the symbol is defined in the options or declared by an enclosing loop.
+    std::vector<bool> defined;
+
+    // A block whose children are being parsed.
+    struct Frame
+    {
+        uint32_t keyword;
+        int start;
+        // Size of `declared` before the block declared its symbols.
+        size_t declared;
+        // StartDirective of the block, errors are reported at the one of the outermost block.
+        lexer::Token directive;
+    };
+
+    // Open blocks, innermost last.
+    std::vector<Frame> frames;
+    // Token the last error is reported at.
+    lexer::Token failure = lexer::Token(lexer::Token::Type::StartDirective, Context(0, 0));
 };
 
 class Parser
@@ -258,60 +583,102 @@ class Parser
 public:
     /**
     * Constructs an instance of the parser for the `car` template language.
+    * A parser reuses its state, parsing into the same Ast with the same parser does not allocate once
+    * the storage has grown to the size of the templates.
     */
     Parser(ParserOptions options) : options(options) {}
 
     /**
-    * Parses `car` template language tokens into parser nodes.
+    * Parses `car` template language tokens into a syntax tree, which replaces the contents of `output`.
+    * Nodes refer to the values of the tokens, which must outlive them.
     */
     bool parse(const std::vector<lexer::Token> &tokens,
-               std::vector<std::unique_ptr<Node>> &output,
+               Ast &output,
+               std::ostream &error);
+
+    /**
+    * Parses `car` template language tokens into a syntax tree, which replaces the contents of `output`.
+    * Nodes refer to the buffer the tokens were lexed from, which must outlive them.
+    */
+    bool parse(const lexer::TokenStream &tokens,
+               Ast &output,
+               std::ostream &error);
+
+    /**
+    * Parses `car` template language tokens into a syntax tree as they are pulled from `source`.
+    * Only the last tokens pulled are kept, nodes refer to the buffer they were lexed from.
+    */
+    bool parse(lexer::TokenSource &source,
+               Ast &output,
                std::ostream &error);
 
 private:
-    typedef std::vector<std::unique_ptr<Node>> (Parser::*nodeParser)(std::vector<lexer::Token>::const_iterator &begin,
-                                                                     const std::vector<lexer::Token>::const_iterator end,
-                                                                     std::ostream &error);
-
-    std::vector<std::string>
-    parseSymbols(std::vector<lexer::Token>::const_iterator &begin,
-                 const std::vector<lexer::Token>::const_iterator end,
-                 int count,
-                 bool checkAllSymbols,
-                 std::vector<std::string> &declared,
-                 std::ostream &error);
-
-    std::vector<std::unique_ptr<Node>> parseNodes(std::vector<lexer::Token>::const_iterator &begin,
-                                                  const std::vector<lexer::Token>::const_iterator end,
-                                                  std::ostream &error);
-
-    std::vector<std::unique_ptr<Node>>
-    parseBlock(std::vector<lexer::Token>::const_iterator &begin,
-               const std::vector<lexer::Token>::const_iterator end,
+    bool parse(TokenReader &tokens,
+               Ast &output,
                std::ostream &error);
 
-    template <typename NodeType, bool checkAllSymbols>
-    std::vector<std::unique_ptr<Node>>
-    parseBlockWithTwoSymbols(std::vector<lexer::Token>::const_iterator &begin,
-                                     const std::vector<lexer::Token>::const_iterator end,
-                                     std::ostream &error,
-                                     const std::string &keyword);
-
-    std::vector<std::unique_ptr<Node>> parseLoop(std::vector<lexer::Token>::const_iterator &begin,
-                                                 const std::vector<lexer::Token>::const_iterator end,
-                                                 std::ostream &error);
-
-    std::vector<std::unique_ptr<Node>>
-    parseIfEq(std::vector<lexer::Token>::const_iterator &begin,
-              const std::vector<lexer::Token>::const_iterator end,
-              std::ostream &error);
-
-    std::unordered_map<std::string, nodeParser> keywordParser = {
-        {"loop", &Parser::parseLoop},
-        {"ifeq", &Parser::parseIfEq},
-    };
+    bool atEnd(TokenReader &tokens, size_t index, ParseContext &context);
+
+    bool parseExact(TokenReader &tokens, size_t &begin, ParseContext &context, std::ostream &error,
+                    const lexer::Token::Type type, const uint32_t id = Interner::None);
+
+    typedef bool (Parser::*nodeParser)(TokenReader &tokens,
+                                       size_t &begin,
+                                       ParseContext &context,
+                                       std::ostream &error);
+
+    bool parseSymbols(TokenReader &tokens,
+                      size_t &begin,
+                      int count,
+                      bool checkAllSymbols,
+                      ParseContext &context,
+                      std::ostream &error);
+
+    bool parseNodes(TokenReader &tokens,
+                    size_t &begin,
+                    ParseContext &context,
+                    std::ostream &error);
+
+    bool parseBlock(TokenReader &tokens,
+                    size_t &begin,
+                    ParseContext &context,
+                    std::ostream &error);
+
+    bool closeBlock(TokenReader &tokens,
+                    size_t &begin,
+                    ParseContext &context,
+                    std::ostream &error);
+
+    bool parseBlockWithSymbols(TokenReader &tokens,
+                               size_t &begin,
+                               ParseContext &context,
+                               std::ostream &error,
+                               const uint32_t keyword,
+                               const NodeData::Type type,
+                               const int count,
+                               const bool checkAllSymbols);
+
+    bool parseRegisteredBlock(TokenReader &tokens,
+                              size_t &begin,
+                              ParseContext &context,
+                              std::ostream &error,
+                              const uint32_t keyword,
+                              const BlockType &type);
+
+    bool parseLoop(TokenReader &tokens,
+                   size_t &begin,
+                   ParseContext &context,
+                   std::ostream &error);
+
+    bool parseIfEq(TokenReader &tokens,
+                   size_t &begin,
+                   ParseContext &context,
+                   std::ostream &error);
+
+    static nodeParser keywordParser(uint32_t keyword);
 
     ParserOptions options;
+    ParseContext context;
 };
 
 } // namespace parser
@@ -0,0 +1,296 @@
+#ifndef _CARENDER_PASSES_HPP_INCLUDED
+#define _CARENDER_PASSES_HPP_INCLUDED
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "parser.hpp"
+
+namespace car
+{
+namespace passes
+{
+
+/**
+* What is known about the symbols a tree will be rendered with. Passes only rewrite nodes whose output and
+* errors do not change under these assumptions.
+*/
+struct Assumptions
+{
+    // Symbols and range symbols that are defined when the tree is rendered.
+    std::unordered_set<std::string> symbols;
+    std::unordered_set<std::string> rangeSymbols;
+    // True if no other symbols are defined.
+    bool isExhaustive = false;
+};
+
+/**
+* A rewrite of a syntax tree that keeps the output and errors of rendering it.
+*/
+class Pass
+{
+public:
+    virtual ~Pass() = default;
+
+    /**
+    * Get the name the pass is switched by, e.g. `merge-text`.
+    */
+    virtual const char *Name() const = 0;
+
+    /**
+    * Writes the rewritten `input` to `output`, which is empty, and returns the number of nodes changed.
+    * Nodes of `output` refer to the text of `input`, which it retains.
+    */
+    virtual size_t Run(const parser::Ast &input, parser::Ast &output) = 0;
+};
+
+/**
+* A pass that copies a tree node by node and rewrites some of them. Blocks are rewritten on a stack, so trees
+* nest arbitrarily deep.
+*/
+class Rewriter : public Pass
+{
+public:
+    Rewriter(const Assumptions &assumptions) : assumptions(assumptions) {}
+
+    size_t Run(const parser::Ast &input, parser::Ast &output) override;
+
+protected:
+    enum class Action
+    {
+        Keep,
+        // Removes the node and its children.
+        Remove,
+        // Replaces a block with its children.
+        Inline,
+        // Replaces a LoopNode with its children once per value of `range`, with the element bound to the value.
+        Unroll,
+        // Replaces a PrintNode with a TextNode of `value`.
+        Evaluate,
+    };
+
+    /**
+    * A loop element while the children of its loop are rewritten.
+    */
+    struct Element
+    {
+        uint32_t id;
+        // Value the element is bound to in an unrolled loop, nullptr in a kept loop.
+        const std::string *value;
+    };
+
+    /**
+    * Decides what happens to a node, which is kept by default.
+    */
+    virtual Action rewrite(const parser::NodeData &node);
+
+    /**
+    * Get the values a LoopNode is unrolled with, which are not empty.
+    */
+    virtual const std::vector<std::string> &range(const parser::NodeData &loop);
+
+    /**
+    * Get the text an evaluated PrintNode is replaced with.
+    */
+    virtual const std::string &value(const parser::NodeData &print);
+
+    /**
+    * Decides whether a kept block that has no children once they are rewritten is kept.
+    */
+    virtual bool keepEmpty(const parser::NodeData &block);
+
+    /**
+    * Decides whether a TextNode is merged into a TextNode right before it.
+    */
+    virtual bool merge() { return false; }
+
+    // True if the symbol with the interned id of the input is defined whenever the node being rewritten is rendered.
+    bool isDefined(uint32_t id) const;
+    // True if the symbol is not defined whenever the node being rewritten is rendered.
+    bool isUndefined(uint32_t id) const;
+    bool isRangeDefined(uint32_t id) const;
+    // Get the innermost loop element with the interned id, nullptr if the node being rewritten is in none.
+    const Element *element(uint32_t id) const;
+
+    const Assumptions assumptions;
+    const parser::Ast *input = nullptr;
+
+private:
+    /**
+    * A block of the input whose children are being rewritten. Children of an inlined block are added to the
+    * output of the enclosing one.
+    */
+    struct Frame
+    {
+        parser::NodeRange::iterator first;
+        parser::NodeRange::iterator next;
+        parser::NodeRange::iterator end;
+        const parser::NodeData *block;
+        bool isInlined;
+        // Values of an unrolled loop and the index of the current one, nullptr for other blocks.
+        const std::vector<std::string> *range;
+        size_t value;
+    };
+
+    /**
+    * A list of siblings being added to the output.
+    */
+    struct Siblings
+    {
+        size_t count;
+        bool isLastText;
+    };
+
+    std::vector<Frame> frames;
+    std::vector<Siblings> siblings;
+    // Elements of the enclosing loops, they are defined in their children.
+    std::vector<Element> elements;
+};
+
+/**
+* Replaces `{{#ifeq x x}}` with its children when `x` is defined.
+*/
+class FoldIfEq : public Rewriter
+{
+public:
+    using Rewriter::Rewriter;
+
+    const char *Name() const override { return "fold-ifeq"; }
+
+protected:
+    Action rewrite(const parser::NodeData &node) override;
+};
+
+/**
+* Removes empty TextNodes and blocks that have no children when rendering them cannot fail.
+*/
+class RemoveEmpty : public Rewriter
+{
+public:
+    using Rewriter::Rewriter;
+
+    const char *Name() const override { return "remove-empty"; }
+
+protected:
+    Action rewrite(const parser::NodeData &node) override;
+    bool keepEmpty(const parser::NodeData &block) override;
+};
+
+/**
+* Merges adjacent TextNodes of the same block into one.
+*/
+class MergeText : public Rewriter
+{
+public:
+    using Rewriter::Rewriter;
+
+    const char *Name() const override { return "merge-text"; }
+
+protected:
+    bool merge() override { return true; }
+};
+
+/**
+* Evaluates the nodes that only depend on static symbols, e.g. symbols fixed when a template is deployed, and
+* leaves a residual tree of the nodes that depend on the others. Prints of static symbols become text, ifeqs of
+* static symbols are folded and loops over static ranges are unrolled.
+*
+* The residual tree renders the output and errors of the input when it is rendered with the static symbols and
+* the others, whose names must differ. The assumptions are about the other symbols, a loop over a static range
+* is only unrolled if its element is known to be undefined and its children do not use it in nodes that are kept.
+*/
+class Specializer : public Rewriter
+{
+public:
+    Specializer(
+        const std::unordered_map<std::string, std::string> &symbols,
+        const std::unordered_map<std::string, std::vector<std::string>> &rangeSymbols,
+        const Assumptions &assumptions = Assumptions())
+        : Rewriter(assumptions), symbols(symbols), rangeSymbols(rangeSymbols) {}
+
+    const char *Name() const override { return "specialize"; }
+
+protected:
+    Action rewrite(const parser::NodeData &node) override;
+    const std::vector<std::string> &range(const parser::NodeData &loop) override;
+    const std::string &value(const parser::NodeData &print) override;
+
+private:
+    // Get the value of a symbol that is known while rewriting, nullptr if it is only known when rendering.
+    const std::string *lookup(uint32_t id) const;
+    // True if the children of a loop only use its element in nodes that are evaluated once it is unrolled.
+    bool isUnrollable(const parser::NodeData &loop) const;
+
+    const std::unordered_map<std::string, std::string> symbols;
+    const std::unordered_map<std::string, std::vector<std::string>> rangeSymbols;
+    // Children left to check by isUnrollable.
+    mutable std::vector<parser::NodeRange> pending;
+};
+
+/**
+* Number of nodes a pass changed in the last run of a PassManager.
+*/
+struct PassReport
+{
+    std::string name;
+    size_t changes;
+};
+
+std::ostream &operator<<(std::ostream &os, const PassReport &report);
+
+/**
+* Runs passes over syntax trees in the order they were added, each pass can be switched off.
+*/
+class PassManager
+{
+public:
+    /**
+    * Appends a pass, which is enabled.
+    */
+    void Add(std::unique_ptr<Pass> pass);
+
+    /**
+    * Switches the pass named `name` on or off, returns false if there is none.
+    */
+    bool Enable(const std::string &name, bool isEnabled);
+
+    /**
+    * Rewrites `nodes` with the enabled passes and returns the number of nodes changed.
+    * The nodes keep referring to the text `nodes` referred to.
+    */
+    size_t Run(parser::Ast &nodes);
+
+    /**
+    * Get the changes of the enabled passes in the last run.
+    */
+    const std::vector<PassReport> &Reports() const { return this->reports; }
+
+private:
+    struct Entry
+    {
+        std::unique_ptr<Pass> pass;
+        bool isEnabled;
+    };
+
+    std::vector<Entry> passes;
+    std::vector<PassReport> reports;
+    // Tree the passes write to, it is swapped with the nodes after each pass.
+    parser::Ast scratch;
+};
+
+/**
+* Adds the standard passes to `manager`: fold-ifeq, remove-empty and merge-text, which merges the text the
+* others bring together.
+*/
+void AddStandardPasses(PassManager &manager, const Assumptions &assumptions = Assumptions());
+
+} // namespace passes
+} // namespace car
+
+#endif // _CARENDER_PASSES_HPP_INCLUDED
@@ -22,6 +22,7 @@ public:
     void visit(const PrintNode &n) override;
     void visit(const LoopNode &n) override;
     void visit(const IfEqNode &n) override;
+    void visit(const BlockNode &n) override;
 
     virtual ~PrintingVisitor() = default;
 
@@ -0,0 +1,131 @@
+#ifndef _CARENDER_REGISTRY_HPP_INCLUDED
+#define _CARENDER_REGISTRY_HPP_INCLUDED
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "parser.hpp"
+
+namespace car
+{
+namespace registry
+{
+
+/**
+* Nodes and text of the templates in a registry, as they were added and as they are stored.
+*/
+struct Sharing
+{
+    size_t templates;
+    size_t nodes;
+    size_t storedNodes;
+    size_t textBytes;
+    size_t storedTextBytes;
+    // Bytes of the tables that find identical lists and text, approximately.
+    size_t indexBytes;
+
+    /**
+    * Get the bytes the stored nodes and text save, net of the tables.
+    */
+    int64_t Saved() const;
+};
+
+std::ostream &operator<<(std::ostream &os, const Sharing &sharing);
+
+/**
+* Templates copied into one tree, whose nodes and names they share. A registry that shares subtrees stores
+* identical lists of siblings and identical text once, e.g. the headers, footers and legal text of many templates.
+*
+* Shared nodes render the same in every template that uses them. They have the context of the first template
+* added with them, except for loops and registered blocks, whose context renderers and hooks read, which are
+* only shared at the same position.
+*/
+class TemplateRegistry
+{
+public:
+    /**
+    * Constructs an empty registry, which shares identical subtrees if `isSharing`.
+    */
+    TemplateRegistry(bool isSharing = true) : isSharing(isSharing), sharing{0, 0, 0, 0, 0, 0} {}
+
+    TemplateRegistry(const TemplateRegistry &) = delete;
+    TemplateRegistry &operator=(const TemplateRegistry &) = delete;
+
+    /**
+    * Adds a copy of `nodes`, whose blocks must be closed, named `name`. A template added with the name before
+    * is replaced, its nodes are kept. Registered blocks must outlive the registry.
+    */
+    void Add(const std::string &name, const parser::Ast &nodes);
+
+    /**
+    * Get the top-level nodes of the template named `name`, none if there is no such template. The nodes are valid
+    * until the next template is added.
+    */
+    parser::NodeRange Find(const std::string &name) const;
+
+    /**
+    * Get the tree the templates are stored in, whose names their nodes refer to, e.g. to resolve Slots.
+    */
+    const parser::Ast &Nodes() const { return this->tree; }
+
+    /**
+    * Get the nodes and text the templates added so far use and how much the registry shares of them.
+    */
+    Sharing Report() const;
+
+private:
+    /**
+    * Siblings in the arena of the tree.
+    */
+    struct List
+    {
+        uint32_t first;
+        uint32_t count;
+    };
+
+    /**
+    * A list of siblings of the template being added, whose nodes are being copied.
+    */
+    struct Frame
+    {
+        const parser::NodeData *list;
+        size_t count;
+        size_t next;
+        // Index of the first copied node in `copies`.
+        size_t copies;
+    };
+
+    struct TextHash
+    {
+        size_t operator()(string_view text) const;
+    };
+
+    parser::NodeData copy(const parser::NodeData &node, const List &children);
+    const char *text(string_view text);
+    List add(size_t begin);
+
+    static uint64_t hash(const parser::NodeData &node, uint64_t seed);
+    static bool isSame(const parser::NodeData &lhs, const parser::NodeData &rhs);
+
+    const bool isSharing;
+    Sharing sharing;
+    parser::Ast tree;
+    std::unordered_map<std::string, List> templates;
+    // Lists by the hash of their nodes, and text, stored once if the registry shares them.
+    std::unordered_multimap<uint64_t, List> lists;
+    std::unordered_set<string_view, TextHash> texts;
+    // Ids of the names of the template being added in the tree, and its copied nodes.
+    std::vector<uint32_t> ids;
+    std::vector<Frame> frames;
+    std::vector<parser::NodeData> copies;
+};
+
+} // namespace registry
+} // namespace car
+
+#endif // _CARENDER_REGISTRY_HPP_INCLUDED
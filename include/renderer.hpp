@@ -4,9 +4,12 @@
 #include <ostream>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 #include "parser.hpp"
 
+using car::parser::BlockNode;
+using car::parser::BlockScope;
 using car::parser::IfEqNode;
 using car::parser::LoopNode;
 using car::parser::PrintNode;
@@ -18,7 +21,43 @@ namespace car
 namespace renderer
 {
 
-class Renderer : public Visitor
+/**
+* Values of the symbols of a tree in flat arrays indexed by the interned ids of their names, so that each global
+* symbol and each loop element has a slot. Names are hashed once, when the slots are resolved, and a Renderer
+* constructed with the slots reads them without hashing. Slots point to the values they are bound to, which must
+* outlive them.
+*/
+class Slots
+{
+public:
+    /**
+    * Resolves the names of `nodes` to the values of `symbols` and `rangeSymbols`.
+    */
+    Slots(const parser::Ast &nodes,
+          const std::unordered_map<std::string, std::string> &symbols,
+          const std::unordered_map<std::string, std::vector<std::string>> &rangeSymbols);
+
+    /**
+    * Binds the symbol with the interned id to `value`, nullptr if it is not defined. Values are rebound by id
+    * without hashing their names, e.g. when each request renders the tree with other values.
+    */
+    void Bind(uint32_t id, const std::string *value) { this->symbols[id] = value; }
+    void BindRange(uint32_t id, const std::vector<std::string> *range) { this->rangeSymbols[id] = range; }
+
+    /**
+    * Get the value bound to the symbol with the interned id, nullptr if it is not defined.
+    */
+    const std::string *Symbol(uint32_t id) const { return this->symbols[id]; }
+    const std::vector<std::string> *RangeSymbol(uint32_t id) const { return this->rangeSymbols[id]; }
+
+private:
+    friend class Renderer;
+
+    std::vector<const std::string *> symbols;
+    std::vector<const std::vector<std::string> *> rangeSymbols;
+};
+
+class Renderer : public Visitor, private BlockScope
 {
 public:
     /**
@@ -29,12 +68,19 @@ public:
         const std::unordered_map<std::string, std::vector<std::string>> &rangeSymbols,
         std::ostream &output,
         std::ostream &error)
-        : symbols(symbols), rangeSymbols(rangeSymbols), output(output), error(error), hasError(false) {}
+        : symbols(symbols), rangeSymbols(rangeSymbols), output(output), error(error), capture(nullptr), blockValues{nullptr, nullptr}, blockRenders(0), base(0), hasError(false), isRunning(false) {}
+
+    /**
+    * Constructs a renderer that reads the symbols of resolved slots, it renders the nodes of the tree they
+    * were resolved for.
+    */
+    Renderer(const Slots &slots, std::ostream &output, std::ostream &error);
 
     void visit(const TextNode &n) override;
     void visit(const PrintNode &n) override;
     void visit(const LoopNode &n) override;
     void visit(const IfEqNode &n) override;
+    void visit(const BlockNode &n) override;
 
     /**
     * Returns true if the renderer has encountered an error and wrote it to the error stream.
@@ -47,11 +93,79 @@ public:
     virtual ~Renderer() = default;
 
 private:
-    std::unordered_map<std::string, std::string> symbols;
+    const std::string &Value(size_t index) const override { return *this->blockValues[index]; }
+    std::ostream &Output() override { return this->output; }
+    std::ostream &Error() override { return this->error; }
+    void RenderChildren() override { this->blockRenders++; }
+
+    /**
+    * A value looked up by the interned id of its symbol, names are hashed once per symbol unless the renderer
+    * is constructed with resolved slots.
+    */
+    template <typename T>
+    struct Slot
+    {
+        const T *value = nullptr;
+        bool isResolved = false;
+    };
+
+    /**
+    * A block whose children are being rendered. Blocks are rendered on this stack instead of recursively,
+    * so nesting is unlimited.
+    */
+    struct Frame
+    {
+        parser::NodeRange::iterator first;
+        parser::NodeRange::iterator next;
+        parser::NodeRange::iterator end;
+        // Values of the loop and the index of the current one, nullptr for other blocks.
+        const std::vector<std::string> *range;
+        size_t value;
+        uint32_t elementId;
+        // Index in `slices` of the first slice of the loop and of the next one in the current iteration.
+        size_t slices;
+        size_t slice;
+    };
+
+    /**
+    * Output of a run of invariant children of a loop, rendered in its first iteration and copied in the others.
+    */
+    struct Slice
+    {
+        parser::NodeRange::iterator first;
+        parser::NodeRange::iterator end;
+        std::string text;
+    };
+
+    void push(const parser::NodeRange &children, const std::vector<std::string> *range, uint32_t elementId);
+    void run();
+    bool hoist();
+    void write(string_view text);
+    std::ostream &fail();
+
+    template <typename T>
+    const T *lookup(std::vector<Slot<T>> &slots,
+                    const std::unordered_map<std::string, T> &values,
+                    const std::string &name,
+                    uint32_t id);
+
+    const std::unordered_map<std::string, std::string> symbols;
     const std::unordered_map<std::string, std::vector<std::string>> rangeSymbols;
+    std::vector<Slot<std::string>> symbolSlots;
+    std::vector<Slot<std::vector<std::string>>> rangeSymbolSlots;
     std::ostream &output;
     std::ostream &error;
+    // Text of the slice being captured, nullptr when nodes are rendered to the output.
+    std::string *capture;
+    std::vector<Frame> frames;
+    std::vector<Slice> slices;
+    // Symbol values of the registered block being rendered and the number of times its children are rendered.
+    const std::string *blockValues[2];
+    size_t blockRenders;
+    // Number of frames rendered by an enclosing run, while a slice is captured.
+    size_t base;
     bool hasError;
+    bool isRunning;
 };
 
 } // namespace renderer
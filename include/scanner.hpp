@@ -0,0 +1,49 @@
+#ifndef _CARENDER_SCANNER_HPP_INCLUDED
+#define _CARENDER_SCANNER_HPP_INCLUDED
+
+namespace car
+{
+namespace scanner
+{
+
+/**
+* Instruction sets a scanner can be implemented with.
+*/
+enum class Isa
+{
+    Scalar,
+    SSE2,
+    AVX2,
+};
+
+/**
+* Get the best instruction set supported by the running CPU.
+*/
+Isa BestIsa();
+
+/**
+* Returns true if the running CPU supports the instruction set.
+*/
+bool IsSupported(Isa isa);
+
+/**
+* Returns a pointer to the first `c` in [begin, end), or `end` if there is none.
+* Uses the best instruction set supported by the running CPU.
+*/
+const char *Find(const char *begin, const char *end, char c);
+
+/**
+* Returns a pointer to the first `c` in [begin, end), or `end` if there is none.
+* Uses the given instruction set, which must be supported by the running CPU.
+*/
+const char *Find(const char *begin, const char *end, char c, Isa isa);
+
+/**
+* Returns a pointer to the first `first` followed by `second` in [begin, end), or `end` if there is none.
+*/
+const char *FindPair(const char *begin, const char *end, char first, char second);
+
+} // namespace scanner
+} // namespace car
+
+#endif // _CARENDER_SCANNER_HPP_INCLUDED
@@ -0,0 +1,161 @@
+#ifndef _CARENDER_SIZING_HPP_INCLUDED
+#define _CARENDER_SIZING_HPP_INCLUDED
+
+#include <cstddef>
+#include <cstdint>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+#include "parser.hpp"
+#include "renderer.hpp"
+
+namespace car
+{
+namespace sizing
+{
+
+/**
+* How an evaluated size relates to the size of the output.
+*/
+enum class Accuracy
+{
+    // The output has exactly the size.
+    Exact,
+    // The output is at most the size, e.g. an ifeq on a loop element is counted as if it was always true,
+    // or rendering stops at an error.
+    UpperBound,
+    // A registered block with a render hook decides its output, its children are counted once.
+    Estimate,
+};
+
+/**
+* The evaluated size of the output of a template.
+*/
+struct Size
+{
+    size_t bytes;
+    Accuracy accuracy;
+};
+
+/**
+* The size of the output of a tree as a formula of the lengths of its symbols: constant text bytes, plus the
+* length of each printed symbol, plus, for each loop, the number of values of its range times the size of its
+* children and the sum of the lengths of the values times the prints of its element. The formula is analyzed
+* once per tree and evaluated before each render, so the output can be allocated once.
+*
+* Blocks are analyzed and evaluated on stacks, so trees nest arbitrarily deep. The formula refers to the ids of
+* the names of the tree, it is evaluated with Slots resolved for the tree.
+*/
+class SizeFormula : private parser::Visitor
+{
+public:
+    /**
+    * Analyzes `nodes`, whose blocks must be closed.
+    */
+    explicit SizeFormula(const parser::Ast &nodes);
+
+    /**
+    * Get the size of the output of rendering the tree with `slots`.
+    */
+    Size Evaluate(const renderer::Slots &slots) const;
+
+private:
+    /**
+    * A list of siblings, the top-level nodes or the children of a block. Terms are stored after the terms of
+    * the blocks among their children.
+    */
+    struct Term
+    {
+        // Type of the block, the top-level nodes are the children of a block without symbols that is rendered once.
+        parser::NodeData::Type type;
+        // True if the term is an ifeq on a loop element, a registered block with a render hook or a loop whose
+        // element is bound by an enclosing loop, which fails to render.
+        bool isVariable;
+        uint32_t symbols[2];
+        // Number of loops the children are nested in, their sizes are linear in the lengths of their elements.
+        uint32_t loops;
+        // Number of terms of the blocks among the children, which precede the term.
+        uint32_t terms;
+        // Prints of the children are `prints[first, first + count)`.
+        uint32_t first;
+        uint32_t count;
+        size_t text;
+    };
+
+    /**
+    * Prints of a symbol among the children of a block, the symbol is the element of the loop at `loop` or a
+    * global symbol if it is Interner::None.
+    */
+    struct Print
+    {
+        uint32_t id;
+        uint32_t loop;
+        size_t count;
+    };
+
+    /**
+    * A block whose children are being analyzed.
+    */
+    struct Frame
+    {
+        const parser::NodeData *block;
+        parser::NodeRange::iterator next;
+        parser::NodeRange::iterator end;
+        size_t text;
+        uint32_t terms;
+        // Index in `pending` of the first print of the children.
+        size_t prints;
+        // Loop of the element bound by the block before it, if it is a loop.
+        uint32_t shadowed;
+    };
+
+    void visit(const parser::TextNode &n) override;
+    void visit(const parser::PrintNode &n) override;
+    void visit(const parser::LoopNode &n) override;
+    void visit(const parser::IfEqNode &n) override;
+    void visit(const parser::BlockNode &n) override;
+
+    void open(const parser::NodeData &block, const parser::NodeRange &children);
+    void close();
+    bool isElement(uint32_t id) const;
+
+    std::vector<Term> terms;
+    std::vector<Print> prints;
+
+    // State of the analysis: the open blocks, the prints of their children and the innermost loop that binds each
+    // id as its element, Interner::None if no loop does.
+    std::vector<Frame> frames;
+    std::vector<Print> pending;
+    std::vector<uint32_t> bindings;
+    uint32_t loops;
+};
+
+/**
+* A stream buffer that appends to a string, e.g. one reserved for the evaluated size of a template, so that
+* rendering to a stream does not grow it.
+*/
+class StringBuffer : public std::streambuf
+{
+public:
+    explicit StringBuffer(std::string &output) : output(output) {}
+
+protected:
+    std::streamsize xsputn(const char *s, std::streamsize count) override;
+    int_type overflow(int_type c) override;
+
+private:
+    std::string &output;
+};
+
+/**
+* Renders `nodes` to `output`, which is reserved once for the size `formula` evaluates to. Returns false if the
+* renderer wrote an error.
+*/
+bool Render(const parser::Ast &nodes, const SizeFormula &formula, const renderer::Slots &slots, std::string &output,
+            std::ostream &error);
+
+} // namespace sizing
+} // namespace car
+
+#endif // _CARENDER_SIZING_HPP_INCLUDED
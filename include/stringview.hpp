@@ -0,0 +1,82 @@
+#ifndef _CARENDER_STRINGVIEW_HPP_INCLUDED
+#define _CARENDER_STRINGVIEW_HPP_INCLUDED
+
+#include <cstring>
+#include <ostream>
+#include <string>
+
+#if __cplusplus >= 201703L
+#include <string_view>
+#endif
+
+namespace car
+{
+
+#if __cplusplus >= 201703L
+
+using string_view = std::string_view;
+
+#else
+
+/**
+* A non-owning reference to a range of characters, the subset of std::string_view used by carender.
+*/
+class string_view
+{
+public:
+    constexpr string_view() : ptr(nullptr), count(0) {}
+    constexpr string_view(const char *data, size_t size) : ptr(data), count(size) {}
+    string_view(const char *str) : ptr(str), count(std::strlen(str)) {}
+    string_view(const std::string &str) : ptr(str.data()), count(str.size()) {}
+
+    explicit operator std::string() const { return std::string(this->ptr, this->count); }
+
+    constexpr const char *data() const { return this->ptr; }
+    constexpr size_t size() const { return this->count; }
+    constexpr size_t length() const { return this->count; }
+    constexpr bool empty() const { return this->count == 0; }
+    constexpr const char *begin() const { return this->ptr; }
+    constexpr const char *end() const { return this->ptr + this->count; }
+    constexpr char operator[](size_t pos) const { return this->ptr[pos]; }
+
+    int compare(string_view other) const
+    {
+        auto common = this->count < other.count ? this->count : other.count;
+        auto result = common == 0 ? 0 : std::memcmp(this->ptr, other.ptr, common);
+        if (result != 0)
+        {
+            return result;
+        }
+        return this->count == other.count ? 0 : (this->count < other.count ? -1 : 1);
+    }
+
+private:
+    const char *ptr;
+    size_t count;
+};
+
+inline bool operator==(string_view lhs, string_view rhs)
+{
+    return lhs.size() == rhs.size() && lhs.compare(rhs) == 0;
+}
+
+inline bool operator!=(string_view lhs, string_view rhs)
+{
+    return !(lhs == rhs);
+}
+
+inline bool operator<(string_view lhs, string_view rhs)
+{
+    return lhs.compare(rhs) < 0;
+}
+
+inline std::ostream &operator<<(std::ostream &os, string_view view)
+{
+    return os.write(view.data(), view.size());
+}
+
+#endif // __cplusplus >= 201703L
+
+} // namespace car
+
+#endif // _CARENDER_STRINGVIEW_HPP_INCLUDED
@@ -0,0 +1,69 @@
+// Generated by carender --emit-cpp, do not edit.
+#include "codegen.hpp"
+
+CARENDER_TEMPLATE(render_examples_bottles_template)
+{
+    static const char *const names[] = {"hello", "h", "name", "bottles", "count"};
+    const std::string *values[5] = {};
+    const std::vector<std::string> *ranges[5] = {};
+    car::codegen::Resolve(symbols, rangeSymbols, names, 5, values, ranges);
+    (void)values;
+    (void)ranges;
+
+    if (ranges[0] == nullptr)
+    {
+        return car::codegen::RangeSymbolNotFound(error, names[0]);
+    }
+    if (values[1] != nullptr)
+    {
+        return car::codegen::Redefined(error, names[1], "[8, 43)");
+    }
+    for (const auto &element1 : *ranges[0])
+    {
+        values[1] = &element1;
+        if (values[1] == nullptr)
+        {
+            return car::codegen::SymbolNotFound(error, names[1]);
+        }
+        output += *values[1];
+        output.append(" ", 1);
+        if (values[2] == nullptr)
+        {
+            return car::codegen::SymbolNotFound(error, names[2]);
+        }
+        output += *values[2];
+        output.append("!\n", 2);
+    }
+    values[1] = nullptr;
+    if (ranges[3] == nullptr)
+    {
+        return car::codegen::RangeSymbolNotFound(error, names[3]);
+    }
+    if (values[4] != nullptr)
+    {
+        return car::codegen::Redefined(error, names[4], "[52, 140)");
+    }
+    for (const auto &element1 : *ranges[3])
+    {
+        values[4] = &element1;
+        output.append("  ", 2);
+        if (values[4] == nullptr)
+        {
+            return car::codegen::SymbolNotFound(error, names[4]);
+        }
+        output += *values[4];
+        output.append(" bottles on the wall, take one out, pass it around,\n", 52);
+    }
+    values[4] = nullptr;
+    output.append("\nBye ", 5);
+    if (values[2] == nullptr)
+    {
+        return car::codegen::SymbolNotFound(error, names[2]);
+    }
+    output += *values[2];
+    output.append(".\n", 2);
+
+    (void)error;
+    (void)output;
+    return true;
+}
@@ -0,0 +1,57 @@
+// Generated by carender --emit-cpp, do not edit.
+#include "codegen.hpp"
+
+CARENDER_TEMPLATE(render_examples_fruits_template)
+{
+    static const char *const names[] = {"name", "items", "item", "favorite"};
+    const std::string *values[4] = {};
+    const std::vector<std::string> *ranges[4] = {};
+    car::codegen::Resolve(symbols, rangeSymbols, names, 4, values, ranges);
+    (void)values;
+    (void)ranges;
+
+    output.append("Hello ", 6);
+    if (values[0] == nullptr)
+    {
+        return car::codegen::SymbolNotFound(error, names[0]);
+    }
+    output += *values[0];
+    output.append(",\n\n", 3);
+    if (ranges[1] == nullptr)
+    {
+        return car::codegen::RangeSymbolNotFound(error, names[1]);
+    }
+    if (values[2] != nullptr)
+    {
+        return car::codegen::Redefined(error, names[2], "[25, 106)");
+    }
+    for (const auto &element1 : *ranges[1])
+    {
+        values[2] = &element1;
+        output.append("I like ", 7);
+        if (values[2] == nullptr)
+        {
+            return car::codegen::SymbolNotFound(error, names[2]);
+        }
+        output += *values[2];
+        if (values[2] == nullptr)
+        {
+            return car::codegen::SymbolNotFound(error, names[2]);
+        }
+        if (values[3] == nullptr)
+        {
+            return car::codegen::SymbolNotFound(error, names[3]);
+        }
+        if (*values[2] == *values[3])
+        {
+            output.append(" very much", 10);
+        }
+        output.append(".\n", 2);
+    }
+    values[2] = nullptr;
+    output.append("\nCheers!", 8);
+
+    (void)error;
+    (void)output;
+    return true;
+}
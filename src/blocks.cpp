@@ -0,0 +1,35 @@
+#include "blocks.hpp"
+
+namespace car
+{
+namespace parser
+{
+
+const BlockType *BlockRegistry::Register(const BlockType &type)
+{
+    if (type.symbols < 0 || type.symbols > 2 || type.keyword.empty() || this->keywords.Find(type.keyword) != Interner::None)
+    {
+        return nullptr;
+    }
+
+    this->keywords.Intern(type.keyword);
+    this->types.push_back(type);
+
+    return &this->types.back();
+}
+
+const BlockType *BlockRegistry::Find(string_view keyword) const
+{
+    auto id = this->keywords.Find(keyword);
+    if (id == Interner::None || id < Interner::Keywords)
+    {
+        return nullptr;
+    }
+
+    return &this->types[id - Interner::Keywords];
+}
+
+} // namespace parser
+// LCOV_EXCL_START
+} // namespace car
+  // LCOV_EXCL_STOP
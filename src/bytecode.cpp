@@ -0,0 +1,304 @@
+#include "bytecode.hpp"
+
+#if defined(__GNUC__)
+#define CARENDER_MACHINE_COMPUTED_GOTO
+#endif
+
+namespace car
+{
+namespace bytecode
+{
+
+void Compiler::Compile(const parser::Ast &nodes, Program &output)
+{
+    output.ast = &nodes;
+    output.code.clear();
+    this->code = &output.code;
+    this->frames.clear();
+
+    // Top-level nodes are compiled as the children of a block that nothing jumps past.
+    this->frames.push_back(Frame{nodes.begin(), nodes.end(), 0, Op::Halt});
+
+    while (!this->frames.empty())
+    {
+        const auto depth = this->frames.size();
+        auto &frame = this->frames.back();
+
+        // Siblings are compiled in a row until one of them opens a block, which moves the frames.
+        while (frame.next != frame.end)
+        {
+            auto child = *frame.next;
+            ++frame.next;
+            child.accept(*this);
+
+            if (this->frames.size() != depth)
+            {
+                break;
+            }
+        }
+
+        if (this->frames.size() != depth)
+        {
+            continue;
+        }
+
+        if (depth > 1)
+        {
+            if (frame.close != Op::Halt)
+            {
+                this->emit(frame.close, 0, 0, nullptr);
+                this->code->back().target = static_cast<uint32_t>(frame.begin + 1);
+            }
+            (*this->code)[frame.begin].target = static_cast<uint32_t>(this->code->size());
+        }
+        this->frames.pop_back();
+    }
+
+    this->emit(Op::Halt, 0, 0, nullptr);
+}
+
+void Compiler::emit(Op op, uint32_t a, uint32_t b, const parser::NodeData *node)
+{
+    auto instruction = Instruction();
+    instruction.op = op;
+    instruction.a = a;
+    instruction.b = b;
+    instruction.target = 0;
+    instruction.node = node;
+    this->code->push_back(instruction);
+}
+
+void Compiler::open(Op close, const parser::NodeRange &children)
+{
+    this->frames.push_back(Frame{children.begin(), children.end(), this->code->size() - 1, close});
+}
+
+void Compiler::visit(const parser::TextNode &n)
+{
+    const auto text = n.Text();
+    this->emit(Op::EmitText, static_cast<uint32_t>(text.size()), 0, nullptr);
+    this->code->back().text = text.data();
+}
+
+void Compiler::visit(const parser::PrintNode &n)
+{
+    this->emit(Op::EmitSlot, n.SymbolId(), 0, &n.Data());
+}
+
+void Compiler::visit(const parser::LoopNode &n)
+{
+    this->emit(Op::LoopBegin, n.RangeSymbolId(), n.ElementSymbolId(), &n.Data());
+    this->open(Op::LoopNext, n.Children());
+}
+
+void Compiler::visit(const parser::IfEqNode &n)
+{
+    this->emit(Op::JumpIfNe, n.LeftSymbolId(), n.RightSymbolId(), &n.Data());
+    this->open(Op::Halt, n.Children());
+}
+
+void Compiler::visit(const parser::BlockNode &n)
+{
+    this->emit(Op::BlockBegin, 0, 0, &n.Data());
+    this->open(Op::BlockNext, n.Children());
+}
+
+void Machine::resolve(const Interner &names)
+{
+    // Names are hashed once per run, instructions index the slots by id.
+    this->slots.assign(names.size(), nullptr);
+    this->rangeSlots.assign(names.size(), nullptr);
+    for (uint32_t id = 0; id < names.size(); id++)
+    {
+        auto symbol = this->symbols.find(names.Name(id));
+        if (symbol != this->symbols.end())
+        {
+            this->slots[id] = &symbol->second;
+        }
+
+        auto range = this->rangeSymbols.find(names.Name(id));
+        if (range != this->rangeSymbols.end())
+        {
+            this->rangeSlots[id] = &range->second;
+        }
+    }
+}
+
+bool Machine::fail(const std::string &message, const std::string &name)
+{
+    this->hasError = true;
+    this->error << message << ": `" << name << "`" << std::endl;
+    return false;
+}
+
+bool Machine::Run(const Program &program)
+{
+    if (this->hasError)
+    {
+        return false;
+    }
+
+    const auto &ast = program.Source();
+    const auto &names = ast.Names();
+    this->resolve(names);
+    this->loops.clear();
+    this->blocks.clear();
+
+    const auto *code = program.Code().data();
+    const auto *pc = code;
+    auto &slots = this->slots;
+
+#ifdef CARENDER_MACHINE_COMPUTED_GOTO
+    // In the order of Op.
+    static const void *labels[] = {&&opEmitText, &&opEmitSlot, &&opLoopBegin, &&opLoopNext,
+                                   &&opJumpIfNe, &&opBlockBegin, &&opBlockNext, &&opHalt};
+#define DISPATCH() goto *labels[static_cast<uint8_t>(pc->op)]
+#define OP(name) op##name
+#else
+#define DISPATCH() goto dispatch
+#define OP(name) case Op::name
+#endif
+
+    DISPATCH();
+
+#ifndef CARENDER_MACHINE_COMPUTED_GOTO
+dispatch:
+    switch (pc->op)
+    {
+#endif
+    OP(EmitText) :
+    {
+        this->output.write(pc->text, pc->a);
+        pc++;
+        DISPATCH();
+    }
+    OP(EmitSlot) :
+    {
+        const auto *value = slots[pc->a];
+        if (value == nullptr)
+        {
+            return this->fail("Symbol not found", names.Name(pc->a));
+        }
+        this->output.write(value->data(), value->size());
+        pc++;
+        DISPATCH();
+    }
+    OP(LoopBegin) :
+    {
+        const auto *range = this->rangeSlots[pc->a];
+        if (range == nullptr)
+        {
+            return this->fail("Range symbol not found", names.Name(pc->a));
+        }
+
+        // Symbol names must be unique across the program, i.e. every symbol is global-scoped.
+        if (slots[pc->b] != nullptr)
+        {
+            this->hasError = true;
+            this->error << "Symbol names must be unique across the program, redefined `" << names.Name(pc->b)
+                        << "` at " << pc->node->ctx << std::endl;
+            return false;
+        }
+
+        if (range->empty())
+        {
+            pc = code + pc->target;
+            DISPATCH();
+        }
+
+        slots[pc->b] = &(*range)[0];
+        this->loops.push_back(Loop{range, 0, pc->b});
+        pc++;
+        DISPATCH();
+    }
+    OP(LoopNext) :
+    {
+        auto &loop = this->loops.back();
+        if (++loop.index < loop.range->size())
+        {
+            slots[loop.element] = &(*loop.range)[loop.index];
+            pc = code + pc->target;
+            DISPATCH();
+        }
+
+        slots[loop.element] = nullptr;
+        this->loops.pop_back();
+        pc++;
+        DISPATCH();
+    }
+    OP(JumpIfNe) :
+    {
+        const auto *left = slots[pc->a];
+        if (left == nullptr)
+        {
+            return this->fail("Symbol not found", names.Name(pc->a));
+        }
+
+        const auto *right = slots[pc->b];
+        if (right == nullptr)
+        {
+            return this->fail("Symbol not found", names.Name(pc->b));
+        }
+
+        pc = *left == *right ? pc + 1 : code + pc->target;
+        DISPATCH();
+    }
+    OP(BlockBegin) :
+    {
+        const auto node = parser::BlockNode(ast, *pc->node);
+        for (size_t i = 0; i < node.SymbolCount(); i++)
+        {
+            this->blockValues[i] = slots[node.SymbolId(i)];
+            if (this->blockValues[i] == nullptr)
+            {
+                return this->fail("Symbol not found", node.Symbol(i));
+            }
+        }
+
+        const auto &type = node.Type();
+        this->blockRenders = type.render == nullptr ? 1 : 0;
+        if (type.render != nullptr && !type.render(node, *this))
+        {
+            this->hasError = true;
+            return false;
+        }
+
+        if (this->blockRenders == 0)
+        {
+            pc = code + pc->target;
+            DISPATCH();
+        }
+
+        this->blocks.push_back(this->blockRenders);
+        pc++;
+        DISPATCH();
+    }
+    OP(BlockNext) :
+    {
+        if (--this->blocks.back() > 0)
+        {
+            pc = code + pc->target;
+            DISPATCH();
+        }
+
+        this->blocks.pop_back();
+        pc++;
+        DISPATCH();
+    }
+    OP(Halt) :
+    {
+        return true;
+    }
+#ifndef CARENDER_MACHINE_COMPUTED_GOTO
+    }
+    return true; // LCOV_EXCL_LINE all operations are handled.
+#endif
+
+#undef DISPATCH
+#undef OP
+}
+
+} // namespace bytecode
+// LCOV_EXCL_START
+} // namespace car
+  // LCOV_EXCL_STOP
@@ -0,0 +1,144 @@
+#include <cstring>
+
+#include "cache.hpp"
+
+namespace car
+{
+namespace cache
+{
+
+namespace
+{
+
+inline uint64_t mix(uint64_t hash, uint64_t word)
+{
+    hash ^= word * 0x9E3779B97F4A7C15ULL;
+    hash = (hash << 31) | (hash >> 33);
+    return hash * 0xBF58476D1CE4E5B9ULL;
+}
+
+} // namespace
+
+uint64_t Hash(const char *data, size_t size, uint64_t seed)
+{
+    auto hash = mix(seed, size);
+    size_t i = 0;
+    for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t))
+    {
+        uint64_t word;
+        std::memcpy(&word, data + i, sizeof(word));
+        hash = mix(hash, word);
+    }
+
+    // The last bytes are padded with zeros, the size tells them apart from text ending with zeros.
+    uint64_t tail = 0;
+    if (i < size)
+    {
+        std::memcpy(&tail, data + i, size - i);
+    }
+    hash = mix(hash, tail);
+
+    hash ^= hash >> 30;
+    hash *= 0xBF58476D1CE4E5B9ULL;
+    hash ^= hash >> 27;
+    hash *= 0x94D049BB133111EBULL;
+    return hash ^ (hash >> 31);
+}
+
+TemplateCache &TemplateCache::Global()
+{
+    static TemplateCache cache(64 * 1024 * 1024);
+    return cache;
+}
+
+std::shared_ptr<const TemplateCache::Entry> TemplateCache::Get(string_view text, uint64_t scope, const Compile &compile)
+{
+    const auto key = Hash(text.data(), text.size(), scope);
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        auto it = this->slots.find(key);
+        if (it != this->slots.end())
+        {
+            // Keys may collide, the template is only used if it was compiled from the same text.
+            const auto &entry = it->second->entry;
+            if (entry->scope == scope && string_view(entry->text) == text)
+            {
+                this->order.splice(this->order.begin(), this->order, it->second);
+                this->stats.hits++;
+                return entry;
+            }
+        }
+        this->stats.misses++;
+    }
+
+    // Templates are compiled without holding the lock, threads that miss the same one compile it each.
+    auto entry = std::make_shared<Entry>();
+    entry->text.assign(text.data(), text.size());
+    entry->scope = scope;
+    if (!compile(entry->text, entry->nodes))
+    {
+        return nullptr;
+    }
+
+    const auto bytes = sizeof(Slot) + sizeof(Entry) - sizeof(parser::Ast) + entry->text.capacity() + entry->nodes.MemoryUsage();
+    std::lock_guard<std::mutex> lock(this->mutex);
+    if (bytes > this->budget)
+    {
+        return entry;
+    }
+
+    auto it = this->slots.find(key);
+    if (it != this->slots.end())
+    {
+        this->stats.bytes -= it->second->bytes;
+        this->order.erase(it->second);
+        this->slots.erase(it);
+    }
+
+    this->order.push_front(Slot{entry, key, bytes});
+    this->slots[key] = this->order.begin();
+    this->stats.bytes += bytes;
+    this->evict();
+
+    return entry;
+}
+
+void TemplateCache::SetBudget(size_t budget)
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->budget = budget;
+    this->evict();
+}
+
+void TemplateCache::Clear()
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->order.clear();
+    this->slots.clear();
+    this->stats.bytes = 0;
+}
+
+Stats TemplateCache::Counters() const
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    auto stats = this->stats;
+    stats.entries = this->slots.size();
+    return stats;
+}
+
+void TemplateCache::evict()
+{
+    while (this->stats.bytes > this->budget)
+    {
+        const auto &slot = this->order.back();
+        this->stats.bytes -= slot.bytes;
+        this->stats.evictions++;
+        this->slots.erase(slot.key);
+        this->order.pop_back();
+    }
+}
+
+} // namespace cache
+// LCOV_EXCL_START
+} // namespace car
+  // LCOV_EXCL_STOP
@@ -0,0 +1,256 @@
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "carc.hpp"
+
+using car::parser::BlockType;
+using car::parser::NodeData;
+
+namespace car
+{
+namespace carc
+{
+
+namespace
+{
+
+const char Magic[4] = {'C', 'A', 'R', 'C'};
+const uint32_t ByteOrder = 0x01020304;
+
+template <typename T>
+void writeAll(std::ostream &output, const std::vector<T> &values)
+{
+    output.write(reinterpret_cast<const char *>(values.data()), values.size() * sizeof(T));
+}
+
+/**
+* Strings of a file being written. Texts that nodes share, e.g. the text of unrolled loops, are written once.
+*/
+class Strings
+{
+public:
+    Span Add(const char *text, size_t size)
+    {
+        auto &span = this->spans[text];
+        if (span.size < size)
+        {
+            span = Span{this->bytes.size(), size};
+            this->bytes.append(text, size);
+        }
+        return Span{span.offset, size};
+    }
+
+    const std::string &Bytes() const { return this->bytes; }
+
+private:
+    std::string bytes;
+    // Span written for each address, nodes may refer to a prefix of it.
+    std::unordered_map<const char *, Span> spans;
+};
+
+} // namespace
+
+bool Writer::Write(const parser::Ast &nodes, std::ostream &output)
+{
+    auto strings = Strings();
+    auto names = std::vector<Span>();
+    for (uint32_t id = Interner::Keywords; id < nodes.names.size(); id++)
+    {
+        const auto &name = nodes.names.Name(id);
+        names.push_back(strings.Add(name.data(), name.size()));
+    }
+
+    // Registered blocks are written as keywords, a reader resolves them to its own types.
+    auto blocks = std::vector<Span>();
+    auto blockIndices = std::unordered_map<const BlockType *, uint64_t>();
+    auto records = std::vector<Record>();
+    records.reserve(nodes.nodes.size() + nodes.pending.size());
+    for (const auto *arena : {&nodes.nodes, &nodes.pending})
+    {
+        for (const auto &node : *arena)
+        {
+            auto record = Record{static_cast<uint8_t>(node.type), node.isInvariant, 0, {node.symbols[0], node.symbols[1]},
+                                 node.first, node.count, node.ctx.StartPos(), node.ctx.EndPos(), 0, 0};
+            if (node.type == NodeData::Type::Text)
+            {
+                record.text = strings.Add(node.text, node.count).offset;
+            }
+            else if (node.type == NodeData::Type::Block)
+            {
+                auto it = blockIndices.find(node.block);
+                if (it == blockIndices.end())
+                {
+                    it = blockIndices.emplace(node.block, blocks.size()).first;
+                    blocks.push_back(strings.Add(node.block->keyword.data(), node.block->keyword.size()));
+                }
+                record.text = it->second;
+            }
+            records.push_back(record);
+        }
+    }
+
+    auto header = Header{{Magic[0], Magic[1], Magic[2], Magic[3]}, Version, ByteOrder,
+                         static_cast<uint32_t>(nodes.nodes.size()), static_cast<uint32_t>(nodes.pending.size()),
+                         static_cast<uint32_t>(names.size()), static_cast<uint32_t>(blocks.size()), 0,
+                         strings.Bytes().size()};
+    output.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    writeAll(output, records);
+    writeAll(output, names);
+    writeAll(output, blocks);
+    output.write(strings.Bytes().data(), strings.Bytes().size());
+
+    return output.good();
+}
+
+bool Reader::Read(const char *begin, const char *end, parser::Ast &nodes, std::ostream &error)
+{
+    // Nodes read so far are removed if the file is invalid.
+    nodes.clear();
+    auto fail = [&]() -> std::ostream & {
+        nodes.clear();
+        return error;
+    };
+
+    // Fields are copied out of the file, which need not be aligned.
+    auto header = Header();
+    const auto size = static_cast<uint64_t>(end - begin);
+    if (size < sizeof(header))
+    {
+        fail() << "Compiled template is truncated." << std::endl;
+        return false;
+    }
+    std::memcpy(&header, begin, sizeof(header));
+
+    if (std::memcmp(header.magic, Magic, sizeof(Magic)) != 0)
+    {
+        fail() << "Not a compiled template." << std::endl;
+        return false;
+    }
+    if (header.byteOrder != ByteOrder)
+    {
+        fail() << "Compiled template has another byte order." << std::endl;
+        return false;
+    }
+    if (header.version != Version)
+    {
+        fail() << "Compiled template has version " << header.version << ", expected " << Version << "." << std::endl;
+        return false;
+    }
+
+    const auto records = static_cast<uint64_t>(header.nodes) + header.roots;
+    const auto tables = sizeof(header) + records * sizeof(Record) + (static_cast<uint64_t>(header.names) + header.blocks) * sizeof(Span);
+    if (size < tables || size - tables != header.strings)
+    {
+        fail() << "Compiled template is truncated." << std::endl;
+        return false;
+    }
+
+    const auto *recordBytes = begin + sizeof(header);
+    const auto *spanBytes = recordBytes + records * sizeof(Record);
+    const auto *strings = spanBytes + (static_cast<uint64_t>(header.names) + header.blocks) * sizeof(Span);
+    auto string = [&](size_t index, string_view &value) {
+        auto span = Span();
+        std::memcpy(&span, spanBytes + index * sizeof(Span), sizeof(span));
+        if (span.offset > header.strings || span.size > header.strings - span.offset)
+        {
+            return false;
+        }
+        value = string_view(strings + span.offset, span.size);
+        return true;
+    };
+
+    for (uint32_t i = 0; i < header.names; i++)
+    {
+        auto name = string_view();
+        if (!string(i, name) || nodes.names.Intern(name) != Interner::Keywords + i)
+        {
+            fail() << "Compiled template has invalid names." << std::endl;
+            return false;
+        }
+    }
+
+    auto blocks = std::vector<const BlockType *>();
+    for (uint32_t i = 0; i < header.blocks; i++)
+    {
+        auto keyword = string_view();
+        if (!string(header.names + i, keyword))
+        {
+            fail() << "Compiled template has invalid names." << std::endl;
+            return false;
+        }
+
+        const auto *type = this->blocks == nullptr ? nullptr : this->blocks->Find(keyword);
+        if (type == nullptr)
+        {
+            fail() << "Block `" << keyword << "` is not registered." << std::endl;
+            return false;
+        }
+        blocks.push_back(type);
+    }
+
+    // Children precede their block, so the tree has no cycles.
+    const auto names = nodes.names.size();
+    auto isName = [&](uint32_t id) { return id < names; };
+    nodes.nodes.reserve(header.nodes);
+    nodes.pending.reserve(header.roots);
+    for (uint64_t i = 0; i < records; i++)
+    {
+        auto record = Record();
+        std::memcpy(&record, recordBytes + i * sizeof(Record), sizeof(record));
+
+        const auto type = static_cast<NodeData::Type>(record.type);
+        auto node = NodeData{type, record.isInvariant != 0, {record.symbols[0], record.symbols[1]}, record.first,
+                             record.count, Context(record.start, record.end), nullptr};
+        auto isValid = true;
+        switch (type)
+        {
+        case NodeData::Type::Text:
+            isValid = record.text <= header.strings && record.count <= header.strings - record.text;
+            node.text = isValid ? strings + record.text : nullptr;
+            break;
+        case NodeData::Type::Print:
+            isValid = isName(record.symbols[0]);
+            break;
+        case NodeData::Type::Loop:
+        case NodeData::Type::IfEq:
+            isValid = isName(record.symbols[0]) && isName(record.symbols[1]);
+            break;
+        case NodeData::Type::Block:
+            isValid = record.text < blocks.size();
+            if (isValid)
+            {
+                node.block = blocks[record.text];
+                for (auto j = 0; j < node.block->symbols; j++)
+                {
+                    isValid = isValid && isName(record.symbols[j]);
+                }
+            }
+            break;
+        default:
+            isValid = false;
+        }
+
+        const auto children = i < header.nodes ? i : header.nodes;
+        if (type != NodeData::Type::Text && type != NodeData::Type::Print &&
+            static_cast<uint64_t>(record.first) + record.count > children)
+        {
+            isValid = false;
+        }
+        if (!isValid)
+        {
+            fail() << "Compiled template has an invalid node." << std::endl;
+            return false;
+        }
+
+        (i < header.nodes ? nodes.nodes : nodes.pending).push_back(node);
+    }
+
+    return true;
+}
+
+} // namespace carc
+// LCOV_EXCL_START
+} // namespace car
+  // LCOV_EXCL_STOP
@@ -0,0 +1,275 @@
+#include "codegen.hpp"
+
+#include <algorithm>
+
+namespace car
+{
+namespace codegen
+{
+
+namespace
+{
+
+/**
+* Writes `text` as the contents of a string literal. Characters that are not printable are written as octal
+* escapes, which end after three digits whatever follows them.
+*/
+void writeLiteral(std::ostream &output, string_view text)
+{
+    static const char digits[] = "01234567";
+    for (auto c : text)
+    {
+        auto byte = static_cast<unsigned char>(c);
+        switch (c)
+        {
+        case '"':
+        case '\\':
+        case '?': // Trigraphs are not written.
+            output << '\\' << c;
+            break;
+        case '\n':
+            output << "\\n";
+            break;
+        case '\t':
+            output << "\\t";
+            break;
+        default:
+            if (byte < 0x20 || byte >= 0x7f)
+            {
+                output << '\\' << digits[byte >> 6] << digits[(byte >> 3) & 7] << digits[byte & 7];
+            }
+            else
+            {
+                output << c;
+            }
+        }
+    }
+}
+
+} // namespace
+
+void Resolve(const std::unordered_map<std::string, std::string> &symbols,
+             const std::unordered_map<std::string, std::vector<std::string>> &rangeSymbols,
+             const char *const *names,
+             size_t count,
+             const std::string **values,
+             const std::vector<std::string> **ranges)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        auto symbol = symbols.find(names[i]);
+        values[i] = symbol == symbols.end() ? nullptr : &symbol->second;
+
+        auto range = rangeSymbols.find(names[i]);
+        ranges[i] = range == rangeSymbols.end() ? nullptr : &range->second;
+    }
+}
+
+bool SymbolNotFound(std::ostream &error, const char *name)
+{
+    error << "Symbol not found: `" << name << "`" << std::endl;
+    return false;
+}
+
+bool RangeSymbolNotFound(std::ostream &error, const char *name)
+{
+    error << "Range symbol not found: `" << name << "`" << std::endl;
+    return false;
+}
+
+bool Redefined(std::ostream &error, const char *name, const char *ctx)
+{
+    error << "Symbol names must be unique across the program, redefined `" << name << "` at " << ctx << std::endl;
+    return false;
+}
+
+std::string FunctionName(const std::string &path)
+{
+    auto name = path;
+    auto dot = name.rfind('.');
+    if (dot != std::string::npos && name.find('/', dot) == std::string::npos)
+    {
+        name.resize(dot);
+    }
+
+    for (auto &c : name)
+    {
+        if (!((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9')))
+        {
+            c = '_';
+        }
+    }
+
+    return "render_" + name;
+}
+
+bool Generator::Generate(const parser::Ast &nodes, const std::string &function, std::ostream &output, std::ostream &error)
+{
+    this->nodes = &nodes;
+    this->body.str(std::string());
+    this->frames.clear();
+    this->slots.assign(nodes.Names().size(), -1);
+    this->ids.clear();
+    this->unsupported.clear();
+
+    // Blocks are generated on a stack, the generated code nests as deep as the template.
+    this->frames.push_back(Frame{nodes.begin(), nodes.end(), -1});
+    while (!this->frames.empty())
+    {
+        const auto depth = this->frames.size();
+        auto &frame = this->frames.back();
+
+        while (frame.next != frame.end)
+        {
+            auto child = *frame.next;
+            ++frame.next;
+            child.accept(*this);
+
+            if (this->frames.size() != depth)
+            {
+                break;
+            }
+        }
+
+        if (this->frames.size() != depth)
+        {
+            continue;
+        }
+
+        const auto element = frame.element;
+        this->frames.pop_back();
+        if (depth > 1)
+        {
+            this->line() << "}" << std::endl;
+            if (element != -1)
+            {
+                this->line() << "values[" << element << "] = nullptr;" << std::endl;
+            }
+        }
+    }
+
+    if (!this->unsupported.empty())
+    {
+        error << "Registered block `" << this->unsupported << "` cannot be generated." << std::endl;
+        return false;
+    }
+
+    // Names are known once the body is generated, arrays have at least one element.
+    const auto count = std::max<size_t>(this->ids.size(), 1);
+    output << "// Generated by carender --emit-cpp, do not edit." << std::endl
+           << "#include \"codegen.hpp\"" << std::endl
+           << std::endl
+           << "CARENDER_TEMPLATE(" << function << ")" << std::endl
+           << "{" << std::endl
+           << "    static const char *const names[] = {";
+    for (size_t i = 0; i < this->ids.size(); i++)
+    {
+        output << (i == 0 ? "\"" : ", \"");
+        writeLiteral(output, nodes.Names().Name(this->ids[i]));
+        output << "\"";
+    }
+    output << (this->ids.empty() ? "nullptr" : "") << "};" << std::endl
+           << "    const std::string *values[" << count << "] = {};" << std::endl
+           << "    const std::vector<std::string> *ranges[" << count << "] = {};" << std::endl
+           << "    car::codegen::Resolve(symbols, rangeSymbols, names, " << this->ids.size() << ", values, ranges);" << std::endl
+           << "    (void)values;" << std::endl
+           << "    (void)ranges;" << std::endl
+           << std::endl
+           << this->body.str()
+           << std::endl
+           << "    (void)error;" << std::endl
+           << "    (void)output;" << std::endl
+           << "    return true;" << std::endl
+           << "}" << std::endl;
+
+    return true;
+}
+
+size_t Generator::slot(uint32_t id)
+{
+    if (this->slots[id] == -1)
+    {
+        this->slots[id] = static_cast<long>(this->ids.size());
+        this->ids.push_back(id);
+    }
+    return static_cast<size_t>(this->slots[id]);
+}
+
+std::ostream &Generator::line()
+{
+    for (size_t i = 0; i < this->frames.size(); i++)
+    {
+        this->body << "    ";
+    }
+    return this->body;
+}
+
+void Generator::visit(const parser::TextNode &n)
+{
+    const auto text = n.Text();
+    this->line() << "output.append(\"";
+    writeLiteral(this->body, text);
+    this->body << "\", " << text.size() << ");" << std::endl;
+}
+
+void Generator::visit(const parser::PrintNode &n)
+{
+    const auto symbol = this->slot(n.SymbolId());
+    this->line() << "if (values[" << symbol << "] == nullptr)" << std::endl;
+    this->line() << "{" << std::endl;
+    this->line() << "    return car::codegen::SymbolNotFound(error, names[" << symbol << "]);" << std::endl;
+    this->line() << "}" << std::endl;
+    this->line() << "output += *values[" << symbol << "];" << std::endl;
+}
+
+void Generator::visit(const parser::LoopNode &n)
+{
+    const auto range = this->slot(n.RangeSymbolId());
+    const auto element = this->slot(n.ElementSymbolId());
+    std::stringstream ctx;
+    ctx << n.Ctx();
+
+    this->line() << "if (ranges[" << range << "] == nullptr)" << std::endl;
+    this->line() << "{" << std::endl;
+    this->line() << "    return car::codegen::RangeSymbolNotFound(error, names[" << range << "]);" << std::endl;
+    this->line() << "}" << std::endl;
+    this->line() << "if (values[" << element << "] != nullptr)" << std::endl;
+    this->line() << "{" << std::endl;
+    this->line() << "    return car::codegen::Redefined(error, names[" << element << "], \"" << ctx.str() << "\");" << std::endl;
+    this->line() << "}" << std::endl;
+    this->line() << "for (const auto &element" << this->frames.size() << " : *ranges[" << range << "])" << std::endl;
+    this->line() << "{" << std::endl;
+    this->frames.push_back(Frame{n.Children().begin(), n.Children().end(), static_cast<long>(element)});
+    this->line() << "values[" << element << "] = &element" << this->frames.size() - 1 << ";" << std::endl;
+}
+
+void Generator::visit(const parser::IfEqNode &n)
+{
+    const auto left = this->slot(n.LeftSymbolId());
+    const auto right = this->slot(n.RightSymbolId());
+
+    for (auto symbol : {left, right})
+    {
+        this->line() << "if (values[" << symbol << "] == nullptr)" << std::endl;
+        this->line() << "{" << std::endl;
+        this->line() << "    return car::codegen::SymbolNotFound(error, names[" << symbol << "]);" << std::endl;
+        this->line() << "}" << std::endl;
+    }
+    this->line() << "if (*values[" << left << "] == *values[" << right << "])" << std::endl;
+    this->line() << "{" << std::endl;
+    this->frames.push_back(Frame{n.Children().begin(), n.Children().end(), -1});
+}
+
+void Generator::visit(const parser::BlockNode &n)
+{
+    // Hooks of registered blocks are only known at runtime.
+    if (this->unsupported.empty())
+    {
+        this->unsupported = n.Keyword();
+    }
+}
+
+} // namespace codegen
+// LCOV_EXCL_START
+} // namespace car
+  // LCOV_EXCL_STOP
@@ -0,0 +1,91 @@
+#include "interner.hpp"
+
+namespace car
+{
+
+const uint32_t Interner::None;
+const uint32_t Interner::Loop;
+const uint32_t Interner::IfEq;
+const uint32_t Interner::Keywords;
+
+Interner::Interner()
+{
+    this->Intern("loop");
+    this->Intern("ifeq");
+}
+
+Interner::Interner(const Interner &other)
+{
+    for (const auto &name : other.names)
+    {
+        this->Intern(name);
+    }
+}
+
+Interner &Interner::operator=(Interner other)
+{
+    this->names.swap(other.names);
+    this->ids.swap(other.ids);
+
+    return *this;
+}
+
+uint32_t Interner::Intern(string_view name)
+{
+    auto it = this->ids.find(name);
+    if (it != this->ids.end())
+    {
+        return it->second;
+    }
+
+    auto id = static_cast<uint32_t>(this->names.size());
+    this->names.emplace_back(name.data(), name.size());
+    this->ids.emplace(string_view(this->names.back()), id);
+
+    return id;
+}
+
+void Interner::Assign(const Interner &other)
+{
+    size_t same = 0;
+    while (same < this->names.size() && same < other.names.size() && this->names[same] == other.names[same])
+    {
+        same++;
+    }
+
+    this->Truncate(same);
+    for (auto id = same; id < other.names.size(); id++)
+    {
+        this->Intern(other.names[id]);
+    }
+}
+
+void Interner::Truncate(size_t count)
+{
+    while (this->names.size() > count)
+    {
+        this->ids.erase(string_view(this->names.back()));
+        this->names.pop_back();
+    }
+}
+
+uint32_t Interner::Find(string_view name) const
+{
+    auto it = this->ids.find(name);
+    return it == this->ids.end() ? None : it->second;
+}
+
+size_t Interner::Hash::operator()(string_view name) const
+{
+    // FNV-1a, names are short.
+    size_t hash = 14695981039346656037ULL;
+    for (auto c : name)
+    {
+        hash = (hash ^ static_cast<unsigned char>(c)) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+// LCOV_EXCL_START
+} // namespace car
+  // LCOV_EXCL_STOP
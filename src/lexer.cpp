@@ -1,4 +1,9 @@
+#include <algorithm>
+#include <cstdio>
+#include <thread>
+
 #include "lexer.hpp"
+#include "scanner.hpp"
 
 using namespace car;
 
@@ -7,37 +12,37 @@ namespace car
 namespace lexer
 {
 
-const Token TokenFactory::newStartDirective(const Context context)
+Token TokenFactory::newStartDirective(const Context context)
 {
     return Token(Token::Type::StartDirective, context);
 }
 
-const Token TokenFactory::newEndDirective(const Context context)
+Token TokenFactory::newEndDirective(const Context context)
 {
     return Token(Token::Type::EndDirective, context);
 }
 
-const Token TokenFactory::newStartBlock(const Context context)
+Token TokenFactory::newStartBlock(const Context context)
 {
     return Token(Token::Type::StartBlock, context);
 }
 
-const Token TokenFactory::newEndBlock(const Context context)
+Token TokenFactory::newEndBlock(const Context context)
 {
     return Token(Token::Type::EndBlock, context);
 }
 
-const Token TokenFactory::newKeyword(const std::string text, const Context context)
+Token TokenFactory::newKeyword(const string_view text, const Context context, const uint32_t id)
 {
-    return Token(Token::Type::Keyword, context, text);
+    return Token(Token::Type::Keyword, context, text, id);
 }
 
-const Token TokenFactory::newSymbol(const std::string text, const Context context)
+Token TokenFactory::newSymbol(const string_view text, const Context context, const uint32_t id)
 {
-    return Token(Token::Type::Symbol, context, text);
+    return Token(Token::Type::Symbol, context, text, id);
 }
 
-const Token TokenFactory::newText(const std::string text, const Context context)
+Token TokenFactory::newText(const string_view text, const Context context)
 {
     return Token(Token::Type::Text, context, text);
 }
@@ -84,47 +89,563 @@ std::ostream &operator<<(std::ostream &os, const Token &tok)
     return os;
 }
 
-const std::string Lexer::readIdentifier(std::istream &input)
+void TokenStream::push_back(const Token &token)
+{
+    auto type = static_cast<uint8_t>(token.GetType());
+    const auto &ctx = token.GetContext();
+    const auto value = token.GetValue();
+
+    auto hasValue = token.GetType() == Token::Type::Text ||
+                    token.GetType() == Token::Type::Keyword ||
+                    token.GetType() == Token::Type::Symbol;
+    auto isSourceRange = ctx.StartPos() >= 0 && ctx.StartPos() <= ctx.EndPos() &&
+                         static_cast<size_t>(ctx.EndPos()) <= this->sourceSize;
+    auto isRegular = isSourceRange &&
+                     (hasValue ? value.data() == this->source + ctx.StartPos() &&
+                                     value.size() == static_cast<size_t>(ctx.EndPos() - ctx.StartPos())
+                               : value.size() == 0);
+
+    auto id = hasId(token.GetType()) ? this->names.Intern(value) : Interner::None;
+
+    if (isRegular)
+    {
+        this->starts.push_back(ctx.StartPos());
+        this->ends.push_back(hasId(token.GetType()) ? id : ctx.EndPos());
+    }
+    else
+    {
+        type |= irregular;
+        this->starts.push_back(this->irregulars.size());
+        this->ends.push_back(0);
+        this->irregulars.push_back(Token(token.GetType(), ctx, value, id));
+    }
+
+    this->types.push_back(type);
+}
+
+void TokenStream::reset(const char *begin, const char *end)
+{
+    this->source = begin;
+    this->sourceSize = end - begin;
+    this->types.clear();
+    this->starts.clear();
+    this->ends.clear();
+    this->irregulars.clear();
+    this->names = Interner();
+}
+
+void TokenStream::erase_front(size_t count)
+{
+    auto rest = std::vector<Token>();
+    for (auto i = count; i < this->size(); i++)
+    {
+        rest.push_back((*this)[i]);
+    }
+
+    this->types.clear();
+    this->starts.clear();
+    this->ends.clear();
+    this->irregulars.clear();
+    for (const auto &token : rest)
+    {
+        this->push_back(token);
+    }
+}
+
+Token TokenStream::operator[](size_t index) const
+{
+    auto type = this->GetType(index);
+    if (this->types[index] & irregular)
+    {
+        return this->irregulars[this->starts[index]];
+    }
+
+    auto start = this->starts[index];
+    auto end = this->ends[index];
+    switch (type)
+    {
+    case Token::Type::Text:
+        return Token(type, Context(start, end), string_view(this->source + start, end - start));
+    case Token::Type::Keyword:
+    case Token::Type::Symbol:
+    {
+        auto length = this->names.Name(end).size();
+        return Token(type, Context(start, start + length), string_view(this->source + start, length), end);
+    }
+    default:
+        return Token(type, Context(start, end));
+    }
+}
+
+size_t TokenStream::MemoryUsage() const
+{
+    return this->types.capacity() * sizeof(uint8_t) +
+           this->starts.capacity() * sizeof(uint32_t) +
+           this->ends.capacity() * sizeof(uint32_t) +
+           this->irregulars.capacity() * sizeof(Token);
+}
+
+namespace
+{
+
+bool isSpace(char c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\v' || c == '\f' || c == '\r';
+}
+
+/**
+* Reads a contiguous buffer with the semantics of the std::istream operations the lexer was
+* originally written against, including the eof/fail state that makes positions read as -1
+* once the end of input has been touched.
+*/
+class Cursor
+{
+public:
+    Cursor(const char *begin, const char *end, long offset)
+        : begin(begin), it(begin), end(end), offset(offset), eof(false), fail(false) {}
+
+    /**
+    * Equivalent of `input >> c` with std::noskipws.
+    */
+    bool get(char &c)
+    {
+        if (!this->good())
+        {
+            this->fail = true;
+            return false;
+        }
+        if (this->it == this->end)
+        {
+            this->eof = true;
+            this->fail = true;
+            return false;
+        }
+        c = *this->it++;
+        return true;
+    }
+
+    /**
+    * Equivalent of `input.peek()`, returns EOF at the end of input.
+    */
+    int peek()
+    {
+        if (!this->good())
+        {
+            this->fail = true;
+            return EOF;
+        }
+        if (this->it == this->end)
+        {
+            this->eof = true;
+            return EOF;
+        }
+        return *this->it;
+    }
+
+    /**
+    * Equivalent of `input.ignore(1)`.
+    */
+    void ignore()
+    {
+        if (!this->good())
+        {
+            this->fail = true;
+            return;
+        }
+        if (this->it == this->end)
+        {
+            this->eof = true;
+            return;
+        }
+        this->it++;
+    }
+
+    /**
+    * Equivalent of `input >> std::ws`.
+    */
+    void skipWhitespace()
+    {
+        if (!this->good())
+        {
+            this->fail = true;
+            return;
+        }
+        while (this->it != this->end && isSpace(*this->it))
+        {
+            this->it++;
+        }
+        if (this->it == this->end)
+        {
+            this->eof = true;
+        }
+    }
+
+    /**
+    * Equivalent of `input.tellg()` plus the offset of the buffer, returns -1 after the end of input has been reached.
+    */
+    long tell()
+    {
+        if (!this->good())
+        {
+            this->fail = true;
+            return -1L;
+        }
+        return this->it - this->begin + this->offset;
+    }
+
+    /**
+    * Equivalent of `input.seekg(-1, std::ios_base::cur)`.
+    */
+    void unget()
+    {
+        this->eof = false;
+        if (!this->fail)
+        {
+            this->it--;
+        }
+    }
+
+    /**
+    * Consumes the characters up to `position`, which must be within the unread input.
+    */
+    void skipTo(const char *position)
+    {
+        this->it = position;
+    }
+
+    /**
+    * Get the position of the next character to be read.
+    */
+    const char *current() const { return this->it; }
+
+    /**
+    * Get the end of the input.
+    */
+    const char *last() const { return this->end; }
+
+private:
+    bool good() const { return !this->eof && !this->fail; }
+
+    const char *const begin;
+    const char *it;
+    const char *const end;
+    const long offset;
+    bool eof;
+    bool fail;
+};
+
+/**
+* Reads an identifier that ends before a whitespace or '}', returns the start of it and sets `size`.
+*/
+const char *readIdentifier(Cursor &input, size_t &size)
 {
-    std::string word;
+    auto word = input.current();
+    size = 0;
     char c;
-    while (input >> c && !std::isspace(c) && c != '}')
+    while (input.get(c) && !isSpace(c) && c != '}')
     {
-        word += c;
+        size++;
     }
 
-    if (input.tellg() != EOF)
+    if (input.tell() != EOF)
     {
-        input.seekg(-1, std::ios_base::cur);
+        input.unget();
     }
 
     return word;
 }
 
+} // namespace
+
+const std::string &Lexer::read(std::istream &input)
+{
+    this->buffers.emplace_front();
+    auto &buffer = this->buffers.front();
+    char chunk[4096];
+    while (input.read(chunk, sizeof(chunk)) || input.gcount() > 0)
+    {
+        buffer.append(chunk, input.gcount());
+    }
+
+    return buffer;
+}
+
 bool Lexer::lex(std::istream &input, std::vector<Token> &output, std::ostream &error)
 {
+    const auto &buffer = this->read(input);
+    return this->lexBuffer(buffer.data(), buffer.data() + buffer.size(), 0, output, error);
+}
+
+bool Lexer::lex(const char *begin, const char *end, std::vector<Token> &output, std::ostream &error)
+{
+    return this->lexBuffer(begin, end, 0, output, error);
+}
+
+namespace
+{
+
+/**
+* Returns the first "{{" at or after `from` that is not preceded by a '{' or a '}', or `end` if there is none.
+* Outside of a directive, such a "{{" is always a StartDirective that starts at its first '{'.
+*/
+const char *findDirectiveStart(const char *begin, const char *from, const char *end)
+{
+    for (auto it = scanner::Find(from, end, '{'); it != end; it = scanner::Find(it + 1, end, '{'))
+    {
+        if (it + 1 != end && it[1] == '{' && (it == begin || (it[-1] != '{' && it[-1] != '}')))
+        {
+            return it;
+        }
+    }
+    return end;
+}
+
+} // namespace
+
+bool Lexer::lex(const char *begin, const char *end, std::vector<Token> &output, std::ostream &error, unsigned threads)
+{
+    // Split the input at directive starts close to equal parts. Each part is lexed speculatively as if it started
+    // outside of a directive, which is the case unless a directive of the previous part contains "{{".
+    auto bounds = std::vector<const char *>{begin};
+    for (unsigned i = 1; i < threads; i++)
+    {
+        auto from = std::max(begin + (end - begin) * i / threads, bounds.back() + 1);
+        auto bound = from < end ? findDirectiveStart(begin, from, end) : end;
+        if (bound == end)
+        {
+            break;
+        }
+        bounds.push_back(bound);
+    }
+    bounds.push_back(end);
+
+    auto parts = bounds.size() - 1;
+    if (parts == 1)
+    {
+        return this->lex(begin, end, output, error);
+    }
+
+    auto lexers = std::vector<Lexer>(parts);
+    lexers[0].isInDirective = this->isInDirective;
+    lexers[0].isInBlock = this->isInBlock;
+    auto tokens = std::vector<std::vector<Token>>(parts);
+    auto results = std::vector<char>(parts);
+    auto workers = std::vector<std::thread>();
+    auto lexPart = [&](size_t i) {
+        std::ostream ignored(nullptr);
+        results[i] = lexers[i].lexBuffer(bounds[i], bounds[i + 1], bounds[i] - begin, tokens[i], ignored);
+    };
+    for (size_t i = 1; i < parts; i++)
+    {
+        workers.emplace_back(lexPart, i);
+    }
+    lexPart(0);
+    for (auto &worker : workers)
+    {
+        worker.join();
+    }
+
+    size_t count = output.size();
+    for (const auto &part : tokens)
+    {
+        count += part.size();
+    }
+    output.reserve(count);
+
+    // Stitch the parts in order. A part that cannot be lexed on its own ends inside a directive or has an error,
+    // the parts after it were lexed from a wrong state and the rest of the input is lexed again from its start.
+    for (size_t i = 0; i < parts; i++)
+    {
+        if (!results[i])
+        {
+            if (i > 0)
+            {
+                this->isInDirective = false;
+                this->isInBlock = false;
+            }
+            return this->lexBuffer(bounds[i], end, bounds[i] - begin, output, error);
+        }
+
+        const auto &names = lexers[i].Names();
+        auto ids = std::vector<uint32_t>(names.size());
+        for (size_t id = 0; id < ids.size(); id++)
+        {
+            ids[id] = this->names.Intern(names.Name(id));
+        }
+
+        for (const auto &token : tokens[i])
+        {
+            auto id = token.GetId() == Interner::None ? Interner::None : ids[token.GetId()];
+            output.push_back(Token(token.GetType(), token.GetContext(), token.GetValue(), id));
+        }
+        this->buffers.splice_after(this->buffers.before_begin(), lexers[i].buffers);
+    }
+
+    return true;
+}
+
+bool Lexer::lex(std::istream &input, TokenStream &output, std::ostream &error)
+{
+    const auto &buffer = this->read(input);
+    return this->lex(buffer.data(), buffer.data() + buffer.size(), output, error);
+}
+
+bool Lexer::lex(const char *begin, const char *end, TokenStream &output, std::ostream &error)
+{
+    if (output.size() == 0)
+    {
+        output.reset(begin, end);
+    }
+    return this->lexBuffer(begin, end, 0, output, error);
+}
+
+void Lexer::feed(const char *begin, const char *end, std::vector<Token> &output)
+{
+    // Tokens returned by the previous call are no longer referred to.
+    this->pending.erase(0, this->consumed);
+    this->offset += this->consumed;
+    this->consumed = 0;
+    this->buffers.clear();
+
+    // Only a '{' can start a directive, without one there is nothing new to commit.
+    auto hasBrace = scanner::Find(begin, end, '{') != end;
+    this->pending.append(begin, end);
+    if (!hasBrace)
+    {
+        return;
+    }
+
+    // Pending input always starts outside of a directive. Errors are reported by `finish`, as they may be caused by
+    // a token split across chunks.
+    const auto &lexed = this->lookahead.tokens;
+    auto last = this->lexAhead(this->pending.data(), this->pending.data() + this->pending.size(), this->offset);
+    if (last == 0)
+    {
+        return;
+    }
+
+    for (size_t i = 0; i < last; i++)
+    {
+        const auto &token = lexed[i];
+        auto type = token.GetType();
+        auto id = type == Token::Type::Symbol || type == Token::Type::Keyword
+                      ? this->names.Intern(token.GetValue())
+                      : Interner::None;
+        output.push_back(Token(type, token.GetContext(), token.GetValue(), id));
+    }
+    this->consumed = lexed[last].GetContext().StartPos() - this->offset;
+}
+
+bool Lexer::finish(std::vector<Token> &output, std::ostream &error)
+{
+    this->pending.erase(0, this->consumed);
+    this->offset += this->consumed;
+    this->buffers.clear();
+
+    auto result = this->lexBuffer(this->pending.data(), this->pending.data() + this->pending.size(), this->offset, output, error);
+    this->isInDirective = false;
+    this->isInBlock = false;
+
+    // The next call to `feed` starts a new input, the tokens returned by this call refer to the rest of the pending input.
+    this->offset = -static_cast<long>(this->pending.size());
+    this->consumed = this->pending.size();
+
+    return result;
+}
+
+size_t Lexer::lexAhead(const char *begin, const char *end, long offset)
+{
+    // The input is lexed as if it were complete, only the tokens before the last StartDirective are final:
+    // a text run ends at a StartDirective and the directives before it are closed.
+    std::ostream ignored(nullptr);
+    auto &lexed = this->lookahead.tokens;
+    lexed.clear();
+    this->lexBuffer(begin, end, offset, this->lookahead, ignored);
+    this->isInDirective = false;
+    this->isInBlock = false;
+
+    // Right after an EndDirective, a StartDirective may start one character before its "{{", lexing cannot resume there.
+    auto isResumable = [&](const Token &token) {
+        if (token.GetType() != Token::Type::StartDirective)
+        {
+            return false;
+        }
+        auto start = begin + (token.GetContext().StartPos() - offset);
+        return start[0] == '{' && start[1] == '{';
+    };
+
+    auto last = lexed.size();
+    while (last > 0 && !isResumable(lexed[last - 1]))
+    {
+        last--;
+    }
+
+    return last > 1 ? last - 1 : 0;
+}
+
+bool BufferTokenSource::Pull(TokenStream &output, std::ostream &error)
+{
+    if (this->position == this->end)
+    {
+        return false;
+    }
+    if (output.size() == 0)
+    {
+        output.reset(this->begin, this->end);
+    }
+
+    auto offset = this->position - this->begin;
+    const auto &lexed = this->lexer.lookahead.tokens;
+    while (static_cast<size_t>(this->end - this->position) > this->window)
+    {
+        auto last = this->lexer.lexAhead(this->position, this->position + this->window, offset);
+        if (last == 0)
+        {
+            // A single token does not fit in the window.
+            this->window *= 2;
+            continue;
+        }
+
+        for (size_t i = 0; i < last; i++)
+        {
+            output.push_back(lexed[i]);
+        }
+        this->position = this->begin + lexed[last].GetContext().StartPos();
+        return true;
+    }
+
+    auto size = output.size();
+    this->hasError = !this->lexer.lexBuffer(this->position, this->end, offset, output, error);
+    this->position = this->end;
+    return output.size() != size;
+}
+
+template <typename Output>
+bool Lexer::lexBuffer(const char *begin, const char *end, long offset, Output &output, std::ostream &error)
+{
+    auto input = Cursor(begin, end, offset);
     char prev_c = ' ';
     char c;
 
     long textPos = -1;
-    std::string text;
-
-    input >> std::noskipws;
+    const char *text = begin;
+    size_t textSize = 0;
 
-    while (input >> c)
+    while (input.get(c))
     {
         if (this->isInDirective)
         {
             if (this->isInBlock)
             {
-                auto pos = input.tellg();
+                auto pos = input.tell();
                 // Token can be a Symbol or an EndDirective.
-                if (std::isspace(c))
+                if (isSpace(c))
                 {
-                    output.push_back(TokenFactory::newSymbol(text, Context(textPos, pos - 1L)));
+                    output.push_back(TokenFactory::newSymbol(string_view(text, textSize), Context(textPos, pos - 1L),
+                                                             this->intern(output, string_view(text, textSize))));
                     textPos = -1;
-                    text = "";
-                    input >> std::ws;
+                    textSize = 0;
+                    input.skipWhitespace();
                 }
                 else if (c == '}' && prev_c == '}')
                 {
@@ -132,11 +653,11 @@ bool Lexer::lex(std::istream &input, std::vector<Token> &output, std::ostream &e
                     // Consume a single newline after EndDirective, do not consume spaces.
                     if (input.peek() == '\r')
                     {
-                        input.ignore(1);
+                        input.ignore();
                     }
                     if (input.peek() == '\n')
                     {
-                        input.ignore(1);
+                        input.ignore();
                     }
 
                     this->isInBlock = false;
@@ -144,11 +665,12 @@ bool Lexer::lex(std::istream &input, std::vector<Token> &output, std::ostream &e
                 }
                 else if (c == '}' && input.peek() == '}')
                 {
-                    if (text.size() != 0)
+                    if (textSize != 0)
                     {
-                        output.push_back(TokenFactory::newSymbol(text, Context(textPos, textPos + text.size())));
+                        output.push_back(TokenFactory::newSymbol(string_view(text, textSize), Context(textPos, textPos + textSize),
+                                                                 this->intern(output, string_view(text, textSize))));
                         textPos = -1;
-                        text = "";
+                        textSize = 0;
                     }
 
                     prev_c = c;
@@ -160,12 +682,17 @@ bool Lexer::lex(std::istream &input, std::vector<Token> &output, std::ostream &e
                     {
                         textPos = pos - 1L;
                     }
-                    text += c;
+                    if (textSize == 0)
+                    {
+                        text = input.current() - 1;
+                    }
+                    textSize++;
                 }
             }
             else
             {
-                auto pos = input.tellg();
+                auto symbolStart = input.current() - 1;
+                auto pos = input.tell();
                 auto ctx = Context(pos - 1L, pos);
                 auto isSymbol = false;
 
@@ -182,8 +709,8 @@ bool Lexer::lex(std::istream &input, std::vector<Token> &output, std::ostream &e
                     if (input.peek() == '}')
                     {
                         // End directive.
-                        input >> c;
-                        pos = input.tellg();
+                        input.get(c);
+                        pos = input.tell();
                         this->isInBlock = false;
                         this->isInDirective = false;
                         output.push_back(TokenFactory::newEndDirective(Context(pos - 2L, pos)));
@@ -197,44 +724,56 @@ bool Lexer::lex(std::istream &input, std::vector<Token> &output, std::ostream &e
                 }
 
                 // Token can be a keyword.
-                input >> std::ws;
-                pos = input.tellg();
-                auto identifier = this->readIdentifier(input);
+                input.skipWhitespace();
+                pos = input.tell();
+                size_t identifierSize;
+                auto identifier = readIdentifier(input, identifierSize);
 
-                if (isSymbol)
+                if (!isSymbol && identifierSize == 0)
                 {
-                    identifier = c + identifier;
+                    error << "Expected keyword at " << ctx << "." << std::endl;
+                    return false;
                 }
 
-                if (identifier.size() == 0)
+                auto value = string_view(identifier, identifierSize);
+                if (isSymbol)
                 {
-                    error << "Expected keyword at " << ctx << "." << std::endl;
-                    return false;
+                    if (identifier == symbolStart + 1)
+                    {
+                        value = string_view(symbolStart, identifierSize + 1);
+                    }
+                    else
+                    {
+                        // Whitespace between the first character and the rest of the symbol is dropped.
+                        this->buffers.emplace_front(c + std::string(identifier, identifierSize));
+                        value = this->buffers.front();
+                    }
                 }
 
+                auto id = this->intern(output, value);
                 output.push_back(isSymbol
-                                     ? TokenFactory::newSymbol(identifier, Context(pos - 1L, input.tellg()))
-                                     : TokenFactory::newKeyword(identifier, Context(pos, input.tellg())));
-                input >> std::ws;
+                                     ? TokenFactory::newSymbol(value, Context(pos - 1L, input.tell()), id)
+                                     : TokenFactory::newKeyword(value, Context(pos, input.tell()), id));
+                input.skipWhitespace();
                 this->isInBlock = !isSymbol;
             }
         }
         else
         {
-            auto pos = input.tellg();
+            auto pos = input.tell();
             // Token can be either a Text or a StartDirective.
             if (c == '{' && prev_c == '{')
             {
-                if (text.size() != 0)
+                if (textSize != 0)
                 {
-                    output.push_back(TokenFactory::newText(text, Context(textPos, pos - 2L)));
+                    output.push_back(TokenFactory::newText(string_view(text, textSize), Context(textPos, pos - 2L)));
                     textPos = -1;
-                    text = "";
+                    textSize = 0;
                 }
 
                 output.push_back(TokenFactory::newStartDirective(Context(pos - 2L, pos)));
                 this->isInDirective = true;
-                input >> std::ws;
+                input.skipWhitespace();
             }
             else if (c == '{' && input.peek() == '{')
             {
@@ -247,18 +786,29 @@ bool Lexer::lex(std::istream &input, std::vector<Token> &output, std::ostream &e
                 {
                     textPos = pos - 1L;
                 }
-                text += c;
+                if (textSize == 0)
+                {
+                    text = input.current() - 1;
+                }
+                textSize++;
+
+                // Nothing but a '{' can end a text run, take everything before the next one at once.
+                auto next = scanner::Find(input.current(), input.last(), '{');
+                if (next != input.current())
+                {
+                    textSize += next - input.current();
+                    c = *(next - 1);
+                    input.skipTo(next);
+                }
             }
         }
 
         prev_c = c;
     }
 
-    if (text.size() != 0)
+    if (textSize != 0)
     {
-        output.push_back(TokenFactory::newText(text, Context(textPos, textPos + text.size())));
-        textPos = -1;
-        text = "";
+        output.push_back(TokenFactory::newText(string_view(text, textSize), Context(textPos, textPos + textSize)));
     }
 
     if (this->isInBlock)
@@ -1,5 +1,4 @@
 #include <ostream>
-#include <memory>
 #include <functional>
 #include <algorithm>
 #include <string>
@@ -14,78 +13,313 @@ namespace car
 namespace parser
 {
 
-static bool parseExact(std::vector<lexer::Token>::const_iterator &begin, const std::vector<lexer::Token>::const_iterator &end,
-                       std::ostream &error, const lexer::Token::Type type, const std::string &value = "")
+void Ast::AddText(string_view text, Context ctx)
 {
-    if (begin == end)
+    this->add(NodeData::Type::Text, Interner::None, Interner::None, ctx, text);
+}
+
+void Ast::AddPrint(string_view symbol, Context ctx)
+{
+    this->add(NodeData::Type::Print, this->names.Intern(symbol), Interner::None, ctx);
+}
+
+void Ast::OpenLoop(string_view rangeSymbol, string_view elementSymbol)
+{
+    auto range = this->names.Intern(rangeSymbol);
+    this->open(NodeData::Type::Loop, range, this->names.Intern(elementSymbol));
+}
+
+void Ast::OpenIfEq(string_view leftSymbol, string_view rightSymbol)
+{
+    auto left = this->names.Intern(leftSymbol);
+    this->open(NodeData::Type::IfEq, left, this->names.Intern(rightSymbol));
+}
+
+void Ast::OpenBlock(const BlockType &type, string_view first, string_view second)
+{
+    const string_view symbols[2] = {first, second};
+    uint32_t ids[2] = {Interner::None, Interner::None};
+    for (auto i = 0; i < type.symbols; i++)
+    {
+        ids[i] = this->names.Intern(symbols[i]);
+    }
+
+    this->open(NodeData::Type::Block, ids[0], ids[1]);
+    this->setBlockType(type);
+}
+
+void Ast::Close(Context ctx)
+{
+    // Children move to the arena together, after the children of the blocks they contain.
+    auto begin = this->opened.back();
+    auto &block = this->pending[begin - 1];
+    this->close(block);
+
+    block.first = static_cast<uint32_t>(this->nodes.size());
+    block.count = static_cast<uint32_t>(this->pending.size() - begin);
+    block.ctx = ctx;
+
+    this->nodes.insert(this->nodes.end(), this->pending.begin() + begin, this->pending.end());
+    this->pending.erase(this->pending.begin() + begin, this->pending.end());
+}
+
+void Ast::Discard()
+{
+    // Children of the blocks closed inside it stay in the arena, no node refers to them.
+    auto begin = this->opened.back();
+    this->close(this->pending[begin - 1]);
+    this->pending.erase(this->pending.begin() + begin - 1, this->pending.end());
+}
+
+void Ast::AppendText(string_view text, Context ctx)
+{
+    auto &last = this->pending.back();
+    last.ctx = Context(last.ctx.StartPos(), ctx.EndPos());
+    if (last.text + last.count == text.data())
+    {
+        last.count += static_cast<uint32_t>(text.size());
+        return;
+    }
+
+    // Text is appended in place to a copy that only this node refers to.
+    const auto isOwned = !this->texts.empty() && this->texts.back().use_count() == 1 &&
+                         this->texts.back()->data() == last.text && this->texts.back()->size() == last.count;
+    if (!isOwned)
+    {
+        this->texts.push_back(std::make_shared<std::string>(last.text, last.count));
+    }
+
+    auto &owned = *this->texts.back();
+    owned.append(text.data(), text.size());
+    last.text = owned.data();
+    last.count = static_cast<uint32_t>(owned.size());
+}
+
+void Ast::CopyText(string_view text, Context ctx)
+{
+    this->texts.push_back(std::make_shared<std::string>(text.data(), text.size()));
+    this->AddText(*this->texts.back(), ctx);
+}
+
+void Ast::Retain(const Ast &other)
+{
+    this->texts.insert(this->texts.end(), other.texts.begin(), other.texts.end());
+}
+
+void Ast::clear()
+{
+    this->clearNodes();
+    this->names.Truncate(Interner::Keywords);
+}
+
+void Ast::clearNodes()
+{
+    this->nodes.clear();
+    this->pending.clear();
+    this->opened.clear();
+    this->bindings.clear();
+    this->shadowed.clear();
+    this->texts.clear();
+}
+
+size_t Ast::MemoryUsage() const
+{
+    auto size = sizeof(*this) + (this->nodes.capacity() + this->pending.capacity()) * sizeof(NodeData) +
+                this->opened.capacity() * sizeof(size_t) + (this->bindings.capacity() + this->shadowed.capacity()) * sizeof(uint32_t) +
+                this->texts.capacity() * sizeof(std::shared_ptr<std::string>);
+    for (const auto &text : this->texts)
+    {
+        size += text->capacity();
+    }
+    return size;
+}
+
+void Ast::add(NodeData::Type type, uint32_t first, uint32_t second, Context ctx, string_view text)
+{
+    auto size = static_cast<uint32_t>(text.size());
+    this->pending.push_back(NodeData{type, true, {first, second}, 0, size, ctx, text.data()});
+    if (type == NodeData::Type::Print)
+    {
+        this->use(first);
+    }
+}
+
+void Ast::open(NodeData::Type type, uint32_t first, uint32_t second)
+{
+    // The context is known once the block is closed.
+    this->add(type, first, second, Context(0, 0));
+
+    // The range of a loop is not a symbol, its element is looked up to check that it is not defined yet.
+    if (type != NodeData::Type::Loop)
+    {
+        this->use(first);
+    }
+    this->use(second);
+    this->opened.push_back(this->pending.size());
+
+    if (type == NodeData::Type::Loop)
     {
-        error << "Unexpected EOF after " << *(begin - 1) << std::endl;
+        if (second >= this->bindings.size())
+        {
+            this->bindings.resize(second + 1, 0);
+        }
+        this->shadowed.push_back(this->bindings[second]);
+        this->bindings[second] = static_cast<uint32_t>(this->opened.size());
+    }
+}
+
+void Ast::setBlockType(const BlockType &type)
+{
+    this->pending[this->opened.back() - 1].block = &type;
+
+    // A render hook may write different output each time it is called.
+    if (type.render != nullptr)
+    {
+        this->useAll();
+    }
+}
+
+void Ast::close(const NodeData &block)
+{
+    if (block.type == NodeData::Type::Loop)
+    {
+        this->bindings[block.symbols[1]] = this->shadowed.back();
+        this->shadowed.pop_back();
+    }
+    this->opened.pop_back();
+}
+
+void Ast::use(uint32_t id)
+{
+    if (id >= this->bindings.size() || this->bindings[id] == 0)
+    {
+        return;
+    }
+
+    // The child of the loop that contains the node is the next open block or the node itself.
+    const auto depth = this->bindings[id];
+    auto &child = depth < this->opened.size() ? this->pending[this->opened[depth] - 1] : this->pending.back();
+    child.isInvariant = false;
+}
+
+void Ast::useAll()
+{
+    // The node is the innermost open block, each open block is a child of the one before.
+    this->pending[this->opened.back() - 1].isInvariant = false;
+    for (size_t depth = 1; depth < this->opened.size(); depth++)
+    {
+        this->pending[this->opened[depth] - 1].isInvariant = false;
+    }
+}
+
+bool TokenReader::AtEnd(size_t index)
+{
+    while (index - this->base >= this->tokens->size())
+    {
+        if (this->source == nullptr)
+        {
+            return true;
+        }
+
+        // The parser looks back only a few tokens from the one it has reached.
+        if (this->window->size() > windowSize)
+        {
+            auto count = this->window->size() - lookBehind;
+            this->window->erase_front(count);
+            this->base += count;
+        }
+
+        if (!this->source->Pull(*this->window, *this->error))
+        {
+            this->source = nullptr;
+        }
+    }
+
+    return false;
+}
+
+bool Parser::atEnd(TokenReader &tokens, size_t index, ParseContext &context)
+{
+    auto result = tokens.AtEnd(index);
+
+    // Symbols are checked by their ids, names are interned as tokens are read.
+    const auto &names = tokens.Names();
+    for (auto id = context.defined.size(); id < names.size(); id++)
+    {
+        context.defined.push_back(this->options.Symbols().count(names.Name(id)) > 0);
+    }
+
+    return result;
+}
+
+bool Parser::parseExact(TokenReader &tokens, size_t &begin, ParseContext &context,
+                        std::ostream &error, const lexer::Token::Type type, const uint32_t id)
+{
+    if (this->atEnd(tokens, begin, context))
+    {
+        error << "Unexpected EOF after " << tokens[begin - 1] << std::endl;
         return false;
     }
 
-    if (begin->GetType() == type && begin->GetValue() == value)
+    if (tokens.GetType(begin) == type && tokens.GetId(begin) == id &&
+        (id != Interner::None || tokens[begin].GetValue().size() == 0))
     {
         begin++;
         return true;
     }
 
     error << "Expected " << type;
-    if (value.length() > 0)
+    if (id != Interner::None)
     {
-        error << " `" << value << "`";
+        error << " `" << tokens.Names().Name(id) << "`";
     }
-    error << " instead of " << *begin << std::endl;
+    error << " instead of " << tokens[begin] << std::endl;
     return false;
 }
 
-std::vector<std::string>
-Parser::parseSymbols(std::vector<lexer::Token>::const_iterator &begin,
-                     const std::vector<lexer::Token>::const_iterator end,
-                     int count,
-                     bool checkAllSymbols,
-                     std::vector<std::string> &declared,
-                     std::ostream &error)
+bool Parser::parseSymbols(TokenReader &tokens,
+                          size_t &begin,
+                          int count,
+                          bool checkAllSymbols,
+                          ParseContext &context,
+                          std::ostream &error)
 {
-    auto symbols = std::vector<std::string>();
-    symbols.reserve(count);
     int seen = 0;
-    for (auto &it = begin; it != end && seen < count; it++)
+    for (auto &it = begin; !this->atEnd(tokens, it, context) && seen < count; it++)
     {
-        switch (it->GetType())
+        switch (tokens.GetType(it))
         {
         case Type::Symbol:
         {
-            const auto &symbol = it->GetValue();
+            const auto symbol = tokens.GetId(it);
             // If checkAllSymbols is true, all symbols need to be declared.
             if (checkAllSymbols || seen == 0)
             {
                 // Only first symbol is checked, subsequent symbols are interpreted as declarations.
-                if (this->options.SymbolChecksEnabled() &&
-                    this->options.Symbols().find(symbol) == this->options.Symbols().end())
+                if (this->options.SymbolChecksEnabled() && !context.defined[symbol])
                 {
-                    error << "Invalid symbol " << *it << std::endl;
+                    error << "Invalid symbol " << tokens[it] << std::endl;
                     goto fail;
                 }
             }
             else
             {
                 // If symbol is not defined, add it. It is an error to define same symbol more than once in a file.
-                if (this->options.SymbolChecksEnabled() &&
-                    this->options.Symbols().find(symbol) != this->options.Symbols().end())
+                if (this->options.SymbolChecksEnabled() && context.defined[symbol])
                 {
-                    error << "Symbol already defined: " << *it << std::endl;
+                    error << "Symbol already defined: " << tokens[it] << std::endl;
                     goto fail;
                 }
 
-                declared.push_back(symbol);
+                context.declared.push_back(symbol);
             }
 
-            symbols.push_back(symbol);
+            context.symbols.push_back(symbol);
             seen++;
             break;
         }
         default:
-            error << "Expected symbol instead of " << *it << std::endl;
+            error << "Expected symbol instead of " << tokens[it] << std::endl;
             goto fail;
         }
     }
@@ -97,207 +331,269 @@ Parser::parseSymbols(std::vector<lexer::Token>::const_iterator &begin,
     }
 
     // Next symbol must be an EndDirective.
-    if (!parseExact(begin, end, error, Type::EndDirective))
+    if (!this->parseExact(tokens, begin, context, error, Type::EndDirective))
     {
         goto fail;
     }
 
-    return symbols;
+    return true;
 
 fail:
-    return {};
+    return false;
 }
 
-template <typename NodeType, bool checkAllSymbols>
-std::vector<std::unique_ptr<Node>>
-Parser::parseBlockWithTwoSymbols(std::vector<lexer::Token>::const_iterator &begin,
-                                 const std::vector<lexer::Token>::const_iterator end,
-                                 std::ostream &error,
-                                 const std::string &keyword)
+bool Parser::parseBlockWithSymbols(TokenReader &tokens,
+                                   size_t &begin,
+                                   ParseContext &context,
+                                   std::ostream &error,
+                                   const uint32_t keyword,
+                                   const NodeData::Type type,
+                                   const int count,
+                                   const bool checkAllSymbols)
 {
-    // {{#keyword symbol1 symbol2}} ... {{/keyword}}
-    std::vector<std::shared_ptr<Node>> children;
-    auto const initial = begin;
-
-    auto declared = std::vector<std::string>();
-    auto symbols = this->parseSymbols(begin, end, 2, checkAllSymbols, declared, error);
-    if (symbols.size() != 2)
+    // {{#keyword symbol...}}, children and {{/keyword}} are parsed by parseNodes and closeBlock.
+    // The StartDirective is before StartBlock and the keyword.
+    const auto directive = tokens[begin - 3];
+    auto const start = this->atEnd(tokens, begin, context) ? 0 : tokens[begin].GetContext().StartPos();
+    auto const declared = context.declared.size();
+
+    context.symbols.clear();
+    if (!this->parseSymbols(tokens, begin, count, checkAllSymbols, context, error))
     {
-        goto fail;
-    }
-    if (!checkAllSymbols)
-    {
-        this->options.Symbols().insert(declared.begin(), declared.end());
-    }
+        for (auto it = declared; it < context.declared.size(); it++)
+        {
+            context.defined[context.declared[it]] = false;
+        }
+        context.declared.resize(declared);
 
-    // Parse children.
-    for (auto &n : this->parseNodes(begin, end, error))
-    {
-        children.push_back(std::move(n));
+        return false;
     }
 
-    if (children.size() == 0)
+    for (auto it = declared; it < context.declared.size(); it++)
     {
-        error << keyword << " node must have children." << std::endl;
-        goto fail;
+        context.defined[context.declared[it]] = true;
     }
 
-    // Parse StartDirective EndBlock Keyword EndDirective.
-    if (!parseExact(begin, end, error, Type::StartDirective))
-    {
-        goto fail;
-    }
+    // Children are added to the block until it is closed.
+    context.symbols.resize(2, Interner::None);
+    context.output->open(type, context.symbols[0], context.symbols[1]);
+    context.frames.push_back(ParseContext::Frame{keyword, start, declared, directive});
+
+    return true;
+}
+
+bool Parser::parseIfEq(TokenReader &tokens,
+                       size_t &begin,
+                       ParseContext &context,
+                       std::ostream &error)
+{
+    // {{#ifeq symbol symbol}} ... {{/ifeq}}
+    return this->parseBlockWithSymbols(tokens, begin, context, error, Interner::IfEq, NodeData::Type::IfEq, 2, true);
+}
+
+bool Parser::parseLoop(TokenReader &tokens,
+                       size_t &begin,
+                       ParseContext &context,
+                       std::ostream &error)
+{
+    // {{#loop range element}} ... {{/loop}}
+    return this->parseBlockWithSymbols(tokens, begin, context, error, Interner::Loop, NodeData::Type::Loop, 2, false);
+}
 
-    if (!parseExact(begin, end, error, Type::EndBlock))
+bool Parser::parseRegisteredBlock(TokenReader &tokens,
+                                  size_t &begin,
+                                  ParseContext &context,
+                                  std::ostream &error,
+                                  const uint32_t keyword,
+                                  const BlockType &type)
+{
+    // {{#keyword symbol...}} ... {{/keyword}}, all symbols must be defined.
+    if (!this->parseBlockWithSymbols(tokens, begin, context, error, keyword, NodeData::Type::Block, type.symbols, true))
     {
-        goto fail;
+        return false;
     }
 
-    if (!parseExact(begin, end, error, Type::Keyword, keyword))
+    context.output->setBlockType(type);
+
+    return true;
+}
+
+Parser::nodeParser Parser::keywordParser(uint32_t keyword)
+{
+    switch (keyword)
     {
-        goto fail;
+    case Interner::Loop:
+        return &Parser::parseLoop;
+    case Interner::IfEq:
+        return &Parser::parseIfEq;
+    default:
+        return nullptr;
     }
+}
+
+bool Parser::parseBlock(TokenReader &tokens,
+                        size_t &begin,
+                        ParseContext &context,
+                        std::ostream &error)
+{
+    // Parse the directive that opens a block.
 
-    if (!parseExact(begin, end, error, Type::EndDirective))
+    auto &it = begin;
+
+    if (this->atEnd(tokens, it, context))
     {
+        error << "Unexpected EOF after " << tokens[it - 1] << std::endl;
         goto fail;
     }
 
-    // Return NodeType.
+    // begin must be a Keyword.
+    if (tokens.GetType(it) == Type::Keyword)
     {
-        auto nodes = std::vector<std::unique_ptr<Node>>();
+        auto parser = keywordParser(tokens.GetId(it));
 
-        nodes.push_back(std::make_unique<NodeType>(
-            NodeType(
-                symbols[0],
-                symbols[1],
-                Context(initial->GetContext().StartPos(), (begin - 1)->GetContext().EndPos()),
-                children)));
-
-        if (!checkAllSymbols)
+        if (parser == nullptr)
         {
-            for (const auto &symbol : declared)
+            // Other keywords are looked up by name, built-in ones are dispatched on their id without hashing.
+            const auto *blocks = this->options.Blocks();
+            const auto *type = blocks == nullptr ? nullptr : blocks->Find(tokens.Names().Name(tokens.GetId(it)));
+            if (type != nullptr)
             {
-                this->options.Symbols().erase(symbol);
+                auto keyword = tokens.GetId(it);
+                it++;
+
+                return this->parseRegisteredBlock(tokens, it, context, error, keyword, *type);
             }
+
+            error << "Unsupported keyword `" << tokens[it].GetValue() << "` at " << tokens[it].GetContext() << std::endl;
+            goto fail;
         }
 
-        return nodes;
-    }
+        it++;
 
-fail:
-    if (!checkAllSymbols)
-    {
-        for (const auto &symbol : declared)
-        {
-            this->options.Symbols().erase(symbol);
-        }
+        return (this->*parser)(tokens, it, context, error); // LCOV_EXCL_LINE coverage not reported successfully on member function pointer.
     }
 
-    return {};
-}
+    error << "Expected Keyword instead of " << tokens[it] << std::endl;
 
-std::vector<std::unique_ptr<Node>>
-Parser::parseIfEq(std::vector<lexer::Token>::const_iterator &begin,
-                  const std::vector<lexer::Token>::const_iterator end,
-                  std::ostream &error)
-{
-    // {{#ifeq symbol symbol}} ... {{/ifeq}}
-    return parseBlockWithTwoSymbols<IfEqNode, true>(begin, end, error, "ifeq");
+fail:
+    return false;
 }
 
-std::vector<std::unique_ptr<Node>>
-Parser::parseLoop(std::vector<lexer::Token>::const_iterator &begin,
-                  const std::vector<lexer::Token>::const_iterator end,
-                  std::ostream &error)
+bool Parser::closeBlock(TokenReader &tokens,
+                        size_t &begin,
+                        ParseContext &context,
+                        std::ostream &error)
 {
-    // {{#loop range element}} ... {{/loop}}
-    return parseBlockWithTwoSymbols<LoopNode, false>(begin, end, error, "loop");
-}
+    // Parse StartDirective EndBlock Keyword EndDirective of the innermost open block.
+    const auto frame = context.frames.back();
+    auto result = false;
 
-std::vector<std::unique_ptr<Node>>
-Parser::parseBlock(std::vector<lexer::Token>::const_iterator &begin,
-                   const std::vector<lexer::Token>::const_iterator end,
-                   std::ostream &error)
-{
-    // Parse a single block including the corresponding EndBlock and EndDirective.
+    if (context.output->openChildren() == 0)
+    {
+        error << tokens.Names().Name(frame.keyword) << " node must have children." << std::endl;
+        goto done;
+    }
 
-    auto &it = begin;
+    if (!this->parseExact(tokens, begin, context, error, Type::StartDirective))
+    {
+        goto done;
+    }
 
-    // begin must be a Keyword.
-    if (it->GetType() == Type::Keyword)
+    if (!this->parseExact(tokens, begin, context, error, Type::EndBlock))
     {
-        auto keyword = it->GetValue();
-        auto pair = this->keywordParser.find(keyword);
+        goto done;
+    }
 
-        if (pair == this->keywordParser.end())
+    if (!this->parseExact(tokens, begin, context, error, Type::Keyword, frame.keyword))
+    {
+        goto done;
+    }
+
+    if (!this->parseExact(tokens, begin, context, error, Type::EndDirective))
+    {
+        goto done;
+    }
+
+    context.output->Close(Context(frame.start, tokens[begin - 1].GetContext().EndPos()));
+
+    // A registered block is checked by its type once its children are known, it is the last pending node.
+    {
+        const auto &block = context.output->pending.back();
+        if (block.type == NodeData::Type::Block && block.block->parse != nullptr &&
+            !block.block->parse(BlockNode(*context.output, block), error))
         {
-            error << "Unsupported keyword `" << keyword << "` at " << it->GetContext() << std::endl;
-            goto fail;
+            goto done;
         }
+    }
 
-        it++;
-        auto parser = pair->second;
+    result = true;
 
-        return (this->*parser)(it, end, error); // LCOV_EXCL_LINE coverage not reported successfully on member function pointer.
+done:
+    if (!result)
+    {
+        context.failure = context.frames.front().directive;
     }
 
-    error << "Expected Keyword instead of " << *it << std::endl;
+    for (auto it = frame.declared; it < context.declared.size(); it++)
+    {
+        context.defined[context.declared[it]] = false;
+    }
+    context.declared.resize(frame.declared);
+    context.frames.pop_back();
 
-fail:
-    return {};
+    return result;
 }
 
-std::vector<std::unique_ptr<Node>>
-Parser::parseNodes(std::vector<lexer::Token>::const_iterator &begin,
-                   const std::vector<lexer::Token>::const_iterator end,
-                   std::ostream &error)
+bool Parser::parseNodes(TokenReader &tokens,
+                        size_t &begin,
+                        ParseContext &context,
+                        std::ostream &error)
 {
-    auto nodes = std::vector<std::unique_ptr<Node>>();
+    // Blocks are parsed on the stack of open blocks in the context instead of recursively, so nesting is unlimited.
+    auto &output = *context.output;
+    auto &frames = context.frames;
 
-    for (auto &it = begin; it != end; it++)
+    for (auto &it = begin; !this->atEnd(tokens, it, context); it++)
     {
-        switch (it->GetType())
+        switch (tokens.GetType(it))
         {
         case Type::StartDirective:
         {
             // PrintNode, LoopNode or other directive/block node.
             auto next = it + 1;
-            if (next == end)
+            if (this->atEnd(tokens, next, context))
             {
-                error << "Unexpected EOF after " << *it << std::endl;
+                error << "Unexpected EOF after " << tokens[it] << std::endl;
                 goto fail;
             }
 
-            switch (next->GetType())
+            switch (tokens.GetType(next))
             {
             case Type::Symbol:
             {
                 // Symbol after directive without a block start/end is a PrintNode.
                 auto nextNext = next + 1;
-                if (nextNext == end)
+                if (this->atEnd(tokens, nextNext, context))
                 {
-                    error << "Unexpected EOF after " << *next << std::endl;
+                    error << "Unexpected EOF after " << tokens[next] << std::endl;
                     goto fail;
                 }
 
-                if (nextNext->GetType() != Type::EndDirective)
+                if (tokens.GetType(nextNext) != Type::EndDirective)
                 {
-                    error << "Expected EndDirective after " << *next << std::endl;
+                    error << "Expected EndDirective after " << tokens[next] << std::endl;
                     goto fail;
                 }
 
-                const auto &symbol = next->GetValue();
-                if (this->options.SymbolChecksEnabled() &&
-                    this->options.Symbols().find(symbol) == this->options.Symbols().end())
+                const auto symbol = tokens.GetId(next);
+                if (this->options.SymbolChecksEnabled() && !context.defined[symbol])
                 {
-                    error << "Invalid symbol " << *next << std::endl;
+                    error << "Invalid symbol " << tokens[next] << std::endl;
                     goto fail;
                 }
 
-                nodes.push_back(std::make_unique<PrintNode>(
-                    PrintNode(symbol,
-                              Context(it->GetContext().StartPos(), nextNext->GetContext().EndPos()))));
+                output.add(NodeData::Type::Print, symbol, Interner::None,
+                           Context(tokens[it].GetContext().StartPos(), tokens[nextNext].GetContext().EndPos()));
 
                 // We have already consumed the next two tokens.
                 it = nextNext;
@@ -306,67 +602,158 @@ Parser::parseNodes(std::vector<lexer::Token>::const_iterator &begin,
             case Type::StartBlock:
             {
                 auto nextNext = next + 1;
-                auto blockNodes = this->parseBlock(nextNext, end, error);
-                if (blockNodes.size() == 0)
+                if (!this->parseBlock(tokens, nextNext, context, error))
                 {
                     goto fail;
                 }
-                nodes.reserve(nodes.size() + blockNodes.size());
-                nodes.insert(nodes.end(),
-                             std::make_move_iterator(blockNodes.begin()),
-                             std::make_move_iterator(blockNodes.end()));
 
                 it = nextNext - 1;
                 continue;
             }
             case Type::EndBlock:
             {
-                // EndBlock cannot be parsed in this method, parseBlock will handle it.
-                return nodes;
+                // EndBlock closes the innermost open block, a caller handles it at the top level.
+                if (frames.empty())
+                {
+                    return true;
+                }
+
+                auto end = it;
+                if (!this->closeBlock(tokens, end, context, error))
+                {
+                    goto unwind;
+                }
+
+                it = end - 1;
+                continue;
             }
             default:
             {
-                error << "Text or StartDirective expected instead of " << *it << std::endl;
+                error << "Text or StartDirective expected instead of " << tokens[it] << std::endl;
                 goto fail;
             }
             }
             continue;
         }
         case Type::Text:
+        {
             // TextNode.
-            nodes.push_back(std::make_unique<TextNode>(TextNode(it->GetValue(), it->GetContext())));
+            const auto token = tokens[it];
+            output.add(NodeData::Type::Text, Interner::None, Interner::None, token.GetContext(), token.GetValue());
             continue;
+        }
         default:
         {
-            // Return without error. If parsing is not complete, it will be handled by a caller.
-            // If the caller is Parser::parse, it will return an error in case of incomplete parse.
-            return nodes;
+            // Return without error at the top level. If parsing is not complete, Parser::parse will return an error.
+            if (frames.empty())
+            {
+                return true;
+            }
+
+            // An open block must be closed here, which reports the error.
+            auto end = it;
+            if (!this->closeBlock(tokens, end, context, error))
+            {
+                goto unwind;
+            }
+
+            it = end - 1;
+            continue;
+        }
         }
+    }
+
+    // Blocks that are still open are not closed before EOF.
+    while (!frames.empty())
+    {
+        if (!this->closeBlock(tokens, begin, context, error))
+        {
+            goto unwind;
         }
     }
 
-    return nodes;
+    return true;
 
 fail:
-    return {};
+    // Errors are reported at the directive that starts the outermost block.
+    context.failure = frames.empty() ? tokens[begin] : frames.front().directive;
+
+unwind:
+    // Each enclosing block reports that its children failed to parse as missing children.
+    while (!frames.empty())
+    {
+        const auto &frame = frames.back();
+        error << tokens.Names().Name(frame.keyword) << " node must have children." << std::endl;
+        for (auto it = frame.declared; it < context.declared.size(); it++)
+        {
+            context.defined[context.declared[it]] = false;
+        }
+        context.declared.resize(frame.declared);
+        frames.pop_back();
+    }
+
+    return false;
 }
 
 bool Parser::parse(const std::vector<lexer::Token> &tokens,
-                   std::vector<std::unique_ptr<Node>> &output,
+                   Ast &output,
+                   std::ostream &error)
+{
+    auto stream = lexer::TokenStream();
+    for (const auto &token : tokens)
+    {
+        stream.push_back(token);
+    }
+
+    return this->parse(stream, output, error);
+}
+
+bool Parser::parse(const lexer::TokenStream &tokens,
+                   Ast &output,
+                   std::ostream &error)
+{
+    auto reader = TokenReader(tokens);
+    return this->parse(reader, output, error);
+}
+
+bool Parser::parse(lexer::TokenSource &source,
+                   Ast &output,
                    std::ostream &error)
 {
-    auto begin = tokens.begin();
-    auto end = tokens.end();
-    auto nodes = parseNodes(begin, end, error);
-    if (begin != end)
+    auto window = lexer::TokenStream();
+    auto reader = TokenReader(source, window, error);
+    return this->parse(reader, output, error);
+}
+
+bool Parser::parse(TokenReader &tokens,
+                   Ast &output,
+                   std::ostream &error)
+{
+    auto &context = this->context;
+    context.output = &output;
+    context.declared.clear();
+    context.defined.clear();
+    context.frames.clear();
+    output.clearNodes();
+
+    size_t begin = 0;
+    if (!this->parseNodes(tokens, begin, context, error))
+    {
+        // Nodes of the blocks that failed are discarded with the rest.
+        error << "Cannot parse at " << context.failure << std::endl;
+        output.clear();
+        return false;
+    }
+
+    if (!this->atEnd(tokens, begin, context))
     {
-        error << "Cannot parse at " << *begin << std::endl;
+        error << "Cannot parse at " << tokens[begin] << std::endl;
+        output.clear();
         return false;
     }
 
-    output.insert(output.end(),
-                  std::make_move_iterator(nodes.begin()),
-                  std::make_move_iterator(nodes.end()));
+    // Symbol ids of the nodes refer to the names of the tokens.
+    output.names.Assign(tokens.Names());
 
     return true;
 }
@@ -374,4 +761,4 @@ bool Parser::parse(const std::vector<lexer::Token> &tokens,
 } // namespace parser
 // LCOV_EXCL_START
 } // namespace car
-  // LCOV_EXCL_STOP
\ No newline at end of file
+  // LCOV_EXCL_STOP
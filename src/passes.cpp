@@ -0,0 +1,435 @@
+#include "passes.hpp"
+
+using car::parser::BlockNode;
+using car::parser::NodeData;
+
+namespace car
+{
+namespace passes
+{
+
+size_t Rewriter::Run(const parser::Ast &input, parser::Ast &output)
+{
+    this->input = &input;
+    this->frames.clear();
+    this->siblings.clear();
+    this->elements.clear();
+    output.Retain(input);
+
+    const auto &names = input.Names();
+    auto name = [&](const NodeData &node, size_t index) {
+        return node.symbols[index] == Interner::None ? string_view() : string_view(names.Name(node.symbols[index]));
+    };
+
+    size_t changes = 0;
+    this->frames.push_back(Frame{input.begin(), input.begin(), input.end(), nullptr, false, nullptr, 0});
+    this->siblings.push_back(Siblings{0, false});
+    while (!this->frames.empty())
+    {
+        const auto depth = this->frames.size();
+        auto &frame = this->frames.back();
+
+        while (frame.next != frame.end)
+        {
+            const auto &node = (*frame.next).Data();
+            ++frame.next;
+
+            const auto action = this->rewrite(node);
+            if (action == Action::Remove)
+            {
+                changes++;
+                continue;
+            }
+
+            auto &list = this->siblings.back();
+            if (action == Action::Inline || action == Action::Unroll)
+            {
+                // The children are added to the list of the block.
+                changes++;
+                const auto children = BlockNode(input, node).Children();
+                const auto *range = action == Action::Unroll ? &this->range(node) : nullptr;
+                if (range != nullptr)
+                {
+                    this->elements.push_back(Element{node.symbols[1], &(*range)[0]});
+                }
+                this->frames.push_back(Frame{children.begin(), children.begin(), children.end(), &node, true, range, 0});
+                break;
+            }
+
+            if (action == Action::Evaluate)
+            {
+                changes++;
+                output.CopyText(this->value(node), node.ctx);
+                list.count++;
+                list.isLastText = true;
+                continue;
+            }
+
+            switch (node.type)
+            {
+            case NodeData::Type::Text:
+            {
+                const auto text = string_view(node.text, node.count);
+                if (list.isLastText && this->merge())
+                {
+                    output.AppendText(text, node.ctx);
+                    changes++;
+                    continue;
+                }
+                output.AddText(text, node.ctx);
+                list.count++;
+                list.isLastText = true;
+                continue;
+            }
+            case NodeData::Type::Print:
+                output.AddPrint(name(node, 0), node.ctx);
+                list.count++;
+                list.isLastText = false;
+                continue;
+            case NodeData::Type::Loop:
+                output.OpenLoop(name(node, 0), name(node, 1));
+                this->elements.push_back(Element{node.symbols[1], nullptr});
+                break;
+            case NodeData::Type::IfEq:
+                output.OpenIfEq(name(node, 0), name(node, 1));
+                break;
+            case NodeData::Type::Block:
+                output.OpenBlock(*node.block, name(node, 0), name(node, 1));
+                break;
+            }
+
+            // The block is counted in its list once it is closed.
+            const auto children = BlockNode(input, node).Children();
+            this->frames.push_back(Frame{children.begin(), children.begin(), children.end(), &node, false, nullptr, 0});
+            this->siblings.push_back(Siblings{0, false});
+            break;
+        }
+
+        if (this->frames.size() != depth)
+        {
+            continue;
+        }
+
+        if (frame.range != nullptr && ++frame.value < frame.range->size())
+        {
+            this->elements.back().value = &(*frame.range)[frame.value];
+            frame.next = frame.first;
+            continue;
+        }
+
+        const auto *block = frame.block;
+        const auto isInlined = frame.isInlined;
+        const auto isUnrolled = frame.range != nullptr;
+        this->frames.pop_back();
+        if (block != nullptr && block->type == NodeData::Type::Loop && (isUnrolled || !isInlined))
+        {
+            this->elements.pop_back();
+        }
+        if (block == nullptr || isInlined)
+        {
+            continue;
+        }
+
+        const auto count = this->siblings.back().count;
+        this->siblings.pop_back();
+        if (count == 0 && !this->keepEmpty(*block))
+        {
+            output.Discard();
+            changes++;
+            continue;
+        }
+
+        output.Close(block->ctx);
+        this->siblings.back().count++;
+        this->siblings.back().isLastText = false;
+    }
+
+    return changes;
+}
+
+Rewriter::Action Rewriter::rewrite(const NodeData &)
+{
+    return Action::Keep;
+}
+
+bool Rewriter::keepEmpty(const NodeData &)
+{
+    return true;
+}
+
+// LCOV_EXCL_START only rewriters that unroll and evaluate nodes override these.
+const std::vector<std::string> &Rewriter::range(const NodeData &)
+{
+    static const auto none = std::vector<std::string>(1);
+    return none;
+}
+
+const std::string &Rewriter::value(const NodeData &)
+{
+    static const auto none = std::string();
+    return none;
+}
+// LCOV_EXCL_STOP
+
+bool Rewriter::isDefined(uint32_t id) const
+{
+    return this->element(id) != nullptr || this->assumptions.symbols.count(this->input->Names().Name(id)) > 0;
+}
+
+const Rewriter::Element *Rewriter::element(uint32_t id) const
+{
+    for (auto it = this->elements.rbegin(); it != this->elements.rend(); ++it)
+    {
+        if (it->id == id)
+        {
+            return &*it;
+        }
+    }
+    return nullptr;
+}
+
+bool Rewriter::isUndefined(uint32_t id) const
+{
+    return this->assumptions.isExhaustive && !this->isDefined(id);
+}
+
+bool Rewriter::isRangeDefined(uint32_t id) const
+{
+    return this->assumptions.rangeSymbols.count(this->input->Names().Name(id)) > 0;
+}
+
+Rewriter::Action FoldIfEq::rewrite(const NodeData &node)
+{
+    // A symbol equals itself, rendering fails only if it is not defined.
+    if (node.type == NodeData::Type::IfEq && node.symbols[0] == node.symbols[1] && this->isDefined(node.symbols[0]))
+    {
+        return Action::Inline;
+    }
+    return Action::Keep;
+}
+
+Rewriter::Action RemoveEmpty::rewrite(const NodeData &node)
+{
+    return node.type == NodeData::Type::Text && node.count == 0 ? Action::Remove : Action::Keep;
+}
+
+bool RemoveEmpty::keepEmpty(const NodeData &block)
+{
+    switch (block.type)
+    {
+    case NodeData::Type::Loop:
+        // Rendering a loop fails if its range is not defined or its element is.
+        return !this->isRangeDefined(block.symbols[0]) || !this->isUndefined(block.symbols[1]);
+    case NodeData::Type::IfEq:
+        return !this->isDefined(block.symbols[0]) || !this->isDefined(block.symbols[1]);
+    case NodeData::Type::Block:
+    {
+        // A render hook may write output or fail without children.
+        if (block.block->render != nullptr)
+        {
+            return true;
+        }
+        for (auto i = 0; i < block.block->symbols; i++)
+        {
+            if (!this->isDefined(block.symbols[i]))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+    default:
+        return true; // LCOV_EXCL_LINE only blocks have children.
+    }
+}
+
+Rewriter::Action Specializer::rewrite(const NodeData &node)
+{
+    const auto &names = this->input->Names();
+    switch (node.type)
+    {
+    case NodeData::Type::Print:
+        return this->lookup(node.symbols[0]) != nullptr ? Action::Evaluate : Action::Keep;
+    case NodeData::Type::IfEq:
+    {
+        const auto *left = this->lookup(node.symbols[0]);
+        const auto *right = this->lookup(node.symbols[1]);
+        if (left == nullptr || right == nullptr)
+        {
+            return Action::Keep;
+        }
+        return *left == *right ? Action::Inline : Action::Remove;
+    }
+    case NodeData::Type::Loop:
+    {
+        // Rendering fails if the element is defined when the loop is rendered.
+        auto it = this->rangeSymbols.find(names.Name(node.symbols[0]));
+        if (it == this->rangeSymbols.end() || this->symbols.count(names.Name(node.symbols[1])) > 0 ||
+            !this->isUndefined(node.symbols[1]))
+        {
+            return Action::Keep;
+        }
+        if (it->second.empty())
+        {
+            return Action::Remove;
+        }
+        return this->isUnrollable(node) ? Action::Unroll : Action::Keep;
+    }
+    case NodeData::Type::Block:
+        // A render hook decides at render time how often the children are rendered.
+        if (node.block->render != nullptr)
+        {
+            return Action::Keep;
+        }
+        for (auto i = 0; i < node.block->symbols; i++)
+        {
+            if (this->lookup(node.symbols[i]) == nullptr)
+            {
+                return Action::Keep;
+            }
+        }
+        return Action::Inline;
+    default:
+        return Action::Keep;
+    }
+}
+
+const std::vector<std::string> &Specializer::range(const NodeData &loop)
+{
+    return this->rangeSymbols.at(this->input->Names().Name(loop.symbols[0]));
+}
+
+const std::string &Specializer::value(const NodeData &print)
+{
+    return *this->lookup(print.symbols[0]);
+}
+
+const std::string *Specializer::lookup(uint32_t id) const
+{
+    if (const auto *element = this->element(id))
+    {
+        return element->value;
+    }
+
+    auto it = this->symbols.find(this->input->Names().Name(id));
+    return it == this->symbols.end() ? nullptr : &it->second;
+}
+
+bool Specializer::isUnrollable(const NodeData &loop) const
+{
+    // Prints of the element are evaluated, other nodes are only if all their symbols are known.
+    const auto element = loop.symbols[1];
+    auto isKnown = [&](uint32_t id) {
+        return id == element || this->lookup(id) != nullptr;
+    };
+
+    this->pending.clear();
+    this->pending.push_back(BlockNode(*this->input, loop).Children());
+    while (!this->pending.empty())
+    {
+        const auto children = this->pending.back();
+        this->pending.pop_back();
+        for (const auto &n : children)
+        {
+            const auto &node = n.Data();
+            switch (node.type)
+            {
+            case NodeData::Type::Text:
+            case NodeData::Type::Print:
+                continue;
+            case NodeData::Type::Loop:
+                // The loop fails to render, redefining the element, unless the element is bound.
+                if (node.symbols[1] == element)
+                {
+                    return false;
+                }
+                break;
+            case NodeData::Type::IfEq:
+                if ((node.symbols[0] == element || node.symbols[1] == element) &&
+                    (!isKnown(node.symbols[0]) || !isKnown(node.symbols[1])))
+                {
+                    return false;
+                }
+                break;
+            case NodeData::Type::Block:
+            {
+                auto usesElement = false;
+                auto isEvaluated = node.block->render == nullptr;
+                for (auto i = 0; i < node.block->symbols; i++)
+                {
+                    usesElement = usesElement || node.symbols[i] == element;
+                    isEvaluated = isEvaluated && isKnown(node.symbols[i]);
+                }
+                if (usesElement && !isEvaluated)
+                {
+                    return false;
+                }
+                break;
+            }
+            }
+            this->pending.push_back(BlockNode(*this->input, node).Children());
+        }
+    }
+    return true;
+}
+
+std::ostream &operator<<(std::ostream &os, const PassReport &report)
+{
+    os << report.name << ": " << report.changes << (report.changes == 1 ? " change" : " changes");
+    return os;
+}
+
+void PassManager::Add(std::unique_ptr<Pass> pass)
+{
+    this->passes.push_back(Entry{std::move(pass), true});
+}
+
+bool PassManager::Enable(const std::string &name, bool isEnabled)
+{
+    auto result = false;
+    for (auto &entry : this->passes)
+    {
+        if (name == entry.pass->Name())
+        {
+            entry.isEnabled = isEnabled;
+            result = true;
+        }
+    }
+    return result;
+}
+
+size_t PassManager::Run(parser::Ast &nodes)
+{
+    this->reports.clear();
+    size_t changes = 0;
+    for (auto &entry : this->passes)
+    {
+        if (!entry.isEnabled)
+        {
+            continue;
+        }
+
+        // The rewritten tree retains the text of the previous one, which can be cleared.
+        this->scratch.clear();
+        const auto count = entry.pass->Run(nodes, this->scratch);
+        std::swap(nodes, this->scratch);
+
+        this->reports.push_back(PassReport{entry.pass->Name(), count});
+        changes += count;
+    }
+    this->scratch.clear();
+
+    return changes;
+}
+
+void AddStandardPasses(PassManager &manager, const Assumptions &assumptions)
+{
+    manager.Add(std::unique_ptr<Pass>(new FoldIfEq(assumptions)));
+    manager.Add(std::unique_ptr<Pass>(new RemoveEmpty(assumptions)));
+    manager.Add(std::unique_ptr<Pass>(new MergeText(assumptions)));
+}
+
+} // namespace passes
+// LCOV_EXCL_START
+} // namespace car
+  // LCOV_EXCL_STOP
@@ -33,7 +33,7 @@ void PrintingVisitor::visit(const LoopNode &n)
 
     for (auto const &child : n.Children())
     {
-        child->accept(*this);
+        child.accept(*this);
     }
 
     this->output << "}" << std::endl;
@@ -47,7 +47,25 @@ void PrintingVisitor::visit(const IfEqNode &n)
 
     for (auto const &child : n.Children())
     {
-        child->accept(*this);
+        child.accept(*this);
+    }
+
+    this->output << "}" << std::endl;
+}
+
+void PrintingVisitor::visit(const BlockNode &n)
+{
+    this->indent();
+    this->output << "[BlockNode `" << n.Keyword() << "`";
+    for (size_t i = 0; i < n.SymbolCount(); i++)
+    {
+        this->output << " `" << n.Symbol(i) << "`";
+    }
+    this->output << "] {" << std::endl;
+
+    for (auto const &child : n.Children())
+    {
+        child.accept(*this);
     }
 
     this->output << "}" << std::endl;
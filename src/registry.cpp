@@ -0,0 +1,225 @@
+#include <memory>
+
+#include "cache.hpp"
+#include "registry.hpp"
+
+using car::parser::NodeData;
+
+namespace car
+{
+namespace registry
+{
+
+namespace
+{
+
+bool hasChildren(const NodeData &node)
+{
+    return node.type != NodeData::Type::Text && node.type != NodeData::Type::Print;
+}
+
+// Renderers and hooks read the context of loops and registered blocks.
+bool hasContext(const NodeData &node)
+{
+    return node.type == NodeData::Type::Loop || node.type == NodeData::Type::Block;
+}
+
+} // namespace
+
+int64_t Sharing::Saved() const
+{
+    const auto nodeBytes = static_cast<int64_t>(this->nodes - this->storedNodes) * static_cast<int64_t>(sizeof(NodeData));
+    return nodeBytes + static_cast<int64_t>(this->textBytes - this->storedTextBytes) - static_cast<int64_t>(this->indexBytes);
+}
+
+std::ostream &operator<<(std::ostream &os, const Sharing &sharing)
+{
+    os << "templates: " << sharing.templates << ", nodes: " << sharing.storedNodes << " of " << sharing.nodes
+       << ", text bytes: " << sharing.storedTextBytes << " of " << sharing.textBytes << ", index bytes: " << sharing.indexBytes
+       << ", saved bytes: " << sharing.Saved();
+    return os;
+}
+
+size_t TemplateRegistry::TextHash::operator()(string_view text) const
+{
+    return cache::Hash(text.data(), text.size());
+}
+
+void TemplateRegistry::Add(const std::string &name, const parser::Ast &nodes)
+{
+    this->ids.clear();
+    for (uint32_t id = 0; id < nodes.names.size(); id++)
+    {
+        this->ids.push_back(this->tree.names.Intern(nodes.names.Name(id)));
+    }
+
+    // A list is added once the children of its blocks are, on a stack so that templates nest arbitrarily deep.
+    auto children = List{0, 0};
+    auto hasList = false;
+    this->frames.clear();
+    this->copies.clear();
+    this->frames.push_back(Frame{nodes.pending.data(), nodes.pending.size(), 0, 0});
+    while (!this->frames.empty())
+    {
+        auto &frame = this->frames.back();
+        if (frame.next == frame.count)
+        {
+            children = this->add(frame.copies);
+            hasList = true;
+            this->frames.pop_back();
+            continue;
+        }
+
+        const auto &node = frame.list[frame.next];
+        if (hasChildren(node) && node.count > 0 && !hasList)
+        {
+            this->frames.push_back(Frame{nodes.nodes.data() + node.first, node.count, 0, this->copies.size()});
+            continue;
+        }
+
+        this->copies.push_back(this->copy(node, hasList ? children : List{0, 0}));
+        hasList = false;
+        frame.next++;
+    }
+
+    this->templates[name] = children;
+    this->sharing.templates++;
+}
+
+parser::NodeRange TemplateRegistry::Find(const std::string &name) const
+{
+    auto it = this->templates.find(name);
+    if (it == this->templates.end())
+    {
+        return parser::NodeRange(this->tree, this->tree.nodes.data(), 0);
+    }
+    return parser::NodeRange(this->tree, this->tree.nodes.data() + it->second.first, it->second.count);
+}
+
+Sharing TemplateRegistry::Report() const
+{
+    // Each entry of an unordered container is a node with the value, a hash and a pointer, and a bucket.
+    auto sharing = this->sharing;
+    if (!this->isSharing)
+    {
+        return sharing;
+    }
+    sharing.indexBytes = this->lists.size() * (sizeof(decltype(lists)::value_type) + 2 * sizeof(void *)) +
+                         this->lists.bucket_count() * sizeof(void *) +
+                         this->texts.size() * (sizeof(string_view) + 2 * sizeof(void *)) +
+                         this->texts.bucket_count() * sizeof(void *);
+    return sharing;
+}
+
+NodeData TemplateRegistry::copy(const NodeData &node, const List &children)
+{
+    auto result = node;
+    for (auto &id : result.symbols)
+    {
+        if (id != Interner::None)
+        {
+            id = this->ids[id];
+        }
+    }
+
+    if (node.type == NodeData::Type::Text)
+    {
+        result.text = this->text(string_view(node.text, node.count));
+    }
+    else if (hasChildren(node))
+    {
+        result.first = children.first;
+    }
+    return result;
+}
+
+const char *TemplateRegistry::text(string_view text)
+{
+    this->sharing.textBytes += text.size();
+    if (this->isSharing)
+    {
+        auto it = this->texts.find(text);
+        if (it != this->texts.end())
+        {
+            return it->data();
+        }
+    }
+
+    // The tree owns the text, strings do not move their characters when they are moved.
+    this->tree.texts.push_back(std::make_shared<std::string>(text.data(), text.size()));
+    const auto &stored = *this->tree.texts.back();
+    this->sharing.storedTextBytes += stored.size();
+    if (this->isSharing)
+    {
+        this->texts.insert(string_view(stored));
+    }
+    return stored.data();
+}
+
+TemplateRegistry::List TemplateRegistry::add(size_t begin)
+{
+    const auto count = static_cast<uint32_t>(this->copies.size() - begin);
+    this->sharing.nodes += count;
+
+    uint64_t key = count;
+    if (this->isSharing)
+    {
+        for (auto i = begin; i < this->copies.size(); i++)
+        {
+            key = hash(this->copies[i], key);
+        }
+
+        auto range = this->lists.equal_range(key);
+        for (auto it = range.first; it != range.second; ++it)
+        {
+            const auto &list = it->second;
+            auto isFound = list.count == count;
+            for (uint32_t i = 0; isFound && i < count; i++)
+            {
+                isFound = isSame(this->tree.nodes[list.first + i], this->copies[begin + i]);
+            }
+            if (isFound)
+            {
+                this->copies.erase(this->copies.begin() + begin, this->copies.end());
+                return list;
+            }
+        }
+    }
+
+    const auto list = List{static_cast<uint32_t>(this->tree.nodes.size()), count};
+    this->tree.nodes.insert(this->tree.nodes.end(), this->copies.begin() + begin, this->copies.end());
+    this->copies.erase(this->copies.begin() + begin, this->copies.end());
+    this->sharing.storedNodes += count;
+    if (this->isSharing)
+    {
+        this->lists.emplace(key, list);
+    }
+    return list;
+}
+
+uint64_t TemplateRegistry::hash(const NodeData &node, uint64_t seed)
+{
+    // Text is stored once, its address identifies it.
+    const uint64_t fields[] = {
+        static_cast<uint64_t>(node.type) | static_cast<uint64_t>(node.isInvariant) << 8,
+        static_cast<uint64_t>(node.symbols[0]) | static_cast<uint64_t>(node.symbols[1]) << 32,
+        static_cast<uint64_t>(node.first) | static_cast<uint64_t>(node.count) << 32,
+        reinterpret_cast<uint64_t>(node.text),
+        hasContext(node) ? static_cast<uint64_t>(static_cast<uint32_t>(node.ctx.StartPos())) |
+                               static_cast<uint64_t>(static_cast<uint32_t>(node.ctx.EndPos())) << 32
+                         : 0,
+    };
+    return cache::Hash(reinterpret_cast<const char *>(fields), sizeof(fields), seed);
+}
+
+bool TemplateRegistry::isSame(const NodeData &lhs, const NodeData &rhs)
+{
+    return lhs.type == rhs.type && lhs.isInvariant == rhs.isInvariant && lhs.symbols[0] == rhs.symbols[0] &&
+           lhs.symbols[1] == rhs.symbols[1] && lhs.first == rhs.first && lhs.count == rhs.count &&
+           lhs.text == rhs.text && (!hasContext(lhs) || lhs.ctx == rhs.ctx);
+}
+
+} // namespace registry
+// LCOV_EXCL_START
+} // namespace car
+  // LCOV_EXCL_STOP
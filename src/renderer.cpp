@@ -1,10 +1,216 @@
 #include "renderer.hpp"
 
+using car::parser::NodeData;
+
 namespace car
 {
 namespace renderer
 {
 
+Slots::Slots(const parser::Ast &nodes,
+             const std::unordered_map<std::string, std::string> &symbols,
+             const std::unordered_map<std::string, std::vector<std::string>> &rangeSymbols)
+{
+    const auto &names = nodes.Names();
+    this->symbols.reserve(names.size());
+    this->rangeSymbols.reserve(names.size());
+    for (uint32_t id = 0; id < names.size(); id++)
+    {
+        const auto &name = names.Name(id);
+        auto it = symbols.find(name);
+        this->symbols.push_back(it == symbols.end() ? nullptr : &it->second);
+        auto rangeIt = rangeSymbols.find(name);
+        this->rangeSymbols.push_back(rangeIt == rangeSymbols.end() ? nullptr : &rangeIt->second);
+    }
+}
+
+Renderer::Renderer(const Slots &slots, std::ostream &output, std::ostream &error)
+    : Renderer(std::unordered_map<std::string, std::string>(),
+               std::unordered_map<std::string, std::vector<std::string>>(), output, error)
+{
+    // Every id of the tree is resolved, the maps are never looked up.
+    this->symbolSlots.reserve(slots.symbols.size());
+    for (const auto *value : slots.symbols)
+    {
+        this->symbolSlots.push_back(Slot<std::string>{value, true});
+    }
+    this->rangeSymbolSlots.reserve(slots.rangeSymbols.size());
+    for (const auto *range : slots.rangeSymbols)
+    {
+        this->rangeSymbolSlots.push_back(Slot<std::vector<std::string>>{range, true});
+    }
+}
+
+template <typename T>
+const T *Renderer::lookup(std::vector<Slot<T>> &slots,
+                          const std::unordered_map<std::string, T> &values,
+                          const std::string &name,
+                          uint32_t id)
+{
+    if (id >= slots.size())
+    {
+        slots.resize(id + 1);
+    }
+
+    auto &slot = slots[id];
+    if (!slot.isResolved)
+    {
+        auto it = values.find(name);
+        slot.value = it == values.end() ? nullptr : &it->second;
+        slot.isResolved = true;
+    }
+
+    return slot.value;
+}
+
+void Renderer::push(const parser::NodeRange &children, const std::vector<std::string> *range, uint32_t elementId)
+{
+    if (range != nullptr)
+    {
+        this->symbolSlots[elementId].value = &(*range)[0];
+    }
+    this->frames.push_back(Frame{children.begin(), children.begin(), children.end(), range, 0, elementId,
+                                 this->slices.size(), this->slices.size()});
+
+    // Blocks nested in the children are pushed by their visit and rendered by the outermost one.
+    if (!this->isRunning)
+    {
+        this->run();
+    }
+}
+
+void Renderer::run()
+{
+    this->isRunning = true;
+
+    while (this->frames.size() > this->base)
+    {
+        const auto depth = this->frames.size();
+        auto *frame = &this->frames.back();
+
+        // Children are rendered in a row until one of them pushes a block, which moves the frames.
+        while (frame->next != frame->end && !this->hasError)
+        {
+            if (frame->range != nullptr && this->hoist())
+            {
+                frame = &this->frames.back();
+                continue;
+            }
+
+            auto child = *frame->next;
+            ++frame->next;
+            child.accept(*this);
+
+            if (this->frames.size() != depth)
+            {
+                break;
+            }
+        }
+
+        if (this->frames.size() != depth)
+        {
+            continue;
+        }
+
+        if (!this->hasError && frame->range != nullptr && ++frame->value < frame->range->size())
+        {
+            this->symbolSlots[frame->elementId].value = &(*frame->range)[frame->value];
+            frame->next = frame->first;
+            frame->slice = frame->slices;
+            continue;
+        }
+
+        if (frame->range != nullptr)
+        {
+            this->symbolSlots[frame->elementId].value = nullptr;
+            this->slices.erase(this->slices.begin() + frame->slices, this->slices.end());
+        }
+        this->frames.pop_back();
+    }
+
+    this->isRunning = false;
+}
+
+bool Renderer::hoist()
+{
+    auto &frame = this->frames.back();
+    if (frame.value > 0)
+    {
+        if (frame.slice == this->slices.size() || this->slices[frame.slice].first != frame.next)
+        {
+            return false;
+        }
+
+        const auto &slice = this->slices[frame.slice++];
+        this->write(slice.text);
+        frame.next = slice.end;
+        return true;
+    }
+
+    // Slices are captured in the first of several iterations, children of a captured slice are rendered once.
+    if (frame.range->size() < 2 || this->capture != nullptr)
+    {
+        return false;
+    }
+
+    // A run of invariant children is captured if it saves more than copying a single text or value.
+    auto end = frame.next;
+    size_t count = 0;
+    auto hasBlock = false;
+    for (; end != frame.end && (*end).Data().isInvariant; ++end, count++)
+    {
+        const auto type = (*end).Data().type;
+        hasBlock = hasBlock || (type != NodeData::Type::Text && type != NodeData::Type::Print);
+    }
+    if (count < 2 && !hasBlock)
+    {
+        return false;
+    }
+
+    // Blocks pushed by the children are rendered by a nested run, which stops at the frames of this one.
+    const auto first = frame.next;
+    frame.next = end;
+    frame.slice++;
+    const auto base = this->base;
+    this->base = this->frames.size();
+    auto text = std::string();
+    this->capture = &text;
+    this->isRunning = false;
+    for (auto it = first; it != end && !this->hasError; ++it)
+    {
+        (*it).accept(*this);
+    }
+    this->isRunning = true;
+    this->capture = nullptr;
+    this->base = base;
+
+    this->output << text;
+    this->slices.push_back(Slice{first, end, std::move(text)});
+    return true;
+}
+
+void Renderer::write(string_view text)
+{
+    if (this->capture != nullptr)
+    {
+        this->capture->append(text.data(), text.size());
+        return;
+    }
+    this->output << text;
+}
+
+std::ostream &Renderer::fail()
+{
+    // The output captured so far precedes the error.
+    this->hasError = true;
+    if (this->capture != nullptr)
+    {
+        this->output << *this->capture;
+        this->capture->clear();
+    }
+    return this->error;
+}
+
 void Renderer::visit(const TextNode &n)
 {
     if (this->hasError)
@@ -12,7 +218,7 @@ void Renderer::visit(const TextNode &n)
         return;
     }
 
-    this->output << n.Text();
+    this->write(n.Text());
 }
 
 void Renderer::visit(const PrintNode &n)
@@ -22,15 +228,14 @@ void Renderer::visit(const PrintNode &n)
         return;
     }
 
-    const auto &symbol = this->symbols.find(n.Symbol());
-    if (symbol == this->symbols.end())
+    auto symbol = this->lookup(this->symbolSlots, this->symbols, n.Symbol(), n.SymbolId());
+    if (symbol == nullptr)
     {
-        this->hasError = true;
-        this->error << "Symbol not found: `" << n.Symbol() << "`" << std::endl;
+        this->fail() << "Symbol not found: `" << n.Symbol() << "`" << std::endl;
         return;
     }
 
-    this->output << symbol->second;
+    this->write(*symbol);
 }
 
 void Renderer::visit(const LoopNode &n)
@@ -40,36 +245,27 @@ void Renderer::visit(const LoopNode &n)
         return;
     }
 
-    auto rangeSym = this->rangeSymbols.find(n.RangeSymbol());
-    if (rangeSym == this->rangeSymbols.end())
+    auto range = this->lookup(this->rangeSymbolSlots, this->rangeSymbols, n.RangeSymbol(), n.RangeSymbolId());
+    if (range == nullptr)
     {
-        this->hasError = true;
-        this->error << "Range symbol not found: `" << n.RangeSymbol() << "`" << std::endl;
+        this->fail() << "Range symbol not found: `" << n.RangeSymbol() << "`" << std::endl;
         return;
     }
 
-    const auto &range = rangeSym->second;
     const auto &element = n.ElementSymbol();
+    const auto elementId = n.ElementSymbolId();
 
     // Symbol names must be unique across the program, i.e. every symbol is global-scoped.
-    auto elemSym = this->symbols.find(element);
-    if (elemSym != this->symbols.end())
+    if (this->lookup(this->symbolSlots, this->symbols, element, elementId) != nullptr)
     {
-        this->hasError = true;
-        this->error << "Symbol names must be unique across the program, redefined `" << element << "` at " << n.Ctx() << std::endl;
+        this->fail() << "Symbol names must be unique across the program, redefined `" << element << "` at " << n.Ctx() << std::endl;
         return;
     }
 
-    for (const auto &value : range)
+    if (!range->empty())
     {
-        this->symbols[element] = value;
-
-        for (auto const &child : n.Children())
-        {
-            child->accept(*this);
-        }
+        this->push(n.Children(), range, elementId);
     }
-    this->symbols.erase(element);
 }
 
 void Renderer::visit(const IfEqNode &n)
@@ -79,32 +275,59 @@ void Renderer::visit(const IfEqNode &n)
         return;
     }
 
-    auto leftSym = this->symbols.find(n.LeftSymbol());
-    if (leftSym == this->symbols.end())
+    auto leftSym = this->lookup(this->symbolSlots, this->symbols, n.LeftSymbol(), n.LeftSymbolId());
+    if (leftSym == nullptr)
     {
-        this->hasError = true;
-        this->error << "Symbol not found: `" << n.LeftSymbol() << "`" << std::endl;
+        this->fail() << "Symbol not found: `" << n.LeftSymbol() << "`" << std::endl;
         return;
     }
 
-    auto rightSym = this->symbols.find(n.RightSymbol());
-    if (rightSym == this->symbols.end())
+    auto rightSym = this->lookup(this->symbolSlots, this->symbols, n.RightSymbol(), n.RightSymbolId());
+    if (rightSym == nullptr)
     {
-        this->hasError = true;
-        this->error << "Symbol not found: `" << n.RightSymbol() << "`" << std::endl;
+        this->fail() << "Symbol not found: `" << n.RightSymbol() << "`" << std::endl;
         return;
     }
 
-    if (leftSym->second == rightSym->second)
+    if (*leftSym == *rightSym)
     {
-        for (auto const &child : n.Children())
+        this->push(n.Children(), nullptr, Interner::None);
+    }
+}
+
+void Renderer::visit(const BlockNode &n)
+{
+    if (this->hasError)
+    {
+        return;
+    }
+
+    for (size_t i = 0; i < n.SymbolCount(); i++)
+    {
+        this->blockValues[i] = this->lookup(this->symbolSlots, this->symbols, n.Symbol(i), n.SymbolId(i));
+        if (this->blockValues[i] == nullptr)
         {
-            child->accept(*this);
+            this->fail() << "Symbol not found: `" << n.Symbol(i) << "`" << std::endl;
+            return;
         }
     }
+
+    const auto &type = n.Type();
+    this->blockRenders = type.render == nullptr ? 1 : 0;
+    if (type.render != nullptr && !type.render(n, *this))
+    {
+        this->hasError = true;
+        return;
+    }
+
+    // Children of blocks the hook renders more than once are pushed in a row, they do not depend on which is first.
+    for (auto renders = this->blockRenders; renders > 0 && !this->hasError; renders--)
+    {
+        this->push(n.Children(), nullptr, Interner::None);
+    }
 }
 
 } // namespace renderer
 // LCOV_EXCL_START
 } // namespace car
-  // LCOV_EXCL_STOP
\ No newline at end of file
+  // LCOV_EXCL_STOP
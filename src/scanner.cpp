@@ -0,0 +1,136 @@
+#include "scanner.hpp"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CARENDER_SCANNER_X86
+#include <immintrin.h>
+#endif
+
+namespace car
+{
+namespace scanner
+{
+
+namespace
+{
+
+typedef const char *(*finder)(const char *begin, const char *end, char c);
+
+const char *findScalar(const char *begin, const char *end, char c)
+{
+    while (begin != end && *begin != c)
+    {
+        begin++;
+    }
+    return begin;
+}
+
+#ifdef CARENDER_SCANNER_X86
+
+__attribute__((target("sse2"))) const char *findSSE2(const char *begin, const char *end, char c)
+{
+    const auto needle = _mm_set1_epi8(c);
+    for (; end - begin >= 16; begin += 16)
+    {
+        auto chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(begin));
+        auto mask = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, needle));
+        if (mask != 0)
+        {
+            return begin + __builtin_ctz(mask);
+        }
+    }
+    return findScalar(begin, end, c);
+}
+
+__attribute__((target("avx2"))) const char *findAVX2(const char *begin, const char *end, char c)
+{
+    const auto needle = _mm256_set1_epi8(c);
+    for (; end - begin >= 32; begin += 32)
+    {
+        auto chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(begin));
+        auto mask = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, needle)));
+        if (mask != 0)
+        {
+            return begin + __builtin_ctz(mask);
+        }
+    }
+    return findSSE2(begin, end, c);
+}
+
+#endif // CARENDER_SCANNER_X86
+
+finder finderFor(Isa isa)
+{
+    switch (isa)
+    {
+#ifdef CARENDER_SCANNER_X86
+    case Isa::AVX2:
+        return findAVX2;
+    case Isa::SSE2:
+        return findSSE2;
+#endif
+    default:
+        return findScalar;
+    }
+}
+
+} // namespace
+
+bool IsSupported(Isa isa)
+{
+    switch (isa)
+    {
+#ifdef CARENDER_SCANNER_X86
+    case Isa::AVX2:
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2");
+    case Isa::SSE2:
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("sse2");
+#endif
+    case Isa::Scalar:
+        return true;
+    default:
+        return false;
+    }
+}
+
+Isa BestIsa()
+{
+    static const Isa best = IsSupported(Isa::AVX2) ? Isa::AVX2 : IsSupported(Isa::SSE2) ? Isa::SSE2 : Isa::Scalar;
+    return best;
+}
+
+const char *Find(const char *begin, const char *end, char c)
+{
+    static const finder best = finderFor(BestIsa());
+    return best(begin, end, c);
+}
+
+const char *Find(const char *begin, const char *end, char c, Isa isa)
+{
+    return finderFor(isa)(begin, end, c);
+}
+
+const char *FindPair(const char *begin, const char *end, char first, char second)
+{
+    if (begin == end)
+    {
+        return end;
+    }
+
+    // The pair cannot start at the last character.
+    const auto last = end - 1;
+    for (auto it = Find(begin, last, first); it != last; it = Find(it + 1, last, first))
+    {
+        if (it[1] == second)
+        {
+            return it;
+        }
+    }
+    return end;
+}
+
+} // namespace scanner
+// LCOV_EXCL_START
+} // namespace car
+  // LCOV_EXCL_STOP
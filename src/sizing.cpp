@@ -0,0 +1,311 @@
+#include <algorithm>
+#include <ostream>
+
+#include "sizing.hpp"
+
+using car::parser::NodeData;
+
+namespace car
+{
+namespace sizing
+{
+
+namespace
+{
+
+void degrade(Accuracy &accuracy, Accuracy to)
+{
+    accuracy = std::max(accuracy, to);
+}
+
+} // namespace
+
+SizeFormula::SizeFormula(const parser::Ast &nodes) : loops(0)
+{
+    this->bindings.assign(nodes.Names().size(), Interner::None);
+
+    // Top-level nodes are analyzed as the children of a block without symbols.
+    this->frames.push_back(Frame{nullptr, nodes.begin(), nodes.end(), 0, 0, 0, Interner::None});
+
+    while (!this->frames.empty())
+    {
+        const auto depth = this->frames.size();
+        auto *frame = &this->frames.back();
+
+        // Siblings are analyzed in a row until one of them opens a block, which moves the frames.
+        while (frame->next != frame->end)
+        {
+            auto child = *frame->next;
+            ++frame->next;
+            child.accept(*this);
+
+            if (this->frames.size() != depth)
+            {
+                break;
+            }
+        }
+
+        if (this->frames.size() == depth)
+        {
+            this->close();
+        }
+    }
+}
+
+Size SizeFormula::Evaluate(const renderer::Slots &slots) const
+{
+    // Each term leaves the size of its block on the stack, linear in the lengths of the elements of the loops it
+    // is nested in: a constant followed by a coefficient for each loop, from the outermost one.
+    auto forms = std::vector<size_t>();
+    auto accuracy = Accuracy::Exact;
+    for (const auto &term : this->terms)
+    {
+        const size_t width = term.loops + 1;
+        const auto base = forms.size() - term.terms * width;
+        if (term.terms == 0)
+        {
+            forms.resize(base + width, 0);
+        }
+        for (size_t i = 1; i < term.terms; i++)
+        {
+            for (size_t j = 0; j < width; j++)
+            {
+                forms[base + j] += forms[base + i * width + j];
+            }
+        }
+        forms.resize(base + width);
+
+        auto *form = &forms[base];
+        form[0] += term.text;
+        for (auto i = term.first; i < term.first + term.count; i++)
+        {
+            const auto &print = this->prints[i];
+            if (print.loop != Interner::None)
+            {
+                form[1 + print.loop] += print.count;
+                continue;
+            }
+
+            // Rendering stops at a symbol that is not defined.
+            const auto *value = slots.Symbol(print.id);
+            if (value == nullptr)
+            {
+                degrade(accuracy, Accuracy::UpperBound);
+                continue;
+            }
+            form[0] += print.count * value->size();
+        }
+
+        auto isRendered = true;
+        switch (term.type)
+        {
+        case NodeData::Type::Loop:
+        {
+            const auto *range = slots.RangeSymbol(term.symbols[0]);
+            isRendered = range != nullptr && !term.isVariable && slots.Symbol(term.symbols[1]) == nullptr;
+            if (!isRendered)
+            {
+                break;
+            }
+
+            // The children are rendered for each value, with the element bound to it.
+            size_t lengths = 0;
+            for (const auto &value : *range)
+            {
+                lengths += value.size();
+            }
+            const auto element = form[width - 1];
+            for (size_t j = 0; j + 1 < width; j++)
+            {
+                form[j] *= range->size();
+            }
+            form[0] += element * lengths;
+            break;
+        }
+        case NodeData::Type::IfEq:
+        {
+            // Values of loop elements are not known, the children are counted as if they were always rendered.
+            if (term.isVariable)
+            {
+                degrade(accuracy, Accuracy::UpperBound);
+                break;
+            }
+            const auto *left = slots.Symbol(term.symbols[0]);
+            const auto *right = slots.Symbol(term.symbols[1]);
+            if (left == nullptr || right == nullptr)
+            {
+                isRendered = false;
+                break;
+            }
+            if (*left != *right)
+            {
+                std::fill(form, form + width, 0);
+            }
+            break;
+        }
+        default:
+            for (auto id : term.symbols)
+            {
+                isRendered = isRendered && (id == Interner::None || slots.Symbol(id) != nullptr);
+            }
+            if (isRendered && term.isVariable)
+            {
+                degrade(accuracy, Accuracy::Estimate);
+            }
+            break;
+        }
+
+        if (!isRendered)
+        {
+            degrade(accuracy, Accuracy::UpperBound);
+            std::fill(form, form + width, 0);
+        }
+
+        // The size of a loop does not depend on its own element.
+        if (term.type == NodeData::Type::Loop)
+        {
+            forms.pop_back();
+        }
+    }
+
+    return Size{forms[0], accuracy};
+}
+
+void SizeFormula::visit(const parser::TextNode &n)
+{
+    this->frames.back().text += n.Text().size();
+}
+
+void SizeFormula::visit(const parser::PrintNode &n)
+{
+    this->pending.push_back(Print{n.SymbolId(), this->bindings[n.SymbolId()], 1});
+}
+
+void SizeFormula::visit(const parser::LoopNode &n)
+{
+    this->open(n.Data(), n.Children());
+}
+
+void SizeFormula::visit(const parser::IfEqNode &n)
+{
+    this->open(n.Data(), n.Children());
+}
+
+void SizeFormula::visit(const parser::BlockNode &n)
+{
+    this->open(n.Data(), n.Children());
+}
+
+void SizeFormula::open(const NodeData &block, const parser::NodeRange &children)
+{
+    auto shadowed = Interner::None;
+    if (block.type == NodeData::Type::Loop)
+    {
+        shadowed = this->bindings[block.symbols[1]];
+        this->bindings[block.symbols[1]] = this->loops++;
+    }
+    this->frames.push_back(Frame{&block, children.begin(), children.end(), 0, 0, this->pending.size(), shadowed});
+}
+
+void SizeFormula::close()
+{
+    const auto &frame = this->frames.back();
+
+    // Prints of the same symbol are counted once.
+    const auto begin = this->pending.begin() + frame.prints;
+    std::sort(begin, this->pending.end(), [](const Print &lhs, const Print &rhs) {
+        return lhs.loop < rhs.loop || (lhs.loop == rhs.loop && lhs.id < rhs.id);
+    });
+    const auto first = static_cast<uint32_t>(this->prints.size());
+    for (auto it = begin; it != this->pending.end(); ++it)
+    {
+        if (this->prints.size() > first && this->prints.back().id == it->id && this->prints.back().loop == it->loop)
+        {
+            this->prints.back().count += it->count;
+            continue;
+        }
+        this->prints.push_back(*it);
+    }
+    this->pending.erase(begin, this->pending.end());
+
+    auto term = Term{NodeData::Type::Block, false, {Interner::None, Interner::None}, this->loops, frame.terms, first,
+                     static_cast<uint32_t>(this->prints.size() - first), frame.text};
+    if (frame.block != nullptr)
+    {
+        const auto &block = *frame.block;
+        term.type = block.type;
+        term.symbols[0] = block.symbols[0];
+        term.symbols[1] = block.symbols[1];
+        switch (block.type)
+        {
+        case NodeData::Type::Loop:
+            this->loops--;
+            this->bindings[block.symbols[1]] = frame.shadowed;
+            term.isVariable = frame.shadowed != Interner::None;
+            break;
+        case NodeData::Type::IfEq:
+            term.isVariable = this->isElement(block.symbols[0]) || this->isElement(block.symbols[1]);
+            break;
+        default:
+            term.isVariable = block.block->render != nullptr;
+            for (auto i = static_cast<size_t>(block.block->symbols); i < 2; i++)
+            {
+                term.symbols[i] = Interner::None;
+            }
+            // Elements of enclosing loops are bound when the block is rendered.
+            for (auto &id : term.symbols)
+            {
+                id = id != Interner::None && this->isElement(id) ? Interner::None : id;
+            }
+            break;
+        }
+    }
+
+    this->terms.push_back(term);
+    this->frames.pop_back();
+    if (!this->frames.empty())
+    {
+        this->frames.back().terms++;
+    }
+}
+
+bool SizeFormula::isElement(uint32_t id) const
+{
+    return this->bindings[id] != Interner::None;
+}
+
+std::streamsize StringBuffer::xsputn(const char *s, std::streamsize count)
+{
+    this->output.append(s, static_cast<size_t>(count));
+    return count;
+}
+
+StringBuffer::int_type StringBuffer::overflow(int_type c)
+{
+    if (!traits_type::eq_int_type(c, traits_type::eof()))
+    {
+        this->output.push_back(traits_type::to_char_type(c));
+    }
+    return traits_type::not_eof(c);
+}
+
+bool Render(const parser::Ast &nodes, const SizeFormula &formula, const renderer::Slots &slots, std::string &output,
+            std::ostream &error)
+{
+    output.clear();
+    output.reserve(formula.Evaluate(slots).bytes);
+
+    StringBuffer buffer(output);
+    std::ostream stream(&buffer);
+    auto renderer = renderer::Renderer(slots, stream, error);
+    for (const auto &n : nodes)
+    {
+        n.accept(renderer);
+    }
+    return !renderer.HasError();
+}
+
+} // namespace sizing
+// LCOV_EXCL_START
+} // namespace car
+  // LCOV_EXCL_STOP
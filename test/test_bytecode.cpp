@@ -0,0 +1,178 @@
+#include "catch.hpp"
+
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "bytecode.hpp"
+#include "lexer.hpp"
+#include "parser.hpp"
+#include "renderer.hpp"
+
+using car::bytecode::Compiler;
+using car::bytecode::Machine;
+using car::bytecode::Op;
+using car::bytecode::Program;
+using car::lexer::Lexer;
+using car::lexer::Token;
+using car::parser::Ast;
+using car::parser::BlockNode;
+using car::parser::BlockRegistry;
+using car::parser::BlockScope;
+using car::parser::BlockType;
+using car::parser::Parser;
+using car::parser::ParserOptions;
+using car::renderer::Renderer;
+
+namespace car
+{
+
+namespace
+{
+
+bool renderThrice(const BlockNode &, BlockScope &scope)
+{
+    scope.Output() << scope.Value(0) << ":";
+    scope.RenderChildren();
+    scope.RenderChildren();
+    scope.RenderChildren();
+    return true;
+}
+
+bool renderNever(const BlockNode &, BlockScope &scope)
+{
+    scope.Output() << "-";
+    return true;
+}
+
+/**
+* Renders `text` with a Renderer and a Machine, their output and errors must be the same.
+*/
+void requireSameAsRenderer(const std::string &text,
+                           const std::unordered_map<std::string, std::string> &symbols,
+                           const std::unordered_map<std::string, std::vector<std::string>> &rangeSymbols,
+                           const BlockRegistry &blocks)
+{
+    std::stringstream error;
+    auto lexer = Lexer();
+    auto tokens = std::vector<Token>();
+    auto nodes = Ast();
+    REQUIRE(lexer.lex(text.data(), text.data() + text.size(), tokens, error));
+    REQUIRE(Parser(ParserOptions({}, blocks)).parse(tokens, nodes, error));
+
+    std::stringstream expected;
+    std::stringstream expectedError;
+    auto renderer = Renderer(symbols, rangeSymbols, expected, expectedError);
+    for (auto const &n : nodes)
+    {
+        n.accept(renderer);
+    }
+
+    std::stringstream rendered;
+    std::stringstream renderedError;
+    auto program = Program();
+    Compiler().Compile(nodes, program);
+    auto machine = Machine(symbols, rangeSymbols, rendered, renderedError);
+    REQUIRE(machine.Run(program) == !renderer.HasError());
+    REQUIRE(machine.HasError() == renderer.HasError());
+
+    REQUIRE(rendered.str() == expected.str());
+    REQUIRE(renderedError.str() == expectedError.str());
+}
+
+} // namespace
+
+TEST_CASE("Compiler::Compile", "[bytecode]")
+{
+    std::stringstream error;
+    auto lexer = Lexer();
+    auto tokens = std::vector<Token>();
+    auto nodes = Ast();
+    std::string text = "a{{#loop xs x}}{{x}}{{#ifeq x y}}b{{/ifeq}}{{/loop}}c";
+    REQUIRE(lexer.lex(text.data(), text.data() + text.size(), tokens, error));
+    REQUIRE(Parser(ParserOptions()).parse(tokens, nodes, error));
+
+    auto program = Program();
+    Compiler().Compile(nodes, program);
+    const auto &code = program.Code();
+
+    auto ops = std::vector<Op>();
+    for (const auto &instruction : code)
+    {
+        ops.push_back(instruction.op);
+    }
+
+    REQUIRE(ops == std::vector<Op>({Op::EmitText, Op::LoopBegin, Op::EmitSlot, Op::JumpIfNe, Op::EmitText,
+                                    Op::LoopNext, Op::EmitText, Op::Halt}));
+    // Empty loops jump past their end, loops jump back to their first child, ifeq jumps past its children.
+    REQUIRE(code[1].target == 6);
+    REQUIRE(code[5].target == 2);
+    REQUIRE(code[3].target == 5);
+    REQUIRE(std::string(code[0].text, code[0].a) == "a");
+
+    // Compiling again reuses the storage of the program.
+    auto capacity = code.capacity();
+    Compiler().Compile(nodes, program);
+    REQUIRE(program.Code().size() == 8);
+    REQUIRE(program.Code().capacity() == capacity);
+}
+
+TEST_CASE("Machine::Run", "[bytecode]")
+{
+    auto symbols = std::unordered_map<std::string, std::string>({{"name", "Aragorn"}, {"favorite", "b"}, {"loop", "L"}});
+    auto rangeSymbols = std::unordered_map<std::string, std::vector<std::string>>(
+        {{"items", {"a", "b", "c"}}, {"empty", {}}, {"name", {"x"}}, {"digits", {"1", "2"}}});
+    BlockRegistry blocks;
+    blocks.Register(BlockType{"thrice", 1, nullptr, renderThrice});
+    blocks.Register(BlockType{"never", 0, nullptr, renderNever});
+    blocks.Register(BlockType{"plain", 0, nullptr, nullptr});
+
+    SECTION("Text and symbols")
+    {
+        requireSameAsRenderer("", symbols, rangeSymbols, blocks);
+        requireSameAsRenderer("Hello", symbols, rangeSymbols, blocks);
+        requireSameAsRenderer("Hello {{name}}, {{favorite}}{{loop}}!", symbols, rangeSymbols, blocks);
+    }
+
+    SECTION("Blocks")
+    {
+        requireSameAsRenderer("{{#loop items i}}[{{i}}{{#ifeq i favorite}}!{{/ifeq}}]{{/loop}}", symbols, rangeSymbols, blocks);
+        requireSameAsRenderer("{{#loop items i}}{{#loop digits d}}{{i}}{{d}} {{/loop}}{{/loop}}", symbols, rangeSymbols, blocks);
+        requireSameAsRenderer("a{{#loop empty e}}{{e}}{{/loop}}b", symbols, rangeSymbols, blocks);
+        requireSameAsRenderer("{{#ifeq name favorite}}no{{/ifeq}}{{#ifeq name name}}yes{{/ifeq}}", symbols, rangeSymbols, blocks);
+        requireSameAsRenderer("{{#thrice name}}{{#loop digits d}}{{d}}{{/loop}}{{#never}}x{{/never}}{{/thrice}}{{#plain}}p{{/plain}}",
+                              symbols, rangeSymbols, blocks);
+    }
+
+    SECTION("Errors")
+    {
+        requireSameAsRenderer("a{{missing}}b", symbols, rangeSymbols, blocks);
+        requireSameAsRenderer("{{#loop missing m}}x{{/loop}}", symbols, rangeSymbols, blocks);
+        requireSameAsRenderer("{{#loop items name}}x{{/loop}}", symbols, rangeSymbols, blocks);
+        requireSameAsRenderer("{{#loop items i}}{{#loop digits i}}x{{/loop}}{{/loop}}", symbols, rangeSymbols, blocks);
+        requireSameAsRenderer("{{#loop items i}}{{i}}{{/loop}}{{i}}", symbols, rangeSymbols, blocks);
+        requireSameAsRenderer("{{#ifeq missing name}}x{{/ifeq}}", symbols, rangeSymbols, blocks);
+        requireSameAsRenderer("{{#ifeq name missing}}x{{/ifeq}}", symbols, rangeSymbols, blocks);
+        requireSameAsRenderer("{{#thrice missing}}x{{/thrice}}", symbols, rangeSymbols, blocks);
+        requireSameAsRenderer("{{#loop empty e}}{{missing}}{{/loop}}", symbols, rangeSymbols, blocks);
+    }
+
+    SECTION("Deep nesting")
+    {
+        const auto depth = 100000;
+        auto text = std::string();
+        for (auto i = 0; i < depth; i++)
+        {
+            text += "{{#ifeq name name}}";
+        }
+        text += "{{#loop items i}}{{i}}{{/loop}}";
+        for (auto i = 0; i < depth; i++)
+        {
+            text += "{{/ifeq}}";
+        }
+        requireSameAsRenderer(text, symbols, rangeSymbols, blocks);
+    }
+}
+
+} // namespace car
@@ -0,0 +1,130 @@
+#include "catch.hpp"
+
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "cache.hpp"
+#include "lexer.hpp"
+#include "parser.hpp"
+
+using car::cache::Hash;
+using car::cache::TemplateCache;
+using car::lexer::Lexer;
+using car::lexer::Token;
+using car::parser::Ast;
+using car::parser::Parser;
+using car::parser::ParserOptions;
+
+namespace car
+{
+
+TEST_CASE("Hash", "[cache]")
+{
+    const auto text = std::string("Hello {{name}},\n{{#loop items item}}{{item}}{{/loop}}");
+    REQUIRE(Hash(text.data(), text.size()) == Hash(text.data(), text.size()));
+    REQUIRE(Hash(text.data(), text.size()) != Hash(text.data(), text.size(), 1));
+    REQUIRE(Hash(text.data(), text.size()) != Hash(text.data(), text.size() - 1));
+
+    // Trailing zeros are part of the text.
+    const auto zeros = std::string(3, '\0');
+    REQUIRE(Hash(zeros.data(), 1) != Hash(zeros.data(), 2));
+    REQUIRE(Hash(zeros.data(), 0) != Hash(zeros.data(), 1));
+}
+
+TEST_CASE("TemplateCache", "[cache]")
+{
+    auto compiles = 0;
+    auto compile = [&](const std::string &text, Ast &nodes) {
+        compiles++;
+        std::stringstream error;
+        auto tokens = std::vector<Token>();
+        return Lexer().lex(text.data(), text.data() + text.size(), tokens, error) &&
+               Parser(ParserOptions()).parse(tokens, nodes, error);
+    };
+    const auto hello = std::string("Hello {{name}}!");
+    const auto bye = std::string("Bye {{name}}!");
+
+    SECTION("Hits")
+    {
+        TemplateCache cache(1024 * 1024);
+        auto first = cache.Get(hello, 0, compile);
+        REQUIRE(first != nullptr);
+        REQUIRE(first->nodes.size() == 3);
+
+        // The nodes refer to the cached text, not the text they were compiled from.
+        auto copy = hello;
+        REQUIRE(cache.Get(copy, 0, compile) == first);
+        REQUIRE((*first->nodes.begin()).Data().text == first->text.data());
+        REQUIRE(compiles == 1);
+
+        // Templates compiled in another scope are cached apart.
+        auto scoped = cache.Get(hello, 1, compile);
+        REQUIRE(scoped != first);
+        REQUIRE(cache.Get(bye, 0, compile) != first);
+        REQUIRE(compiles == 3);
+
+        const auto stats = cache.Counters();
+        REQUIRE(stats.hits == 1);
+        REQUIRE(stats.misses == 3);
+        REQUIRE(stats.evictions == 0);
+        REQUIRE(stats.entries == 3);
+        REQUIRE(stats.bytes > 3 * hello.size());
+    }
+
+    SECTION("Errors")
+    {
+        TemplateCache cache(1024 * 1024);
+        const auto invalid = std::string("{{#loop items}}");
+        REQUIRE(cache.Get(invalid, 0, compile) == nullptr);
+        REQUIRE(cache.Get(invalid, 0, compile) == nullptr);
+        REQUIRE(compiles == 2);
+        REQUIRE(cache.Counters().misses == 2);
+        REQUIRE(cache.Counters().entries == 0);
+    }
+
+    SECTION("Eviction")
+    {
+        TemplateCache cache(1024 * 1024);
+        cache.Get(hello, 0, compile);
+        const auto bytes = cache.Counters().bytes;
+
+        // Room for two templates, the least recently used one is evicted.
+        cache.SetBudget(2 * bytes + bytes / 2);
+        auto first = cache.Get(hello, 0, compile);
+        cache.Get(bye, 0, compile);
+        cache.Get(hello, 0, compile);
+        cache.Get("Hi {{name}}!", 0, compile);
+        REQUIRE(cache.Counters().evictions == 1);
+        REQUIRE(cache.Counters().entries == 2);
+        REQUIRE(cache.Get(hello, 0, compile) == first);
+        REQUIRE(compiles == 3);
+        cache.Get(bye, 0, compile);
+        REQUIRE(compiles == 4);
+
+        // Evicted templates stay valid while they are used.
+        cache.SetBudget(0);
+        REQUIRE(cache.Counters().entries == 0);
+        REQUIRE(cache.Counters().bytes == 0);
+        REQUIRE(first->nodes.size() == 3);
+
+        // Templates larger than the budget are compiled but not cached.
+        REQUIRE(cache.Get(hello, 0, compile) != nullptr);
+        REQUIRE(cache.Counters().entries == 0);
+
+        cache.SetBudget(1024 * 1024);
+        cache.Get(hello, 0, compile);
+        cache.Clear();
+        REQUIRE(cache.Counters().entries == 0);
+        REQUIRE(cache.Counters().bytes == 0);
+        REQUIRE(cache.Counters().hits == 3);
+    }
+
+    SECTION("Global")
+    {
+        REQUIRE(&TemplateCache::Global() == &TemplateCache::Global());
+    }
+}
+
+} // namespace car
@@ -0,0 +1,215 @@
+#include "catch.hpp"
+
+#include <cstddef>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "carc.hpp"
+#include "lexer.hpp"
+#include "parser.hpp"
+#include "passes.hpp"
+#include "printingvisitor.hpp"
+#include "renderer.hpp"
+
+using car::carc::Header;
+using car::carc::Reader;
+using car::carc::Record;
+using car::carc::Writer;
+using car::lexer::Lexer;
+using car::lexer::Token;
+using car::parser::Ast;
+using car::parser::BlockNode;
+using car::parser::BlockRegistry;
+using car::parser::BlockScope;
+using car::parser::BlockType;
+using car::parser::NodeData;
+using car::parser::Parser;
+using car::parser::ParserOptions;
+using car::parser::PrintingVisitor;
+using car::renderer::Renderer;
+
+namespace car
+{
+
+namespace
+{
+
+bool renderTwice(const BlockNode &, BlockScope &scope)
+{
+    scope.RenderChildren();
+    scope.RenderChildren();
+    return true;
+}
+
+Ast parseTemplate(const std::string &text, const BlockRegistry &blocks)
+{
+    std::stringstream error;
+    auto tokens = std::vector<Token>();
+    auto nodes = Ast();
+    REQUIRE(Lexer().lex(text.data(), text.data() + text.size(), tokens, error));
+    REQUIRE(Parser(ParserOptions({}, blocks)).parse(tokens, nodes, error));
+    return nodes;
+}
+
+std::string write(const Ast &nodes)
+{
+    std::stringstream output;
+    REQUIRE(Writer().Write(nodes, output));
+    return output.str();
+}
+
+std::string dump(const Ast &nodes)
+{
+    std::stringstream output;
+    auto visitor = PrintingVisitor(output);
+    for (const auto &n : nodes)
+    {
+        n.accept(visitor);
+        output << n.Ctx() << n.Data().isInvariant;
+    }
+    return output.str();
+}
+
+std::string render(const Ast &nodes)
+{
+    const auto symbols = std::unordered_map<std::string, std::string>({{"name", "Aragorn"}, {"favorite", "b"}});
+    const auto rangeSymbols = std::unordered_map<std::string, std::vector<std::string>>({{"items", {"a", "b", "c"}}});
+    std::stringstream output;
+    auto renderer = Renderer(symbols, rangeSymbols, output, output);
+    for (const auto &n : nodes)
+    {
+        n.accept(renderer);
+    }
+    return output.str();
+}
+
+} // namespace
+
+TEST_CASE("carc", "[carc]")
+{
+    BlockRegistry blocks;
+    blocks.Register(BlockType{"twice", 1, nullptr, renderTwice});
+    const auto text = std::string("Hello {{name}},\n{{#loop items item}}I like {{item}}{{#ifeq item favorite}} very much"
+                                  "{{/ifeq}}.{{#twice name}}!{{/twice}}\n{{/loop}}Cheers!");
+    const auto nodes = parseTemplate(text, blocks);
+    std::stringstream error;
+
+    SECTION("Round trip")
+    {
+        const auto bytes = write(nodes);
+        auto loaded = Ast();
+        REQUIRE(Reader(blocks).Read(bytes.data(), bytes.data() + bytes.size(), loaded, error));
+        REQUIRE(error.str() == "");
+        REQUIRE(dump(loaded) == dump(nodes));
+        REQUIRE(render(loaded) == render(nodes));
+        REQUIRE(loaded.Names().size() == nodes.Names().size());
+
+        // Text refers to the file.
+        const auto &first = (*loaded.begin()).Data();
+        REQUIRE(first.text >= bytes.data());
+        REQUIRE(first.text < bytes.data() + bytes.size());
+
+        // Loaded trees are written the same.
+        REQUIRE(write(loaded) == bytes);
+    }
+
+    SECTION("Rewritten trees")
+    {
+        // Unrolled loops share their text, which is written once.
+        auto residual = nodes;
+        auto passes = passes::PassManager();
+        const auto symbols = std::unordered_map<std::string, std::string>({{"favorite", "b"}});
+        const auto rangeSymbols = std::unordered_map<std::string, std::vector<std::string>>({{"items", {"a", "b", "c"}}});
+        auto assumptions = passes::Assumptions();
+        assumptions.symbols = {"name"};
+        assumptions.isExhaustive = true;
+        passes.Add(std::unique_ptr<passes::Pass>(new passes::Specializer(symbols, rangeSymbols, assumptions)));
+        passes.Run(residual);
+
+        const auto bytes = write(residual);
+        REQUIRE(bytes.find("I like ") == bytes.rfind("I like "));
+
+        auto loaded = Ast();
+        REQUIRE(Reader(blocks).Read(bytes.data(), bytes.data() + bytes.size(), loaded, error));
+        REQUIRE(dump(loaded) == dump(residual));
+        REQUIRE(render(loaded) == render(nodes));
+    }
+
+    SECTION("Empty")
+    {
+        const auto bytes = write(Ast());
+        REQUIRE(bytes.size() == sizeof(Header));
+
+        auto loaded = nodes;
+        REQUIRE(Reader().Read(bytes.data(), bytes.data() + bytes.size(), loaded, error));
+        REQUIRE(loaded.size() == 0);
+        REQUIRE(loaded.Names().size() == Interner::Keywords);
+    }
+
+    SECTION("Invalid files")
+    {
+        const auto bytes = write(nodes);
+        auto read = [&](const std::string &file, const BlockRegistry *registry = nullptr) {
+            error.str(std::string());
+            auto loaded = nodes;
+            auto reader = registry == nullptr ? Reader() : Reader(*registry);
+            REQUIRE_FALSE(reader.Read(file.data(), file.data() + file.size(), loaded, error));
+            REQUIRE(loaded.size() == 0);
+            return error.str();
+        };
+        auto header = [&](std::string file, size_t offset, uint32_t value) {
+            std::memcpy(&file[offset], &value, sizeof(value));
+            return file;
+        };
+
+        REQUIRE(read(bytes.substr(0, 10)) == "Compiled template is truncated.\n");
+        REQUIRE(read(bytes.substr(0, bytes.size() - 1), &blocks) == "Compiled template is truncated.\n");
+        REQUIRE(read(bytes + "!", &blocks) == "Compiled template is truncated.\n");
+        REQUIRE(read("X" + bytes.substr(1), &blocks) == "Not a compiled template.\n");
+        REQUIRE(read(header(bytes, offsetof(Header, byteOrder), 0x04030201), &blocks) ==
+                "Compiled template has another byte order.\n");
+        REQUIRE(read(header(bytes, offsetof(Header, version), 99), &blocks) == "Compiled template has version 99, expected 1.\n");
+        REQUIRE(read(bytes) == "Block `twice` is not registered.\n");
+
+        // Children of a block precede it, the records follow the header.
+        auto file = bytes;
+        auto record = Record();
+        auto loop = sizeof(Header);
+        for (;; loop += sizeof(Record))
+        {
+            std::memcpy(&record, &file[loop], sizeof(record));
+            if (record.type == static_cast<uint8_t>(NodeData::Type::Loop))
+            {
+                break;
+            }
+        }
+        record.first = 0;
+        record.count = 1000;
+        std::memcpy(&file[loop], &record, sizeof(record));
+        REQUIRE(read(file, &blocks) == "Compiled template has an invalid node.\n");
+
+        // Symbols are interned names.
+        record.count = 1;
+        record.symbols[1] = 1000;
+        std::memcpy(&file[loop], &record, sizeof(record));
+        REQUIRE(read(file, &blocks) == "Compiled template has an invalid node.\n");
+
+        record.type = 100;
+        std::memcpy(&file[loop], &record, sizeof(record));
+        REQUIRE(read(file, &blocks) == "Compiled template has an invalid node.\n");
+
+        // Names are unique.
+        auto names = Ast();
+        names.AddPrint("a", Context(0, 1));
+        names.AddPrint("b", Context(1, 2));
+        file = write(names);
+        const auto b = file.rfind('b');
+        file[b] = 'a';
+        REQUIRE(read(file) == "Compiled template has invalid names.\n");
+    }
+}
+
+} // namespace car
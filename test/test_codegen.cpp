@@ -0,0 +1,161 @@
+#include "catch.hpp"
+
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "codegen.hpp"
+#include "lexer.hpp"
+#include "parser.hpp"
+#include "renderer.hpp"
+
+using car::codegen::FunctionName;
+using car::codegen::Generator;
+using car::lexer::Lexer;
+using car::lexer::Token;
+using car::parser::Ast;
+using car::parser::BlockRegistry;
+using car::parser::BlockType;
+using car::parser::Parser;
+using car::parser::ParserOptions;
+using car::renderer::Renderer;
+
+// Generated from the bundled examples by the Makefile.
+CARENDER_TEMPLATE(render_examples_fruits_template);
+CARENDER_TEMPLATE(render_examples_bottles_template);
+
+namespace car
+{
+
+namespace
+{
+
+Ast parseTemplate(Lexer &lexer, const std::string &text, const ParserOptions &options)
+{
+    std::stringstream error;
+    auto tokens = std::vector<Token>();
+    auto nodes = Ast();
+    REQUIRE(lexer.lex(text.data(), text.data() + text.size(), tokens, error));
+    REQUIRE(Parser(options).parse(tokens, nodes, error));
+    return nodes;
+}
+
+std::string generate(const std::string &text)
+{
+    std::stringstream output;
+    std::stringstream error;
+    auto lexer = Lexer();
+    auto nodes = parseTemplate(lexer, text, ParserOptions());
+    REQUIRE(Generator().Generate(nodes, "render_test", output, error));
+    REQUIRE(error.str().size() == 0);
+    return output.str();
+}
+
+} // namespace
+
+TEST_CASE("codegen::FunctionName", "[codegen]")
+{
+    REQUIRE(FunctionName("examples/fruits/template.car") == "render_examples_fruits_template");
+    REQUIRE(FunctionName("a-b.c/d") == "render_a_b_c_d");
+    REQUIRE(FunctionName("x") == "render_x");
+}
+
+TEST_CASE("Generator::Generate", "[codegen]")
+{
+    SECTION("Text")
+    {
+        auto source = generate("a\"b\\c?" "?=\n\t\x01\xff" "7");
+        REQUIRE(source.find("CARENDER_TEMPLATE(render_test)") != std::string::npos);
+        REQUIRE(source.find("output.append(\"a\\\"b\\\\c\\?\\?=\\n\\t\\001\\3777\", 13);") != std::string::npos);
+        REQUIRE(source.find("static const char *const names[] = {nullptr};") != std::string::npos);
+    }
+
+    SECTION("Blocks")
+    {
+        auto source = generate("{{#loop xs x}}{{#ifeq x y}}{{x}}{{/ifeq}}{{/loop}}");
+        REQUIRE(source.find("static const char *const names[] = {\"xs\", \"x\", \"y\"};") != std::string::npos);
+        REQUIRE(source.find("    for (const auto &element1 : *ranges[0])\n    {\n        values[1] = &element1;\n") != std::string::npos);
+        REQUIRE(source.find("        if (*values[1] == *values[2])\n        {\n") != std::string::npos);
+        REQUIRE(source.find("            output += *values[1];\n        }\n    }\n    values[1] = nullptr;\n") != std::string::npos);
+        REQUIRE(source.find("Redefined(error, names[1], \"[8, 50)\")") != std::string::npos);
+    }
+
+    SECTION("Registered block")
+    {
+        BlockRegistry blocks;
+        blocks.Register(BlockType{"plain", 0, nullptr, nullptr});
+        auto lexer = Lexer();
+        auto nodes = parseTemplate(lexer, "{{#plain}}a{{/plain}}", ParserOptions({}, blocks));
+
+        std::stringstream output;
+        std::stringstream error;
+        REQUIRE_FALSE(Generator().Generate(nodes, "render_test", output, error));
+        REQUIRE(error.str() == "Registered block `plain` cannot be generated.\n");
+    }
+}
+
+TEST_CASE("Generated templates", "[codegen]")
+{
+    auto symbols = std::unordered_map<std::string, std::string>();
+    auto rangeSymbols = std::unordered_map<std::string, std::vector<std::string>>();
+    std::string text;
+    std::string rendered;
+    std::stringstream error;
+    std::stringstream expected;
+    std::stringstream expectedError;
+
+    auto render = [&](const std::string &name) {
+        std::ifstream input("examples/" + name + "/template.car");
+        REQUIRE(input);
+        text.assign(std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>());
+
+        auto lexer = Lexer();
+        auto nodes = parseTemplate(lexer, text, ParserOptions());
+        auto renderer = Renderer(symbols, rangeSymbols, expected, expectedError);
+        for (auto const &n : nodes)
+        {
+            n.accept(renderer);
+        }
+        return !renderer.HasError();
+    };
+
+    SECTION("Fruits")
+    {
+        symbols = {{"name", "Donald"}, {"favorite", "pineapples"}};
+        rangeSymbols = {{"items", {"apples", "pineapples", "oranges"}}};
+        REQUIRE(render("fruits"));
+        REQUIRE(render_examples_fruits_template(symbols, rangeSymbols, rendered, error));
+        REQUIRE(rendered == expected.str());
+    }
+
+    SECTION("Bottles")
+    {
+        symbols = {{"name", "Donald"}};
+        rangeSymbols = {{"bottles", {"3", "2", "1"}}, {"hello", {"hi", "hello"}}};
+        auto result = render("bottles");
+        REQUIRE(render_examples_bottles_template(symbols, rangeSymbols, rendered, error) == result);
+        REQUIRE(rendered == expected.str());
+        REQUIRE(error.str() == expectedError.str());
+    }
+
+    SECTION("Errors")
+    {
+        symbols = {{"name", "Donald"}, {"item", "x"}};
+        rangeSymbols = {{"items", {"apples"}}};
+        REQUIRE_FALSE(render("fruits"));
+        REQUIRE_FALSE(render_examples_fruits_template(symbols, rangeSymbols, rendered, error));
+        REQUIRE(rendered == expected.str());
+        REQUIRE(error.str() == expectedError.str());
+
+        rendered.clear();
+        error.str(std::string());
+        symbols = {{"name", "Donald"}};
+        REQUIRE_FALSE(render_examples_fruits_template(symbols, rangeSymbols, rendered, error));
+        REQUIRE(error.str() == "Symbol not found: `favorite`\n");
+    }
+}
+
+} // namespace car
@@ -7,9 +7,11 @@ using Catch::Matchers::Equals;
 #include "lexer.hpp"
 
 using car::Context;
+using car::Interner;
 using car::lexer::Lexer;
 using car::lexer::Token;
 using car::lexer::TokenFactory;
+using car::lexer::TokenStream;
 
 namespace car
 {
@@ -486,4 +488,392 @@ Last line.)");
     };
 }
 
-} // namespace car
\ No newline at end of file
+TEST_CASE("Lexer::lex buffer", "[lexer]")
+{
+    std::stringstream streamError;
+    std::stringstream bufferError;
+    auto streamTokens = std::vector<Token>();
+    auto bufferTokens = std::vector<Token>();
+    auto streamLexer = Lexer();
+    auto bufferLexer = Lexer();
+
+#define ASSERT_SAME_AS_STREAM(text)                                                     \
+    std::string input(text);                                                            \
+    std::stringstream stream(input);                                                    \
+    auto streamResult = streamLexer.lex(stream, streamTokens, streamError);             \
+    auto bufferResult = bufferLexer.lex(input.data(), input.data() + input.size(),      \
+                                        bufferTokens, bufferError);                     \
+    REQUIRE(streamResult == bufferResult);                                              \
+    REQUIRE_THAT(bufferTokens, Equals(streamTokens));                                   \
+    REQUIRE(bufferError.str() == streamError.str());
+
+    SECTION("Empty")
+    {
+        ASSERT_SAME_AS_STREAM("")
+        REQUIRE(bufferTokens.size() == 0);
+    }
+
+    SECTION("Text")
+    {
+        ASSERT_SAME_AS_STREAM("lorem {ipsum} }} ")
+    }
+
+    SECTION("Directives")
+    {
+        ASSERT_SAME_AS_STREAM("abc {{#xy }}\ndef# {{  # zdg s1  asfa2   }} art {{/audi}}\n  \n ")
+    }
+
+    SECTION("Unclosed symbol")
+    {
+        ASSERT_SAME_AS_STREAM("{{x")
+        REQUIRE(bufferTokens[1] == TokenFactory::newSymbol("x", Context(-2, -1)));
+    }
+
+    SECTION("Unclosed keyword")
+    {
+        ASSERT_SAME_AS_STREAM("{{#mop")
+        REQUIRE(bufferTokens[2] == TokenFactory::newKeyword("mop", Context(3, -1)));
+    }
+
+    SECTION("Unexpected token")
+    {
+        ASSERT_SAME_AS_STREAM("{{x}")
+    }
+
+    SECTION("Block newline")
+    {
+        ASSERT_SAME_AS_STREAM("{{#bl}}\r\n{{/bl}}\n\n")
+    }
+
+#undef ASSERT_SAME_AS_STREAM
+}
+
+TEST_CASE("Lexer::lex zero-copy", "[lexer]")
+{
+    std::stringstream error;
+    auto lexer = Lexer();
+    auto tokens = std::vector<Token>();
+
+    SECTION("Values refer to the buffer")
+    {
+        std::string input = "Hello {{name}}{{#loop xs x}}!{{/loop}}";
+        REQUIRE(lexer.lex(input.data(), input.data() + input.size(), tokens, error));
+
+        REQUIRE(tokens.size() == 15);
+        for (const auto &token : tokens)
+        {
+            if (token.GetValue().size() > 0)
+            {
+                auto offset = token.GetValue().data() - input.data();
+                REQUIRE(offset == token.GetContext().StartPos());
+            }
+        }
+    }
+
+    SECTION("Values refer to the stream copy")
+    {
+        std::stringstream input("Hello {{name}}");
+        REQUIRE(lexer.lex(input, tokens, error));
+        input.str("");
+
+        std::vector<Token> expectedTokens = {
+            TokenFactory::newText("Hello ", Context(0, 6)),
+            TokenFactory::newStartDirective(Context(6, 8)),
+            TokenFactory::newSymbol("name", Context(8, 12)),
+            TokenFactory::newEndDirective(Context(12, 14)),
+        };
+        REQUIRE_THAT(tokens, Equals(expectedTokens));
+    }
+
+    SECTION("Symbol split by whitespace")
+    {
+        std::string input = "{{x  yz}}";
+        REQUIRE(lexer.lex(input.data(), input.data() + input.size(), tokens, error));
+
+        std::vector<Token> expectedTokens = {
+            TokenFactory::newStartDirective(Context(0, 2)),
+            TokenFactory::newSymbol("xyz", Context(4, 7)),
+            TokenFactory::newEndDirective(Context(7, 9)),
+        };
+        REQUIRE_THAT(tokens, Equals(expectedTokens));
+    }
+
+    REQUIRE(error.str().size() == 0);
+}
+
+TEST_CASE("Lexer::TokenStream", "[lexer]")
+{
+    std::stringstream error;
+    auto lexer = Lexer();
+    auto tokens = std::vector<Token>();
+    auto stream = TokenStream();
+
+#define ASSERT_SAME_AS_VECTOR()                            \
+    REQUIRE(stream.size() == tokens.size());               \
+    for (size_t i = 0; i < tokens.size(); i++)             \
+    {                                                      \
+        REQUIRE(stream.GetType(i) == tokens[i].GetType()); \
+        REQUIRE(stream[i] == tokens[i]);                   \
+    }
+
+    SECTION("Lexed")
+    {
+        std::string input = "abc {{#xy }}\ndef# {{  # zdg s1  asfa2   }} art {{/audi}}\n{{x  yz}}";
+        lexer.lex(input.data(), input.data() + input.size(), tokens, error);
+        lexer.lex(input.data(), input.data() + input.size(), stream, error);
+
+        ASSERT_SAME_AS_VECTOR()
+    }
+
+    SECTION("Lexed from stream")
+    {
+        std::stringstream input("{{#loop xs x}}\n{{x}}\n{{/loop}}\n");
+        lexer.lex(input, stream, error);
+        input.clear();
+        input.seekg(0);
+        lexer.lex(input, tokens, error);
+
+        ASSERT_SAME_AS_VECTOR()
+    }
+
+    SECTION("Pushed")
+    {
+        tokens = {
+            TokenFactory::newText("p", Context(0, 1)),
+            TokenFactory::newStartDirective(Context(1, 3)),
+            TokenFactory::newSymbol("x", Context(-2, -1)),
+            Token(Token::Type::EndDirective, Context(3, 5), "}}"),
+        };
+        for (const auto &token : tokens)
+        {
+            stream.push_back(token);
+        }
+
+        ASSERT_SAME_AS_VECTOR()
+    }
+
+    SECTION("Compact")
+    {
+        auto input = std::string(1000, 'x') + "{{x}}";
+        for (int i = 0; i < 10; i++)
+        {
+            input += input;
+        }
+        lexer.lex(input.data(), input.data() + input.size(), stream, error);
+        lexer.lex(input.data(), input.data() + input.size(), tokens, error);
+
+        ASSERT_SAME_AS_VECTOR()
+        REQUIRE(stream.MemoryUsage() * 3 < tokens.size() * sizeof(Token));
+    }
+
+    SECTION("Reset")
+    {
+        std::string input = "{{x}}";
+        lexer.lex(input.data(), input.data() + input.size(), stream, error);
+        stream.reset(nullptr, nullptr);
+
+        REQUIRE(stream.size() == 0);
+    }
+
+    REQUIRE(error.str() == "");
+
+#undef ASSERT_SAME_AS_VECTOR
+}
+
+TEST_CASE("Lexer::lex interning", "[lexer]")
+{
+    std::stringstream error;
+    auto lexer = Lexer();
+    auto tokens = std::vector<Token>();
+    auto stream = TokenStream();
+
+    std::string input = "{{#loop xs x}}{{x}}{{#ifeq x  y}}{{x}}{{/ifeq}}{{/loop}}{{x  y}}";
+    REQUIRE(lexer.lex(input.data(), input.data() + input.size(), tokens, error));
+    REQUIRE(lexer.lex(input.data(), input.data() + input.size(), stream, error));
+
+    SECTION("Keywords have fixed ids")
+    {
+        REQUIRE(tokens[2].GetId() == Interner::Loop);
+        REQUIRE(tokens[11].GetId() == Interner::IfEq);
+        REQUIRE(stream.GetId(2) == Interner::Loop);
+        REQUIRE(stream.GetId(11) == Interner::IfEq);
+    }
+
+    SECTION("Equal symbols have equal ids")
+    {
+        REQUIRE(tokens.size() == stream.size());
+        for (size_t i = 0; i < tokens.size(); i++)
+        {
+            auto type = tokens[i].GetType();
+            if (type == Token::Type::Symbol || type == Token::Type::Keyword)
+            {
+                REQUIRE(lexer.Names().Name(tokens[i].GetId()) == std::string(tokens[i].GetValue()));
+                REQUIRE(stream.Names().Name(stream.GetId(i)) == std::string(tokens[i].GetValue()));
+            }
+            else
+            {
+                REQUIRE(tokens[i].GetId() == Interner::None);
+                REQUIRE(stream.GetId(i) == Interner::None);
+            }
+        }
+
+        REQUIRE(stream.Names().size() == 6);
+        REQUIRE(stream.Names().Find("xy") == stream.GetId(stream.size() - 2));
+        REQUIRE(stream.Names().Find("z") == Interner::None);
+    }
+
+    SECTION("Interner")
+    {
+        auto names = Interner();
+        auto x = names.Intern("x");
+        REQUIRE(names.Intern(std::string("x")) == x);
+        REQUIRE(names.Intern("loop") == Interner::Loop);
+
+        auto copy = names;
+        REQUIRE(copy.Find("x") == x);
+        REQUIRE(copy.Intern("y") == names.Intern("y"));
+    }
+
+    REQUIRE(error.str().size() == 0);
+}
+
+TEST_CASE("Lexer::feed", "[lexer]")
+{
+    auto inputs = std::vector<std::string>{
+        "",
+        "abc",
+        "{{x}}",
+        "a{{x}}b{{ y }}c",
+        "a{b{{{x}}}}{",
+        "a{b{{{x}}}}{{{y}}{{z}}",
+        "{{x}}{{y}}\n{{#loop xs x}}{{/loop}}{{z}}",
+        "{{#loop xs x}}\r\n{{x}}\n{{/loop}}\n\ntext",
+        "abc {{#xy }}\ndef# {{  # zdg s1  asfa2   }} art {{/audi}}\n{{x  yz}}",
+        "{{#ifeq x y}}{{x}}{{/ifeq}}{{",
+        "{{x}",
+        "a {{ } }} b {{c}}",
+        "{{#loop xs x}}{{x}}",
+    };
+
+    for (const auto &input : inputs)
+    {
+        std::stringstream expectedError;
+        auto expectedTokens = std::vector<Token>();
+        auto lexer = Lexer();
+        auto expectedResult = lexer.lex(input.data(), input.data() + input.size(), expectedTokens, expectedError);
+
+        std::stringstream expected;
+        for (const auto &token : expectedTokens)
+        {
+            expected << token << std::endl;
+        }
+
+        for (size_t size = 1; size <= input.size() + 1; size++)
+        {
+            INFO("input `" << input << "` in chunks of " << size);
+
+            // Token values are only valid until the next call, they are printed as they are returned.
+            std::stringstream error;
+            std::stringstream actual;
+            auto tokens = std::vector<Token>();
+            for (size_t i = 0; i < input.size(); i += size)
+            {
+                tokens.clear();
+                lexer.feed(input.data() + i, input.data() + std::min(i + size, input.size()), tokens);
+                for (const auto &token : tokens)
+                {
+                    actual << token << std::endl;
+                }
+            }
+            tokens.clear();
+            auto result = lexer.finish(tokens, error);
+            for (const auto &token : tokens)
+            {
+                actual << token << std::endl;
+            }
+
+            REQUIRE(result == expectedResult);
+            REQUIRE(actual.str() == expected.str());
+            REQUIRE(error.str() == expectedError.str());
+        }
+    }
+}
+
+TEST_CASE("Lexer::feed bounded", "[lexer]")
+{
+    auto lexer = Lexer();
+    auto tokens = std::vector<Token>();
+    std::stringstream error;
+    const std::string chunk = "Hello {{name}}, {{#loop items item}}{{item}} {{/loop}}\n";
+
+    size_t count = 0;
+    for (int i = 0; i < 1000; i++)
+    {
+        tokens.clear();
+        lexer.feed(chunk.data(), chunk.data() + chunk.size(), tokens);
+        count += tokens.size();
+        for (const auto &token : tokens)
+        {
+            REQUIRE(token.GetContext().EndPos() <= static_cast<int>(chunk.size() * (i + 1)));
+            if (token.GetType() == Token::Type::Symbol)
+            {
+                REQUIRE(lexer.Names().Name(token.GetId()) == std::string(token.GetValue()));
+            }
+        }
+    }
+    tokens.clear();
+    REQUIRE(lexer.finish(tokens, error));
+    count += tokens.size();
+
+    REQUIRE(count == 1000 * 19);
+    REQUIRE(lexer.Names().size() == 5);
+    REQUIRE(error.str() == "");
+}
+
+TEST_CASE("Lexer::lex parallel", "[lexer]")
+{
+    auto inputs = std::vector<std::string>{
+        "",
+        "abc",
+        "a{{x}}b{{ y }}c{{z}}d{{w}}",
+        "a{b{{{x}}}}{{{y}}{{z}}",
+        "a{{x}}.{{y}}}{{z}}.{{{w}}}.{{v}}",
+        "{{#loop xs x}}\r\n{{x}}\n{{/loop}}\n\ntext{{#loop xs x}}\n{{x}}\n{{/loop}}\n",
+        "abc {{#xy }}\ndef# {{  # zdg s1  asfa2   }} art {{/audi}}\n{{x  yz}}{{y}}",
+        "{{ a{{b }}{{ c{{d }}{{e}}{{ f{{g }}",
+        "{{#ifeq x y}}{{x}}{{/ifeq}}{{",
+        "{{x}{{y}}{{z}}",
+        "a {{x}} b {{ } }} c {{y}} d {{z}}",
+    };
+
+    for (const auto &input : inputs)
+    {
+        std::stringstream expectedError;
+        auto expectedTokens = std::vector<Token>();
+        auto expectedLexer = Lexer();
+        auto expectedResult = expectedLexer.lex(input.data(), input.data() + input.size(), expectedTokens, expectedError);
+
+        for (unsigned threads = 1; threads <= 8; threads++)
+        {
+            INFO("input `" << input << "` on " << threads << " threads");
+
+            std::stringstream error;
+            auto lexer = Lexer();
+            auto tokens = std::vector<Token>();
+            auto result = lexer.lex(input.data(), input.data() + input.size(), tokens, error, threads);
+
+            REQUIRE(result == expectedResult);
+            REQUIRE_THAT(tokens, Equals(expectedTokens));
+            REQUIRE(error.str() == expectedError.str());
+            for (const auto &token : tokens)
+            {
+                if (token.GetType() == Token::Type::Symbol || token.GetType() == Token::Type::Keyword)
+                {
+                    REQUIRE(lexer.Names().Name(token.GetId()) == std::string(token.GetValue()));
+                }
+            }
+        }
+    }
+}
+
+} // namespace car
@@ -0,0 +1,208 @@
+#include "catch.hpp"
+
+#if __cplusplus >= 201703L
+
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include "lexer.hpp"
+#include "literal.hpp"
+#include "parser.hpp"
+#include "renderer.hpp"
+
+using car::lexer::Lexer;
+using car::lexer::Token;
+using car::literal::IfEq;
+using car::literal::IsValid;
+using car::literal::Loop;
+using car::literal::NodeList;
+using car::literal::Print;
+using car::literal::Text;
+using car::parser::Ast;
+using car::parser::Parser;
+using car::parser::ParserOptions;
+using car::renderer::Renderer;
+
+CARENDER_LITERAL(Empty, "");
+CARENDER_LITERAL(Hello, "Hello {{name}}!");
+CARENDER_LITERAL(Fruits, "Hello {{name}},\n"
+                         "\n"
+                         "{{#loop items item}}\n"
+                         "I like {{item}}{{#ifeq item favorite}} very much{{/ifeq}}.\n"
+                         "{{/loop}}\n"
+                         "\n"
+                         "Cheers!\n");
+CARENDER_LITERAL(Nested, "{{#loop items i}}{{#loop digits d}}{{i}}{{d}} {{/loop}}{{/loop}}");
+CARENDER_LITERAL(Whitespace, "{{  name }}{{n ame}}{{#loop  items   i \t}}\r\n[{{ i}}]{{/loop}}\n{{#ifeq name name}}\n!{{/ifeq}}\r\n.");
+CARENDER_LITERAL(Braces, "a{b}c}}{{{name}}{ {{name}}");
+CARENDER_LITERAL(Keywords, "{{loop}}{{#loop ifeq loop}}{{loop}}{{/loop}}");
+CARENDER_LITERAL(MissingSymbol, "a{{missing}}b");
+CARENDER_LITERAL(MissingRange, "a{{#loop missing m}}x{{/loop}}");
+CARENDER_LITERAL(MissingLeft, "{{#ifeq missing name}}x{{/ifeq}}");
+CARENDER_LITERAL(MissingRight, "{{#ifeq name missing}}x{{/ifeq}}");
+CARENDER_LITERAL(Redefined, "{{#loop items name}}x{{/loop}}");
+CARENDER_LITERAL(RedefinedNested, "{{#loop items i}}{{#loop digits i}}x{{/loop}}{{/loop}}");
+CARENDER_LITERAL(OutOfScope, "{{#loop items i}}{{i}}{{/loop}}{{i}}");
+CARENDER_LITERAL(EmptyRange, "a{{#loop empty e}}{{missing}}{{/loop}}b");
+
+// Templates that do not parse, using them is a compile error.
+CARENDER_LITERAL(NoChildren, "{{#loop items i}}{{/loop}}");
+CARENDER_LITERAL(NotClosed, "{{#ifeq a b}}x");
+CARENDER_LITERAL(WrongClose, "{{#ifeq a b}}x{{/loop}}");
+CARENDER_LITERAL(NotOpen, "x{{/loop}}");
+CARENDER_LITERAL(Unsupported, "{{#plain}}x{{/plain}}");
+CARENDER_LITERAL(OneSymbol, "{{#loop items}}x{{/loop}}");
+CARENDER_LITERAL(TwoSymbols, "{{a b c}}");
+CARENDER_LITERAL(DirectiveNotClosed, "{{name");
+CARENDER_LITERAL(BlockNotClosed, "{{#loop a b");
+CARENDER_LITERAL(UnexpectedBrace, "{{#}}");
+CARENDER_LITERAL(MissingKeyword, "{{/}}");
+
+namespace car
+{
+
+namespace
+{
+
+/**
+* Renders the literal template `T` and its text with a Renderer, their output and errors must be the same.
+*/
+template <typename T>
+void requireSameAsRenderer(const std::unordered_map<std::string, std::string> &symbols,
+                           const std::unordered_map<std::string, std::vector<std::string>> &rangeSymbols)
+{
+    const auto text = std::string(T::Text());
+    std::stringstream error;
+    auto lexer = Lexer();
+    auto tokens = std::vector<Token>();
+    auto nodes = Ast();
+    REQUIRE(lexer.lex(text.data(), text.data() + text.size(), tokens, error));
+    REQUIRE(Parser(ParserOptions()).parse(tokens, nodes, error));
+
+    std::stringstream expected;
+    std::stringstream expectedError;
+    auto renderer = Renderer(symbols, rangeSymbols, expected, expectedError);
+    for (auto const &n : nodes)
+    {
+        n.accept(renderer);
+    }
+
+    std::string rendered;
+    std::stringstream renderedError;
+    REQUIRE(T::Render(symbols, rangeSymbols, rendered, renderedError) == !renderer.HasError());
+    REQUIRE(rendered == expected.str());
+    REQUIRE(renderedError.str() == expectedError.str());
+}
+
+} // namespace
+
+TEST_CASE("literal::Template::Nodes", "[literal]")
+{
+    static_assert(std::is_same<Empty::Nodes, NodeList<>>::value, "");
+    static_assert(std::is_same<Hello::Nodes, NodeList<Text<HelloSource, 0, 6>, Print<0>, Text<HelloSource, 14, 1>>>::value, "");
+    static_assert(std::is_same<Nested::Nodes,
+                               NodeList<Loop<0, 1, 8, 64,
+                                             NodeList<Loop<2, 3, 25, 55,
+                                                           NodeList<Print<1>, Print<3>, Text<NestedSource, 45, 1>>>>>>>::value,
+                  "");
+    static_assert(std::is_same<Keywords::Nodes,
+                               NodeList<Print<0>, Loop<1, 0, 16, 44, NodeList<Print<0>>>>>::value,
+                  "");
+    static_assert(Hello::SymbolCount() == 1 && Fruits::SymbolCount() == 4 && Empty::SymbolCount() == 0, "");
+    static_assert(std::is_same<MissingLeft::Nodes, NodeList<IfEq<0, 1, NodeList<Text<MissingLeftSource, 22, 1>>>>>::value, "");
+}
+
+TEST_CASE("literal::IsValid", "[literal]")
+{
+    static_assert(IsValid<FruitsSource>::value && IsValid<WhitespaceSource>::value && IsValid<BracesSource>::value, "");
+    static_assert(!IsValid<NoChildrenSource>::value, "");
+    static_assert(!IsValid<NotClosedSource>::value, "");
+    static_assert(!IsValid<WrongCloseSource>::value, "");
+    static_assert(!IsValid<NotOpenSource>::value, "");
+    static_assert(!IsValid<UnsupportedSource>::value, "");
+    static_assert(!IsValid<OneSymbolSource>::value, "");
+    static_assert(!IsValid<TwoSymbolsSource>::value, "");
+    static_assert(!IsValid<DirectiveNotClosedSource>::value, "");
+    static_assert(!IsValid<BlockNotClosedSource>::value, "");
+    static_assert(!IsValid<UnexpectedBraceSource>::value, "");
+    static_assert(!IsValid<MissingKeywordSource>::value, "");
+
+    // The parser rejects the same templates.
+    for (auto text : {NoChildrenSource::Text(), NotClosedSource::Text(), WrongCloseSource::Text(), NotOpenSource::Text(),
+                      UnsupportedSource::Text(), OneSymbolSource::Text(), TwoSymbolsSource::Text(),
+                      DirectiveNotClosedSource::Text(), BlockNotClosedSource::Text(), UnexpectedBraceSource::Text(),
+                      MissingKeywordSource::Text()})
+    {
+        std::stringstream error;
+        auto lexer = Lexer();
+        auto tokens = std::vector<Token>();
+        auto nodes = Ast();
+        REQUIRE_FALSE((lexer.lex(text.data(), text.data() + text.size(), tokens, error) &&
+                       Parser(ParserOptions()).parse(tokens, nodes, error)));
+    }
+}
+
+TEST_CASE("literal::Template::Render", "[literal]")
+{
+    auto symbols = std::unordered_map<std::string, std::string>(
+        {{"name", "Donald"}, {"favorite", "pineapples"}, {"{name", "{"}, {"loop", "L"}});
+    auto rangeSymbols = std::unordered_map<std::string, std::vector<std::string>>(
+        {{"items", {"apples", "pineapples", "oranges"}}, {"digits", {"1", "2"}}, {"empty", {}}, {"ifeq", {"a", "b"}}});
+
+    SECTION("Text and symbols")
+    {
+        requireSameAsRenderer<Empty>(symbols, rangeSymbols);
+        requireSameAsRenderer<Hello>(symbols, rangeSymbols);
+        requireSameAsRenderer<Braces>(symbols, rangeSymbols);
+        requireSameAsRenderer<Keywords>(symbols, rangeSymbols);
+    }
+
+    SECTION("Blocks")
+    {
+        requireSameAsRenderer<Fruits>(symbols, rangeSymbols);
+        requireSameAsRenderer<Nested>(symbols, rangeSymbols);
+        requireSameAsRenderer<EmptyRange>(symbols, rangeSymbols);
+    }
+
+    SECTION("Whitespace")
+    {
+        symbols["name"] = "n";
+        symbols["n"] = "-";
+        requireSameAsRenderer<Whitespace>(symbols, rangeSymbols);
+    }
+
+    SECTION("Errors")
+    {
+        requireSameAsRenderer<MissingSymbol>(symbols, rangeSymbols);
+        requireSameAsRenderer<MissingRange>(symbols, rangeSymbols);
+        requireSameAsRenderer<MissingLeft>(symbols, rangeSymbols);
+        requireSameAsRenderer<MissingRight>(symbols, rangeSymbols);
+        requireSameAsRenderer<Redefined>(symbols, rangeSymbols);
+        requireSameAsRenderer<RedefinedNested>(symbols, rangeSymbols);
+        requireSameAsRenderer<OutOfScope>(symbols, rangeSymbols);
+        requireSameAsRenderer<Hello>({}, rangeSymbols);
+    }
+
+    SECTION("Appends")
+    {
+        std::string rendered = ">";
+        std::stringstream error;
+        REQUIRE(Hello::Render(symbols, rangeSymbols, rendered, error));
+        REQUIRE(rendered == ">Hello Donald!");
+    }
+
+#if __cpp_nontype_template_args >= 201911L
+    SECTION("Template arguments")
+    {
+        using Literal = car::literal::Literal<"{{#loop items i}}{{i}},{{/loop}}">;
+        requireSameAsRenderer<Literal>(symbols, rangeSymbols);
+    }
+#endif
+}
+
+} // namespace car
+
+#endif // __cplusplus >= 201703L
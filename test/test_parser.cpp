@@ -1,7 +1,9 @@
 #include "catch.hpp"
 using Catch::Matchers::Equals;
 
+#include <cstdlib>
 #include <iostream>
+#include <new>
 #include <sstream>
 #include "context.hpp"
 #include "lexer.hpp"
@@ -9,13 +11,54 @@ using Catch::Matchers::Equals;
 #include "printingvisitor.hpp"
 
 using car::Context;
+using car::Interner;
 using car::lexer::Lexer;
 using car::lexer::Token;
 using car::lexer::TokenFactory;
-using car::parser::Node;
+using car::parser::Ast;
+using car::parser::BlockNode;
+using car::parser::BlockRegistry;
+using car::parser::BlockType;
+using car::parser::IfEqNode;
+using car::parser::LoopNode;
+using car::parser::NodeRange;
 using car::parser::Parser;
 using car::parser::ParserOptions;
+using car::parser::PrintNode;
 using car::parser::PrintingVisitor;
+using car::parser::TextNode;
+using car::parser::Visitor;
+
+namespace
+{
+// Heap allocations made by the test binary while counting is enabled.
+bool isCountingAllocations = false;
+size_t allocations = 0;
+} // namespace
+
+void *operator new(std::size_t size)
+{
+    if (isCountingAllocations)
+    {
+        allocations++;
+    }
+
+    if (auto p = std::malloc(size == 0 ? 1 : size))
+    {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept
+{
+    std::free(p);
+}
 
 namespace car
 {
@@ -48,7 +91,7 @@ TEST_CASE("Parser::parse no symbol check", "[parser]")
     std::stringstream lexerError;
     std::stringstream dump;
     auto tokens = std::vector<Token>();
-    std::vector<std::unique_ptr<Node>> nodes;
+    auto nodes = Ast();
     auto lexer = Lexer();
     bool parserSuccess;
     auto symbols = std::unordered_set<std::string>();
@@ -182,7 +225,7 @@ TEST_CASE("Parser::parse no symbol check", "[parser]")
 
         for (auto const &n : nodes)
         {
-            n->accept(visitor);
+            n.accept(visitor);
         }
 
         expectedDump = "[TextNode `dinle`]\n";
@@ -203,7 +246,7 @@ TEST_CASE("Parser::parse no symbol check", "[parser]")
 
         for (auto const &n : nodes)
         {
-            n->accept(visitor);
+            n.accept(visitor);
         }
 
         expectedDump = "[PrintNode symbol`x`]\n";
@@ -382,7 +425,7 @@ TEST_CASE("Parser::parse no symbol check", "[parser]")
 
         for (auto const &n : nodes)
         {
-            n->accept(visitor);
+            n.accept(visitor);
         }
 
         expectedDump = "[LoopNode `elem` in `range1`] {\n  [TextNode `ABC`]\n}\n";
@@ -594,7 +637,7 @@ TEST_CASE("Parser::parse no symbol check", "[parser]")
 
         for (auto const &n : nodes)
         {
-            n->accept(visitor);
+            n.accept(visitor);
         }
 
         expectedDump = "[IfEqNode `left` `right`] {\n[TextNode `ABC`]\n}\n";
@@ -723,7 +766,7 @@ TEST_CASE("Parser::parse no symbol check", "[parser]")
 
         for (auto const &n : nodes)
         {
-            n->accept(visitor);
+            n.accept(visitor);
         }
 
         expectedDump = "[LoopNode `elem` in `range`] {\n  [TextNode ` `]\n  [IfEqNode `left` `right`] {\n  [TextNode `ABC`]\n}\n  [TextNode ` `]\n}\n";
@@ -895,7 +938,7 @@ TEST_CASE("Parser::parse symbol check", "[parser]")
     std::stringstream lexerError;
     std::stringstream dump;
     auto tokens = std::vector<Token>();
-    std::vector<std::unique_ptr<Node>> nodes;
+    auto nodes = Ast();
     auto lexer = Lexer();
     bool parserSuccess;
     auto options = ParserOptions(std::unordered_set<std::string>({"validus"}));
@@ -935,7 +978,7 @@ TEST_CASE("Parser::parse symbol check", "[parser]")
 
         for (auto const &n : nodes)
         {
-            n->accept(visitor);
+            n.accept(visitor);
         }
 
         expectedDump = "[PrintNode symbol`validus`]\n";
@@ -988,7 +1031,7 @@ TEST_CASE("Parser::parse symbol check", "[parser]")
 
         for (auto const &n : nodes)
         {
-            n->accept(visitor);
+            n.accept(visitor);
         }
 
         expectedDump = "[LoopNode `i` in `validus`] {\n  [TextNode `QED`]\n}\n";
@@ -1044,7 +1087,7 @@ TEST_CASE("Parser::parse symbol check", "[parser]")
 
         for (auto const &n : nodes)
         {
-            n->accept(visitor);
+            n.accept(visitor);
         }
 
         expectedDump = "[LoopNode `elem` in `validus`] {\n  [TextNode `  `]\n  [IfEqNode `elem` `elem`] {\n  [TextNode `ABC`]\n}\n  [TextNode ` `]\n}\n";
@@ -1053,4 +1096,347 @@ TEST_CASE("Parser::parse symbol check", "[parser]")
     }
 }
 
-} // namespace car
\ No newline at end of file
+namespace
+{
+
+bool hasOneChild(const BlockNode &node, std::ostream &error)
+{
+    if (node.Children().size() != 1)
+    {
+        error << node.Keyword() << " node must have one child." << std::endl;
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+TEST_CASE("Parser::parse registered blocks", "[parser]")
+{
+    std::stringstream error;
+    std::stringstream dump;
+    auto lexer = Lexer();
+    auto tokens = std::vector<Token>();
+    auto nodes = Ast();
+    auto visitor = PrintingVisitor(dump);
+    BlockRegistry blocks;
+    std::string expectedDump;
+    std::string expectedError;
+
+    REQUIRE(blocks.Register(BlockType{"ifne", 2, nullptr, nullptr}) != nullptr);
+    REQUIRE(blocks.Register(BlockType{"once", 0, hasOneChild, nullptr}) != nullptr);
+
+    auto parser = Parser(ParserOptions({"x", "y"}, blocks));
+
+    SECTION("Registry")
+    {
+        REQUIRE(blocks.Register(BlockType{"loop", 2, nullptr, nullptr}) == nullptr);
+        REQUIRE(blocks.Register(BlockType{"ifne", 1, nullptr, nullptr}) == nullptr);
+        REQUIRE(blocks.Register(BlockType{"three", 3, nullptr, nullptr}) == nullptr);
+        REQUIRE(blocks.Find("ifne")->symbols == 2);
+        REQUIRE(blocks.Find("once")->parse == hasOneChild);
+        REQUIRE(blocks.Find("ifeq") == nullptr);
+        REQUIRE(blocks.Find("three") == nullptr);
+    }
+
+    SECTION("Block")
+    {
+        std::stringstream input("{{#ifne x y}}a{{#once}}{{x}}{{/once}}{{/ifne}}");
+        REQUIRE(lexer.lex(input, tokens, error));
+        REQUIRE(parser.parse(tokens, nodes, error));
+
+        for (auto const &n : nodes)
+        {
+            n.accept(visitor);
+        }
+
+        expectedDump = "[BlockNode `ifne` `x` `y`] {\n[TextNode `a`]\n[BlockNode `once`] {\n[PrintNode symbol`x`]\n}\n}\n";
+        ASSERT_RESULTS()
+    }
+
+    SECTION("Invalid symbol")
+    {
+        std::stringstream input("{{#ifne x z}}a{{/ifne}}");
+        REQUIRE(lexer.lex(input, tokens, error));
+        REQUIRE_FALSE(parser.parse(tokens, nodes, error));
+
+        expectedError = "Invalid symbol [Symbol at [10, 11)] 'z'\nCannot parse at [StartDirective at [0, 2)]\n";
+        ASSERT_RESULTS()
+    }
+
+    SECTION("Parse hook")
+    {
+        std::stringstream input("{{#ifne x y}}{{#once}}a{{x}}{{/once}}{{/ifne}}");
+        REQUIRE(lexer.lex(input, tokens, error));
+        REQUIRE_FALSE(parser.parse(tokens, nodes, error));
+        REQUIRE(nodes.size() == 0);
+
+        expectedError = "once node must have one child.\nifne node must have children.\nCannot parse at [StartDirective at [0, 2)]\n";
+        ASSERT_RESULTS()
+    }
+
+    SECTION("Not registered")
+    {
+        std::stringstream input("{{#ifne x y}}a{{/ifne}}");
+        REQUIRE(lexer.lex(input, tokens, error));
+        REQUIRE_FALSE(Parser(ParserOptions({"x", "y"})).parse(tokens, nodes, error));
+
+        expectedError = "Unsupported keyword `ifne` at [3, 7)\nCannot parse at [StartDirective at [0, 2)]\n";
+        ASSERT_RESULTS()
+    }
+}
+
+TEST_CASE("Parser::parse TokenSource", "[parser]")
+{
+    auto symbols = std::unordered_set<std::string>{"validus", "x"};
+
+    auto large = std::string("{{#loop validus elem}}");
+    for (auto i = 0; i < 2000; i++)
+    {
+        large += "a{{x}}b{{#ifeq elem x}}c{{/ifeq}}";
+    }
+    large += "{{/loop}}";
+
+    auto inputs = std::vector<std::string>{
+        "",
+        "text only",
+        "{{x}",
+        "{{#loop validus elem}}",
+        "{{#loop validus elem}} {{#ifeq left right}}ABC{{/ifeq}} {{/loop}}",
+        "{{#loop validus elem}}  {{#ifeq elem elem}}ABC{{/ifeq}} {{/loop}}",
+        "{{x}}{{y}}",
+        large,
+        large + "{{#loop}}",
+    };
+
+    for (const auto &input : inputs)
+    {
+        // Parsing tokens pulled in any window gives the same nodes and errors as parsing all tokens.
+        std::stringstream expectedError;
+        std::stringstream expectedDump;
+        auto expectedVisitor = PrintingVisitor(expectedDump);
+        auto lexer = Lexer();
+        auto tokens = car::lexer::TokenStream();
+        auto lexed = lexer.lex(input.data(), input.data() + input.size(), tokens, expectedError);
+        auto expectedNodes = Ast();
+        auto parser = Parser(ParserOptions(symbols));
+        auto expectedSuccess = parser.parse(tokens, expectedNodes, expectedError) && lexed;
+        for (auto const &n : expectedNodes)
+        {
+            n.accept(expectedVisitor);
+        }
+
+        for (const size_t window : {1, 3, 16, 1 << 16})
+        {
+            std::stringstream error;
+            std::stringstream dump;
+            auto visitor = PrintingVisitor(dump);
+            auto sourceLexer = Lexer();
+            auto source = car::lexer::BufferTokenSource(sourceLexer, input.data(), input.data() + input.size(), window);
+            auto nodes = Ast();
+            auto success = parser.parse(source, nodes, error) && !source.HasError();
+            for (auto const &n : nodes)
+            {
+                n.accept(visitor);
+            }
+
+            REQUIRE(success == expectedSuccess);
+            REQUIRE(error.str() == expectedError.str());
+            REQUIRE(dump.str() == expectedDump.str());
+        }
+    }
+}
+
+TEST_CASE("Parser::Ast", "[parser]")
+{
+    std::stringstream dump;
+    auto visitor = PrintingVisitor(dump);
+    auto nodes = Ast();
+
+    nodes.AddText("A", Context(0, 1));
+    nodes.OpenLoop("xs", "x");
+    nodes.AddPrint("x", Context(15, 20));
+    nodes.OpenIfEq("x", "y");
+    nodes.AddText("B", Context(35, 36));
+    nodes.Close(Context(20, 46));
+    nodes.Close(Context(1, 55));
+    nodes.AddPrint("y", Context(55, 60));
+
+    REQUIRE(nodes.size() == 3);
+    REQUIRE(nodes.Names().Find("x") != Interner::None);
+
+    for (auto const &n : nodes)
+    {
+        n.accept(visitor);
+    }
+
+    REQUIRE(dump.str() == "[TextNode `A`]\n[LoopNode `x` in `xs`] {\n  [PrintNode symbol`x`]\n  [IfEqNode `x` `y`] {\n  [TextNode `B`]\n}\n}\n[PrintNode symbol`y`]\n");
+
+    SECTION("Parse replaces the nodes")
+    {
+        auto symbols = std::unordered_set<std::string>();
+        auto parser = Parser(ParserOptions(symbols));
+        auto lexer = Lexer();
+        auto tokens = std::vector<Token>();
+        std::stringstream error;
+        std::stringstream input("{{#loop xs x}}{{x}}{{/loop}}");
+        lexer.lex(input, tokens, error);
+
+        REQUIRE(parser.parse(tokens, nodes, error));
+        REQUIRE(nodes.size() == 1);
+        REQUIRE((*nodes.begin()).Ctx() == Context(8, 28));
+        REQUIRE(nodes.Names().Find("y") == Interner::None);
+    }
+
+    SECTION("Loop invariants")
+    {
+        BlockRegistry blocks;
+        const auto &plain = *blocks.Register(BlockType{"plain", 1, nullptr, nullptr});
+        const auto &hook = *blocks.Register(BlockType{"hook", 0, nullptr, [](const BlockNode &, car::parser::BlockScope &) {
+                                                          return true;
+                                                      }});
+        nodes.clear();
+        nodes.OpenLoop("xs", "x");
+        nodes.AddText("a", Context(0, 1));
+        nodes.AddPrint("y", Context(0, 1));
+        nodes.AddPrint("x", Context(0, 1));
+        nodes.OpenIfEq("y", "y");
+        nodes.OpenLoop("ys", "z");
+        nodes.AddPrint("x", Context(0, 1));
+        nodes.Close(Context(0, 1));
+        nodes.Close(Context(0, 1));
+        nodes.OpenLoop("ys", "z");
+        nodes.AddPrint("z", Context(0, 1));
+        nodes.Close(Context(0, 1));
+        nodes.OpenLoop("x", "y");
+        nodes.AddText("b", Context(0, 1));
+        nodes.Close(Context(0, 1));
+        nodes.OpenLoop("ys", "x");
+        nodes.AddText("c", Context(0, 1));
+        nodes.Close(Context(0, 1));
+        nodes.OpenBlock(plain, "y");
+        nodes.AddText("d", Context(0, 1));
+        nodes.Close(Context(0, 1));
+        nodes.OpenBlock(hook);
+        nodes.AddText("e", Context(0, 1));
+        nodes.Close(Context(0, 1));
+        nodes.Close(Context(0, 1));
+        nodes.AddPrint("x", Context(0, 1));
+
+        // Children that use the element of the loop, also in nested blocks or to check it is not defined, vary.
+        auto children = std::vector<const car::parser::NodeData *>();
+        auto invariants = std::vector<bool>();
+        for (const auto &n : BlockNode(nodes, (*nodes.begin()).Data()).Children())
+        {
+            children.push_back(&n.Data());
+            invariants.push_back(n.Data().isInvariant);
+        }
+        REQUIRE(invariants == std::vector<bool>({true, true, false, false, true, true, false, true, false}));
+        REQUIRE_FALSE((*BlockNode(nodes, *children[4]).Children().begin()).Data().isInvariant);
+    }
+}
+
+TEST_CASE("Parser::parse steady state", "[parser]")
+{
+    auto input = std::string();
+    for (auto i = 0; i < 100; i++)
+    {
+        input += "a{{x}}{{#loop validus elem}}b{{#ifeq elem x}}{{elem}}{{/ifeq}}{{/loop}}";
+    }
+
+    std::stringstream error;
+    auto lexer = Lexer();
+    auto tokens = car::lexer::TokenStream();
+    REQUIRE(lexer.lex(input.data(), input.data() + input.size(), tokens, error));
+
+    auto parser = Parser(ParserOptions({"validus", "x"}));
+    auto nodes = Ast();
+    REQUIRE(parser.parse(tokens, nodes, error));
+
+    // Parsing again with the same parser into the same tree reuses their storage.
+    isCountingAllocations = true;
+    auto parsed = parser.parse(tokens, nodes, error);
+    isCountingAllocations = false;
+
+    REQUIRE(parsed);
+    REQUIRE(nodes.size() == 300);
+    REQUIRE(allocations == 0);
+}
+
+TEST_CASE("Parser::parse deep nesting", "[parser]")
+{
+    const auto depth = 100000;
+    auto input = std::string();
+    for (auto i = 0; i < depth; i++)
+    {
+        input += "{{#ifeq x x}}";
+    }
+    input += "a";
+    auto closed = input;
+    for (auto i = 0; i < depth; i++)
+    {
+        closed += "{{/ifeq}}";
+    }
+
+    std::stringstream error;
+    auto lexer = Lexer();
+    auto parser = Parser(ParserOptions({"x"}));
+    auto nodes = Ast();
+
+    SECTION("Closed")
+    {
+        auto tokens = car::lexer::TokenStream();
+        REQUIRE(lexer.lex(closed.data(), closed.data() + closed.size(), tokens, error));
+        REQUIRE(parser.parse(tokens, nodes, error));
+        REQUIRE(error.str().size() == 0);
+        REQUIRE(nodes.size() == 1);
+
+        // Descend without recursion, each block has a single child.
+        struct Descender : public Visitor
+        {
+            explicit Descender(const NodeRange &children) : children(children) {}
+
+            void visit(const TextNode &n) override { this->text = std::string(n.Text()); }
+            void visit(const PrintNode &) override {}
+            void visit(const LoopNode &) override {}
+            void visit(const IfEqNode &n) override { this->children = n.Children(); }
+            void visit(const BlockNode &) override {}
+
+            NodeRange children;
+            std::string text;
+        };
+
+        auto descender = Descender(nodes.Roots());
+        auto levels = 0;
+        while (descender.text.empty())
+        {
+            REQUIRE(descender.children.size() == 1);
+            (*descender.children.begin()).accept(descender);
+            levels++;
+        }
+        REQUIRE(levels == depth + 1);
+        REQUIRE(descender.text == "a");
+    }
+
+    SECTION("Unclosed")
+    {
+        auto tokens = car::lexer::TokenStream();
+        REQUIRE(lexer.lex(input.data(), input.data() + input.size(), tokens, error));
+        REQUIRE_FALSE(parser.parse(tokens, nodes, error));
+        REQUIRE(nodes.size() == 0);
+
+        // Each enclosing block reports its children, the error is reported at the outermost block.
+        auto errors = error.str();
+        auto reports = 0;
+        for (auto it = errors.find("ifeq node must have children."); it != std::string::npos; it = errors.find("ifeq node must have children.", it + 1))
+        {
+            reports++;
+        }
+        REQUIRE(reports == depth - 1);
+        auto last = std::string("Cannot parse at [StartDirective at [0, 2)]\n");
+        REQUIRE(errors.find("Unexpected EOF after [Text at ") == 0);
+        REQUIRE(errors.substr(errors.size() - last.size()) == last);
+    }
+}
+
+} // namespace car
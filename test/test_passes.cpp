@@ -0,0 +1,453 @@
+#include "catch.hpp"
+
+#include <memory>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "lexer.hpp"
+#include "parser.hpp"
+#include "passes.hpp"
+#include "renderer.hpp"
+
+using car::lexer::Lexer;
+using car::lexer::Token;
+using car::parser::Ast;
+using car::parser::BlockNode;
+using car::parser::BlockRegistry;
+using car::parser::BlockScope;
+using car::parser::BlockType;
+using car::parser::NodeData;
+using car::parser::Parser;
+using car::parser::ParserOptions;
+using car::passes::AddStandardPasses;
+using car::passes::Assumptions;
+using car::passes::FoldIfEq;
+using car::passes::MergeText;
+using car::passes::PassManager;
+using car::passes::RemoveEmpty;
+using car::passes::Specializer;
+using car::renderer::Renderer;
+
+namespace car
+{
+
+namespace
+{
+
+using Symbols = std::unordered_map<std::string, std::string>;
+using RangeSymbols = std::unordered_map<std::string, std::vector<std::string>>;
+
+bool renderTwice(const BlockNode &, BlockScope &scope)
+{
+    scope.RenderChildren();
+    scope.RenderChildren();
+    return true;
+}
+
+Assumptions assume(const Symbols &symbols, const RangeSymbols &rangeSymbols)
+{
+    auto assumptions = Assumptions();
+    for (const auto &pair : symbols)
+    {
+        assumptions.symbols.insert(pair.first);
+    }
+    for (const auto &pair : rangeSymbols)
+    {
+        assumptions.rangeSymbols.insert(pair.first);
+    }
+    assumptions.isExhaustive = true;
+    return assumptions;
+}
+
+Ast parseTemplate(Lexer &lexer, const std::string &text, const BlockRegistry &blocks)
+{
+    std::stringstream error;
+    auto tokens = std::vector<Token>();
+    auto nodes = Ast();
+    REQUIRE(lexer.lex(text.data(), text.data() + text.size(), tokens, error));
+    REQUIRE(Parser(ParserOptions({}, blocks)).parse(tokens, nodes, error));
+    return nodes;
+}
+
+std::string render(const Ast &nodes, const Symbols &symbols, const RangeSymbols &rangeSymbols)
+{
+    std::stringstream output;
+    auto renderer = Renderer(symbols, rangeSymbols, output, output);
+    for (const auto &n : nodes)
+    {
+        n.accept(renderer);
+    }
+    return output.str() + (renderer.HasError() ? "<error>" : "");
+}
+
+size_t count(const Ast &nodes)
+{
+    size_t result = 0;
+    auto pending = std::vector<parser::NodeRange>{nodes.Roots()};
+    while (!pending.empty())
+    {
+        auto range = pending.back();
+        pending.pop_back();
+        for (const auto &n : range)
+        {
+            result++;
+            if (n.Data().type != NodeData::Type::Text && n.Data().type != NodeData::Type::Print)
+            {
+                pending.push_back(BlockNode(nodes, n.Data()).Children());
+            }
+        }
+    }
+    return result;
+}
+
+/**
+* Rewrites `text` with every combination of the standard passes, the output and errors of the rewritten trees must
+* be the ones of the parsed tree. Returns the number of changes with all passes.
+*/
+size_t requireSameOutput(const std::string &text, const Symbols &symbols, const RangeSymbols &rangeSymbols,
+                         const Assumptions &assumptions, const BlockRegistry &blocks = BlockRegistry())
+{
+    auto lexer = Lexer();
+    const auto expected = render(parseTemplate(lexer, text, blocks), symbols, rangeSymbols);
+
+    size_t changes = 0;
+    const char *names[] = {"fold-ifeq", "remove-empty", "merge-text"};
+    for (auto mask = 0; mask < 8; mask++)
+    {
+        auto passes = PassManager();
+        AddStandardPasses(passes, assumptions);
+        for (auto i = 0; i < 3; i++)
+        {
+            REQUIRE(passes.Enable(names[i], (mask & (1 << i)) != 0));
+        }
+
+        auto nodes = parseTemplate(lexer, text, blocks);
+        changes = passes.Run(nodes);
+        REQUIRE(render(nodes, symbols, rangeSymbols) == expected);
+    }
+    return changes;
+}
+
+/**
+* Specializes `text` for the static symbols and renders the residual tree with each set of dynamic symbols,
+* the output and errors must be the ones of the parsed tree. Returns the number of nodes of the residual tree.
+*/
+size_t requireSameResidual(const std::string &text, const Symbols &symbols, const RangeSymbols &rangeSymbols,
+                           const std::vector<Symbols> &requests, const RangeSymbols &requestRanges = RangeSymbols(),
+                           const BlockRegistry &blocks = BlockRegistry())
+{
+    auto assumptions = assume(requests.empty() ? Symbols() : requests[0], requestRanges);
+    auto lexer = Lexer();
+    const auto nodes = parseTemplate(lexer, text, blocks);
+
+    auto residual = nodes;
+    auto passes = PassManager();
+    passes.Add(std::unique_ptr<car::passes::Pass>(new Specializer(symbols, rangeSymbols, assumptions)));
+    AddStandardPasses(passes, assumptions);
+    passes.Run(residual);
+
+    auto specialized = nodes;
+    passes.Enable("fold-ifeq", false);
+    passes.Enable("remove-empty", false);
+    passes.Enable("merge-text", false);
+    passes.Run(specialized);
+
+    for (auto request : requests)
+    {
+        auto requestRangeSymbols = requestRanges;
+        request.insert(symbols.begin(), symbols.end());
+        requestRangeSymbols.insert(rangeSymbols.begin(), rangeSymbols.end());
+
+        const auto expected = render(nodes, request, requestRangeSymbols);
+        REQUIRE(render(specialized, request, requestRangeSymbols) == expected);
+        REQUIRE(render(residual, request, requestRangeSymbols) == expected);
+    }
+    return count(residual);
+}
+
+} // namespace
+
+TEST_CASE("passes::PassManager", "[passes]")
+{
+    auto symbols = Symbols({{"name", "Donald"}, {"favorite", "pineapples"}});
+    auto rangeSymbols = RangeSymbols({{"items", {"apples", "pineapples", "oranges"}}, {"empty", {}}});
+    auto lexer = Lexer();
+
+    SECTION("Reports")
+    {
+        auto passes = PassManager();
+        AddStandardPasses(passes, assume(symbols, rangeSymbols));
+        const auto text = std::string("a{{#ifeq name name}}b{{name}}c{{#ifeq name name}}d{{/ifeq}}{{/ifeq}}e");
+        auto nodes = parseTemplate(lexer, text, BlockRegistry());
+        REQUIRE(passes.Run(nodes) == 5);
+        REQUIRE(passes.Reports().size() == 3);
+
+        std::stringstream reports;
+        for (const auto &report : passes.Reports())
+        {
+            reports << report << std::endl;
+        }
+        REQUIRE(reports.str() == "fold-ifeq: 2 changes\nremove-empty: 0 changes\nmerge-text: 3 changes\n");
+
+        // ab, name and cde are left.
+        REQUIRE(count(nodes) == 3);
+        REQUIRE(render(nodes, symbols, rangeSymbols) == "abDonaldcde");
+    }
+
+    SECTION("Switches")
+    {
+        auto passes = PassManager();
+        AddStandardPasses(passes, assume(symbols, rangeSymbols));
+        REQUIRE_FALSE(passes.Enable("unknown", false));
+        REQUIRE(passes.Enable("fold-ifeq", false));
+
+        const auto text = std::string("a{{#ifeq name name}}b{{/ifeq}}c");
+        auto nodes = parseTemplate(lexer, text, BlockRegistry());
+        REQUIRE(passes.Run(nodes) == 0);
+        REQUIRE(passes.Reports().size() == 2);
+        REQUIRE(passes.Reports()[0].name == "remove-empty");
+        REQUIRE(count(nodes) == 4);
+
+        REQUIRE(passes.Enable("fold-ifeq", true));
+        REQUIRE(passes.Run(nodes) == 3);
+        REQUIRE(count(nodes) == 1);
+        REQUIRE(render(nodes, symbols, rangeSymbols) == "abc");
+    }
+
+    SECTION("Text is kept")
+    {
+        // Merged text is owned by the tree, which is copied and moved with it.
+        auto passes = PassManager();
+        AddStandardPasses(passes, assume(symbols, rangeSymbols));
+        auto nodes = Ast();
+        {
+            auto text = std::string("a{{#ifeq name name}}b{{/ifeq}}c{{name}}");
+            nodes = parseTemplate(lexer, text, BlockRegistry());
+            passes.Run(nodes);
+        }
+        auto copy = nodes;
+        nodes.clear();
+        REQUIRE(render(copy, symbols, rangeSymbols) == "abcDonald");
+    }
+}
+
+TEST_CASE("passes::FoldIfEq", "[passes]")
+{
+    auto symbols = Symbols({{"name", "Donald"}, {"favorite", "pineapples"}});
+    auto rangeSymbols = RangeSymbols({{"items", {"apples", "pineapples", "oranges"}}, {"empty", {}}});
+    const auto assumptions = assume(symbols, rangeSymbols);
+
+    SECTION("Defined symbols")
+    {
+        REQUIRE(requireSameOutput("{{#ifeq name name}}x{{/ifeq}}", symbols, rangeSymbols, assumptions) == 1);
+        REQUIRE(requireSameOutput("{{#loop items i}}{{#ifeq i i}}{{i}}{{/ifeq}}{{/loop}}", symbols, rangeSymbols, Assumptions()) == 1);
+        REQUIRE(requireSameOutput("{{#ifeq name favorite}}x{{/ifeq}}", symbols, rangeSymbols, assumptions) == 0);
+    }
+
+    SECTION("Undefined symbols")
+    {
+        // Rendering fails, the ifeq is kept.
+        REQUIRE(requireSameOutput("a{{#ifeq missing missing}}x{{/ifeq}}", symbols, rangeSymbols, assumptions) == 0);
+        REQUIRE(requireSameOutput("a{{#ifeq name name}}x{{/ifeq}}", Symbols(), rangeSymbols, Assumptions()) == 0);
+        REQUIRE(requireSameOutput("{{#loop items i}}x{{/loop}}{{#ifeq i i}}x{{/ifeq}}", symbols, rangeSymbols, assumptions) == 0);
+    }
+
+    SECTION("Deep nesting")
+    {
+        const auto depth = 100000;
+        auto text = std::string();
+        for (auto i = 0; i < depth; i++)
+        {
+            text += "{{#ifeq name name}}a";
+        }
+        for (auto i = 0; i < depth; i++)
+        {
+            text += "{{/ifeq}}";
+        }
+
+        auto lexer = Lexer();
+        auto nodes = parseTemplate(lexer, text, BlockRegistry());
+        auto passes = PassManager();
+        AddStandardPasses(passes, assumptions);
+        REQUIRE(passes.Run(nodes) == 2 * depth - 1);
+        REQUIRE(count(nodes) == 1);
+        REQUIRE(render(nodes, symbols, rangeSymbols) == std::string(depth, 'a'));
+    }
+}
+
+TEST_CASE("passes::RemoveEmpty", "[passes]")
+{
+    auto symbols = Symbols({{"name", "Donald"}, {"favorite", "pineapples"}});
+    auto rangeSymbols = RangeSymbols({{"items", {"apples", "pineapples", "oranges"}}, {"empty", {}}});
+    const auto assumptions = assume(symbols, rangeSymbols);
+    BlockRegistry blocks;
+    blocks.Register(BlockType{"plain", 1, nullptr, nullptr});
+    blocks.Register(BlockType{"twice", 0, nullptr, renderTwice});
+
+    // Empty blocks are only built with the Ast, the parser requires children.
+    auto build = [&](const BlockType *type, string_view first, string_view second) {
+        auto nodes = Ast();
+        nodes.AddText("a", Context(0, 1));
+        if (type != nullptr)
+        {
+            nodes.OpenBlock(*type, first);
+        }
+        else if (first == "items" || first == "missing" || first == "empty")
+        {
+            nodes.OpenLoop(first, second);
+        }
+        else
+        {
+            nodes.OpenIfEq(first, second);
+        }
+        nodes.AddText("", Context(1, 1));
+        nodes.Close(Context(1, 1));
+        nodes.AddText("b", Context(1, 2));
+        return nodes;
+    };
+
+    auto run = [&](Ast nodes, const Assumptions &assumptions) {
+        const auto expected = render(nodes, symbols, rangeSymbols);
+        auto passes = PassManager();
+        AddStandardPasses(passes, assumptions);
+        passes.Run(nodes);
+        REQUIRE(render(nodes, symbols, rangeSymbols) == expected);
+        return count(nodes);
+    };
+
+    // The empty text is removed, then the block if rendering it cannot fail, then the text is merged.
+    REQUIRE(run(build(nullptr, "name", "favorite"), assumptions) == 1);
+    REQUIRE(run(build(nullptr, "name", "missing"), assumptions) == 3);
+    REQUIRE(run(build(nullptr, "items", "i"), assumptions) == 1);
+    REQUIRE(run(build(nullptr, "empty", "i"), assumptions) == 1);
+    REQUIRE(run(build(nullptr, "missing", "i"), assumptions) == 3);
+    REQUIRE(run(build(nullptr, "items", "name"), assumptions) == 3);
+    REQUIRE(run(build(nullptr, "items", "i"), Assumptions()) == 3);
+    REQUIRE(run(build(blocks.Find("plain"), "name", ""), assumptions) == 1);
+    REQUIRE(run(build(blocks.Find("plain"), "missing", ""), assumptions) == 3);
+    REQUIRE(run(build(blocks.Find("twice"), "", ""), assumptions) == 3);
+}
+
+TEST_CASE("passes::MergeText", "[passes]")
+{
+    auto symbols = Symbols({{"name", "Donald"}, {"favorite", "pineapples"}});
+    auto rangeSymbols = RangeSymbols({{"items", {"apples", "pineapples", "oranges"}}, {"digits", {"1", "2"}}});
+    const auto assumptions = assume(symbols, rangeSymbols);
+    BlockRegistry blocks;
+    blocks.Register(BlockType{"twice", 1, nullptr, renderTwice});
+
+    SECTION("Templates")
+    {
+        requireSameOutput("", symbols, rangeSymbols, assumptions);
+        requireSameOutput("Hello {{name}}!", symbols, rangeSymbols, assumptions);
+        requireSameOutput("Hello {{name}},\n\n{{#loop items item}}\nI like {{item}}{{#ifeq item favorite}} very much{{/ifeq}}.\n"
+                          "{{/loop}}\n\nCheers!",
+                          symbols, rangeSymbols, assumptions);
+        requireSameOutput("{{#loop items i}}<{{#ifeq i i}}{{#loop digits d}}[{{#ifeq d d}}{{d}}{{/ifeq}}]{{/loop}}{{/ifeq}}>{{/loop}}",
+                          symbols, rangeSymbols, assumptions);
+        requireSameOutput("{{#twice name}}a{{#ifeq name name}}b{{/ifeq}}{{/twice}}c", symbols, rangeSymbols, assumptions, blocks);
+    }
+
+    SECTION("Errors")
+    {
+        requireSameOutput("a{{#ifeq name name}}b{{missing}}{{/ifeq}}c", symbols, rangeSymbols, assumptions);
+        requireSameOutput("a{{#loop items name}}b{{/loop}}c", symbols, rangeSymbols, assumptions);
+        requireSameOutput("{{#loop items i}}{{#ifeq i i}}{{#loop digits i}}x{{/loop}}{{/ifeq}}{{/loop}}", symbols, rangeSymbols, assumptions);
+        requireSameOutput("{{#twice missing}}a{{/twice}}", symbols, rangeSymbols, assumptions, blocks);
+    }
+
+    SECTION("Contiguous text")
+    {
+        // Text that follows in memory is not copied.
+        auto nodes = Ast();
+        const auto text = std::string("abc");
+        nodes.AddText(string_view(text.data(), 1), Context(0, 1));
+        nodes.AddText(string_view(text.data() + 1, 2), Context(1, 3));
+
+        auto output = Ast();
+        REQUIRE(MergeText(Assumptions()).Run(nodes, output) == 1);
+        REQUIRE(output.size() == 1);
+        const auto merged = (*output.begin()).Data();
+        REQUIRE(merged.text == text.data());
+        REQUIRE(merged.count == 3);
+        REQUIRE(merged.ctx == Context(0, 3));
+    }
+}
+
+TEST_CASE("passes::Specializer", "[passes]")
+{
+    auto symbols = Symbols({{"name", "Donald"}, {"favorite", "pineapples"}});
+    auto rangeSymbols = RangeSymbols({{"items", {"apples", "pineapples", "oranges"}}, {"digits", {"1", "2"}}, {"empty", {}}});
+    auto requests = std::vector<Symbols>({{{"greeting", "Hi"}, {"other", "apples"}}, {{"greeting", "Bye"}, {"other", "kiwis"}}});
+    const auto fruits = std::string("Hello {{name}},\n\n{{#loop items item}}\nI like {{item}}{{#ifeq item favorite}} very much"
+                                    "{{/ifeq}}.\n{{/loop}}\n\nCheers!");
+
+    SECTION("Static symbols")
+    {
+        REQUIRE(requireSameResidual("Hello {{name}}!", symbols, rangeSymbols, requests) == 1);
+        REQUIRE(requireSameResidual(fruits, symbols, rangeSymbols, requests) == 1);
+        REQUIRE(requireSameResidual("{{#loop items i}}{{#loop digits d}}{{i}}{{d}}{{#ifeq d favorite}}!{{/ifeq}}{{/loop}}{{/loop}}",
+                                    symbols, rangeSymbols, requests) == 1);
+        REQUIRE(requireSameResidual("a{{#loop empty i}}{{i}}{{/loop}}b", symbols, rangeSymbols, requests) == 1);
+    }
+
+    SECTION("Dynamic symbols")
+    {
+        // The residual tree is the text around the dynamic symbols.
+        REQUIRE(requireSameResidual("{{greeting}} {{name}}!", symbols, rangeSymbols, requests) == 2);
+        REQUIRE(requireSameResidual("{{#loop items i}}{{greeting}} {{i}}{{/loop}}", symbols, rangeSymbols, requests) == 6);
+        REQUIRE(requireSameResidual("{{#ifeq name greeting}}x{{name}}{{/ifeq}}", symbols, rangeSymbols, requests) == 2);
+
+        // Loops whose element is compared with a dynamic symbol are kept, as are elements of nested loops.
+        REQUIRE(requireSameResidual("{{#loop items i}}{{#ifeq i other}}{{i}}{{/ifeq}}{{/loop}}", symbols, rangeSymbols, requests) == 3);
+        REQUIRE(requireSameResidual("{{#loop items i}}{{#loop digits d}}{{#ifeq i d}}x{{/ifeq}}{{/loop}}{{/loop}}", symbols,
+                                    rangeSymbols, requests) == 4);
+
+        // Loops over dynamic ranges are kept, their children are specialized.
+        REQUIRE(requireSameResidual("{{#loop letters l}}{{l}}{{name}}{{#loop digits d}}{{d}}{{/loop}}{{/loop}}", symbols, rangeSymbols,
+                                    requests, RangeSymbols({{"letters", {"a", "b"}}})) == 3);
+
+        // Nothing is unrolled if the element may be a dynamic symbol.
+        REQUIRE(requireSameResidual("{{#loop items i}}{{i}}{{/loop}}", symbols, rangeSymbols, requests) == 1);
+        auto assumptions = Assumptions();
+        auto passes = PassManager();
+        passes.Add(std::unique_ptr<car::passes::Pass>(new Specializer(symbols, rangeSymbols, assumptions)));
+        const auto text = std::string("{{#loop items i}}{{i}}{{/loop}}{{name}}");
+        auto lexer = Lexer();
+        auto nodes = parseTemplate(lexer, text, BlockRegistry());
+        REQUIRE(passes.Run(nodes) == 1);
+        REQUIRE(count(nodes) == 3);
+    }
+
+    SECTION("Errors")
+    {
+        requireSameResidual("a{{missing}}b{{name}}", symbols, rangeSymbols, requests);
+        requireSameResidual("a{{#loop missing i}}{{i}}{{/loop}}{{name}}", symbols, rangeSymbols, requests);
+        requireSameResidual("a{{#loop items name}}{{name}}{{/loop}}", symbols, rangeSymbols, requests);
+        requireSameResidual("a{{#loop items greeting}}{{greeting}}{{/loop}}", symbols, rangeSymbols, requests);
+        requireSameResidual("{{#loop items i}}{{i}}{{#loop digits i}}{{i}}{{/loop}}{{/loop}}", symbols, rangeSymbols, requests);
+        requireSameResidual("{{#loop items i}}{{i}}{{/loop}}{{i}}", symbols, rangeSymbols, requests);
+        requireSameResidual("{{#ifeq name missing}}x{{/ifeq}}", symbols, rangeSymbols, requests);
+        requireSameResidual("{{#loop items i}}{{#ifeq i missing}}x{{/ifeq}}{{/loop}}", symbols, rangeSymbols, requests);
+    }
+
+    SECTION("Registered blocks")
+    {
+        BlockRegistry blocks;
+        blocks.Register(BlockType{"plain", 1, nullptr, nullptr});
+        blocks.Register(BlockType{"twice", 1, nullptr, renderTwice});
+
+        REQUIRE(requireSameResidual("{{#plain name}}{{name}}{{/plain}}", symbols, rangeSymbols, requests, RangeSymbols(), blocks) == 1);
+        REQUIRE(requireSameResidual("{{#plain greeting}}{{name}}{{/plain}}", symbols, rangeSymbols, requests, RangeSymbols(), blocks) == 2);
+        REQUIRE(requireSameResidual("{{#twice name}}{{name}}{{/twice}}", symbols, rangeSymbols, requests, RangeSymbols(), blocks) == 2);
+        REQUIRE(requireSameResidual("{{#loop items i}}{{#plain i}}{{i}}{{/plain}}{{/loop}}", symbols, rangeSymbols, requests,
+                                    RangeSymbols(), blocks) == 1);
+        REQUIRE(requireSameResidual("{{#loop items i}}{{#twice i}}{{i}}{{/twice}}{{/loop}}", symbols, rangeSymbols, requests,
+                                    RangeSymbols(), blocks) == 3);
+        requireSameResidual("{{#plain missing}}{{name}}{{/plain}}", symbols, rangeSymbols, requests, RangeSymbols(), blocks);
+    }
+}
+
+} // namespace car
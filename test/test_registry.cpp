@@ -0,0 +1,167 @@
+#include "catch.hpp"
+
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "lexer.hpp"
+#include "parser.hpp"
+#include "registry.hpp"
+#include "renderer.hpp"
+
+using car::lexer::Lexer;
+using car::lexer::Token;
+using car::parser::Ast;
+using car::parser::BlockNode;
+using car::parser::BlockRegistry;
+using car::parser::BlockScope;
+using car::parser::BlockType;
+using car::parser::NodeData;
+using car::parser::NodeRange;
+using car::parser::Parser;
+using car::parser::ParserOptions;
+using car::registry::TemplateRegistry;
+using car::renderer::Renderer;
+
+namespace car
+{
+
+namespace
+{
+
+bool renderTwice(const BlockNode &, BlockScope &scope)
+{
+    scope.RenderChildren();
+    scope.RenderChildren();
+    return true;
+}
+
+Ast parseTemplate(const std::string &text, const BlockRegistry &blocks)
+{
+    std::stringstream error;
+    auto tokens = std::vector<Token>();
+    auto nodes = Ast();
+    REQUIRE(Lexer().lex(text.data(), text.data() + text.size(), tokens, error));
+    REQUIRE(Parser(ParserOptions({}, blocks)).parse(tokens, nodes, error));
+    return nodes;
+}
+
+std::string render(const NodeRange &roots)
+{
+    const auto symbols = std::unordered_map<std::string, std::string>({{"name", "Aragorn"}, {"favorite", "b"}});
+    const auto rangeSymbols = std::unordered_map<std::string, std::vector<std::string>>({{"items", {"a", "b", "c"}}});
+    std::stringstream output;
+    auto renderer = Renderer(symbols, rangeSymbols, output, output);
+    for (const auto &n : roots)
+    {
+        n.accept(renderer);
+    }
+    return output.str();
+}
+
+} // namespace
+
+TEST_CASE("TemplateRegistry", "[registry]")
+{
+    BlockRegistry blocks;
+    blocks.Register(BlockType{"twice", 0, nullptr, renderTwice});
+    const auto header = std::string("Legal text, all rights reserved.\n{{#loop items item}}{{item}}{{#ifeq item favorite}}!{{/ifeq}}{{/loop}}\n");
+    const auto templates = std::vector<std::string>({
+        header + "Hello {{name}}.{{#twice}}-{{/twice}}",
+        header + "Bye {{name}}.",
+        "Dear {{name}}, " + header,
+        // Elements are redefined, the errors refer to the loops of each template.
+        "{{#loop items name}}.{{/loop}}",
+        "..{{#loop items name}}.{{/loop}}",
+    });
+
+    SECTION("Rendered")
+    {
+        for (auto isSharing : {true, false})
+        {
+            TemplateRegistry registry(isSharing);
+            auto trees = std::vector<Ast>();
+            for (size_t i = 0; i < templates.size(); i++)
+            {
+                trees.push_back(parseTemplate(templates[i], blocks));
+                registry.Add(std::to_string(i), trees.back());
+            }
+
+            for (size_t i = 0; i < templates.size(); i++)
+            {
+                REQUIRE(render(registry.Find(std::to_string(i))) == render(trees[i].Roots()));
+            }
+            REQUIRE(render(registry.Find("3")) == "Symbol names must be unique across the program, redefined `name` at [8, 30)\n");
+            REQUIRE(render(registry.Find("4")) == "..Symbol names must be unique across the program, redefined `name` at [10, 32)\n");
+            REQUIRE(registry.Find("none").size() == 0);
+        }
+    }
+
+    SECTION("Shared")
+    {
+        TemplateRegistry registry;
+        TemplateRegistry copies(false);
+        for (size_t i = 0; i < templates.size(); i++)
+        {
+            const auto nodes = parseTemplate(templates[i], blocks);
+            registry.Add(std::to_string(i), nodes);
+            copies.Add(std::to_string(i), nodes);
+        }
+
+        // The children of the loops and of the ifeqs of the header are shared, and the children of the last two
+        // loops, which are not at the same position.
+        const auto shared = registry.Report();
+        const auto copied = copies.Report();
+        REQUIRE(shared.templates == 5);
+        REQUIRE(shared.nodes == copied.nodes);
+        REQUIRE(copied.storedNodes == copied.nodes);
+        REQUIRE(shared.storedNodes == shared.nodes - 7);
+        REQUIRE(shared.textBytes == copied.storedTextBytes);
+        // The legal text of the second template is shared, the third one has it in its first text.
+        REQUIRE(shared.storedTextBytes < shared.textBytes - header.find('\n'));
+        REQUIRE(copied.indexBytes == 0);
+        REQUIRE(shared.Saved() == static_cast<int64_t>(7 * sizeof(NodeData) + shared.textBytes - shared.storedTextBytes - shared.indexBytes));
+
+        std::stringstream report;
+        report << copied;
+        REQUIRE(report.str() == "templates: 5, nodes: " + std::to_string(copied.nodes) + " of " + std::to_string(copied.nodes) +
+                                    ", text bytes: " + std::to_string(copied.textBytes) + " of " + std::to_string(copied.textBytes) +
+                                    ", index bytes: 0, saved bytes: 0");
+
+        // Identical templates are stored once.
+        registry.Add("0", parseTemplate(templates[0], blocks));
+        REQUIRE(registry.Report().storedNodes == shared.storedNodes);
+        REQUIRE(registry.Report().templates == 6);
+
+        // Names are interned in the registry.
+        const auto &nodes = registry.Nodes();
+        const auto roots = registry.Find("1");
+        const auto &loop = (*++roots.begin()).Data();
+        REQUIRE(loop.type == NodeData::Type::Loop);
+        REQUIRE(nodes.Names().Name(loop.symbols[0]) == "items");
+        REQUIRE(render(roots) == render(parseTemplate(templates[1], blocks).Roots()));
+    }
+
+    SECTION("Deep nesting")
+    {
+        const auto depth = 100000;
+        auto input = std::string();
+        for (auto i = 0; i < depth; i++)
+        {
+            input += "{{#ifeq name name}}";
+        }
+        input += "{{name}}";
+        for (auto i = 0; i < depth; i++)
+        {
+            input += "{{/ifeq}}";
+        }
+
+        TemplateRegistry registry;
+        registry.Add("deep", parseTemplate(input, blocks));
+        REQUIRE(render(registry.Find("deep")) == "Aragorn");
+        REQUIRE(registry.Report().storedNodes == depth + 1);
+    }
+}
+
+} // namespace car
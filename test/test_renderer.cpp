@@ -11,12 +11,15 @@ using Catch::Matchers::Equals;
 using car::Context;
 using car::lexer::Lexer;
 using car::lexer::Token;
-using car::parser::LoopNode;
-using car::parser::Node;
+using car::parser::Ast;
+using car::parser::BlockNode;
+using car::parser::BlockRegistry;
+using car::parser::BlockScope;
+using car::parser::BlockType;
 using car::parser::Parser;
 using car::parser::ParserOptions;
-using car::parser::PrintNode;
 using car::renderer::Renderer;
+using car::renderer::Slots;
 
 namespace car
 {
@@ -43,8 +46,9 @@ namespace car
         }                                          \
     }
 
-std::vector<std::unique_ptr<Node>>
-parseNodes(std::string text,
+Ast
+parseNodes(Lexer &lexer,
+           std::string text,
            const std::unordered_map<std::string, std::string> &symbols,
            const std::unordered_map<std::string, std::vector<std::string>> &rangeSymbols)
 {
@@ -61,8 +65,7 @@ parseNodes(std::string text,
     std::stringstream lexerError;
 
     auto tokens = std::vector<Token>();
-    std::vector<std::unique_ptr<Node>> nodes;
-    auto lexer = Lexer();
+    auto nodes = Ast();
     auto parser = Parser(ParserOptions(symbolNames));
 
     std::stringstream input(text);
@@ -87,17 +90,19 @@ TEST_CASE("Renderer", "[renderer]")
     auto rangeSymbols = std::unordered_map<std::string, std::vector<std::string>>();
 
     auto visitor = Renderer(symbols, rangeSymbols, dump, error);
+    // Nodes refer to the input copied by the lexer.
+    auto lexer = Lexer();
     std::string expectedDump;
     std::string expectedError;
 
     SECTION("Loop Text")
     {
         rangeSymbols["xs"] = {"x1", "x2", "x3"};
-        auto nodes = parseNodes("{{#loop xs x}}ABC{{/loop}}", symbols, rangeSymbols);
+        auto nodes = parseNodes(lexer, "{{#loop xs x}}ABC{{/loop}}", symbols, rangeSymbols);
         auto renderer = Renderer(symbols, rangeSymbols, dump, error);
         for (auto const &n : nodes)
         {
-            n->accept(renderer);
+            n.accept(renderer);
         }
 
         expectedError = "";
@@ -108,11 +113,11 @@ TEST_CASE("Renderer", "[renderer]")
     SECTION("Loop Text Symbol")
     {
         rangeSymbols["xs"] = {"x1", "x2", "x3"};
-        auto nodes = parseNodes("{{#loop xs x}}Let there be {{x}}!\n{{/loop}}", symbols, rangeSymbols);
+        auto nodes = parseNodes(lexer, "{{#loop xs x}}Let there be {{x}}!\n{{/loop}}", symbols, rangeSymbols);
         auto renderer = Renderer(symbols, rangeSymbols, dump, error);
         for (auto const &n : nodes)
         {
-            n->accept(renderer);
+            n.accept(renderer);
         }
 
         expectedError = "";
@@ -124,14 +129,15 @@ TEST_CASE("Renderer", "[renderer]")
     {
         rangeSymbols["xs"] = {"x1", "x2", "x3"};
         symbols["x"] = "this is X.";
-        std::vector<std::unique_ptr<Node>> nodes;
-        nodes.push_back(std::make_unique<PrintNode>(PrintNode("x", Context(0, 1))));
-        nodes.push_back(std::make_unique<LoopNode>(LoopNode("xs", "x", Context(10, 20))));
+        auto nodes = Ast();
+        nodes.AddPrint("x", Context(0, 1));
+        nodes.OpenLoop("xs", "x");
+        nodes.Close(Context(10, 20));
 
         auto renderer = Renderer(symbols, rangeSymbols, dump, error);
         for (auto const &n : nodes)
         {
-            n->accept(renderer);
+            n.accept(renderer);
         }
 
         expectedError = "Symbol names must be unique across the program, redefined `x` at [10, 20)\n";
@@ -142,14 +148,15 @@ TEST_CASE("Renderer", "[renderer]")
     {
         rangeSymbols["xs"] = {"x1", "x2", "x3"};
         symbols["x"] = "this is X.";
-        std::vector<std::unique_ptr<Node>> nodes;
-        nodes.push_back(std::make_unique<LoopNode>(LoopNode("x", "x", Context(1, 10))));
-        nodes.push_back(std::make_unique<PrintNode>(PrintNode("xs", Context(12, 19))));
+        auto nodes = Ast();
+        nodes.OpenLoop("x", "x");
+        nodes.Close(Context(1, 10));
+        nodes.AddPrint("xs", Context(12, 19));
 
         auto renderer = Renderer(symbols, rangeSymbols, dump, error);
         for (auto const &n : nodes)
         {
-            n->accept(renderer);
+            n.accept(renderer);
         }
 
         // Renderer does not continue on error, second error
@@ -160,11 +167,11 @@ TEST_CASE("Renderer", "[renderer]")
 
     SECTION("IfEq Text - no symbols")
     {
-        auto nodes = parseNodes("{{#ifeq x1 x2}}ABC{{/ifeq}}", symbols, rangeSymbols);
+        auto nodes = parseNodes(lexer, "{{#ifeq x1 x2}}ABC{{/ifeq}}", symbols, rangeSymbols);
         auto renderer = Renderer(symbols, rangeSymbols, dump, error);
         for (auto const &n : nodes)
         {
-            n->accept(renderer);
+            n.accept(renderer);
         }
 
         expectedError = "Symbol not found: `x1`\n";
@@ -176,11 +183,11 @@ TEST_CASE("Renderer", "[renderer]")
     {
         symbols["x1"] = "42";
         symbols["x2"] = "42";
-        auto nodes = parseNodes("{{#ifeq x1 x2}}ABC{{/ifeq}}", symbols, rangeSymbols);
+        auto nodes = parseNodes(lexer, "{{#ifeq x1 x2}}ABC{{/ifeq}}", symbols, rangeSymbols);
         auto renderer = Renderer(symbols, rangeSymbols, dump, error);
         for (auto const &n : nodes)
         {
-            n->accept(renderer);
+            n.accept(renderer);
         }
 
         expectedError = "";
@@ -192,11 +199,11 @@ TEST_CASE("Renderer", "[renderer]")
     {
         symbols["x1"] = "nope";
         symbols["x2"] = "42";
-        auto nodes = parseNodes("{{#ifeq x1 x2}}ABC{{/ifeq}}", symbols, rangeSymbols);
+        auto nodes = parseNodes(lexer, "{{#ifeq x1 x2}}ABC{{/ifeq}}", symbols, rangeSymbols);
         auto renderer = Renderer(symbols, rangeSymbols, dump, error);
         for (auto const &n : nodes)
         {
-            n->accept(renderer);
+            n.accept(renderer);
         }
 
         expectedError = "";
@@ -208,11 +215,11 @@ TEST_CASE("Renderer", "[renderer]")
     {
         symbols["x1"] = "42";
         symbols["x2"] = "42";
-        auto nodes = parseNodes("{{#ifeq x1 x2}}Let there be lux!{{/ifeq}}", symbols, rangeSymbols);
+        auto nodes = parseNodes(lexer, "{{#ifeq x1 x2}}Let there be lux!{{/ifeq}}", symbols, rangeSymbols);
         auto renderer = Renderer(symbols, rangeSymbols, dump, error);
         for (auto const &n : nodes)
         {
-            n->accept(renderer);
+            n.accept(renderer);
         }
 
         expectedError = "";
@@ -224,14 +231,15 @@ TEST_CASE("Renderer", "[renderer]")
     {
         symbols["x1"] = "42";
         symbols["x2"] = "42";
-        std::vector<std::unique_ptr<Node>> nodes;
-        nodes.push_back(std::make_unique<PrintNode>(PrintNode("x1", Context(0, 1))));
-        nodes.push_back(std::make_unique<IfEqNode>(IfEqNode("x1", "x2", Context(10, 20))));
+        auto nodes = Ast();
+        nodes.AddPrint("x1", Context(0, 1));
+        nodes.OpenIfEq("x1", "x2");
+        nodes.Close(Context(10, 20));
 
         auto renderer = Renderer(symbols, rangeSymbols, dump, error);
         for (auto const &n : nodes)
         {
-            n->accept(renderer);
+            n.accept(renderer);
         }
 
         expectedError = "";
@@ -242,14 +250,15 @@ TEST_CASE("Renderer", "[renderer]")
     SECTION("IfEq and Print")
     {
         symbols["x"] = "42";
-        std::vector<std::unique_ptr<Node>> nodes;
-        nodes.push_back(std::make_unique<IfEqNode>(IfEqNode("x", "x", Context(1, 10))));
-        nodes.push_back(std::make_unique<PrintNode>(PrintNode("x", Context(12, 19))));
+        auto nodes = Ast();
+        nodes.OpenIfEq("x", "x");
+        nodes.Close(Context(1, 10));
+        nodes.AddPrint("x", Context(12, 19));
 
         auto renderer = Renderer(symbols, rangeSymbols, dump, error);
         for (auto const &n : nodes)
         {
-            n->accept(renderer);
+            n.accept(renderer);
         }
 
         expectedDump = "42";
@@ -260,13 +269,14 @@ TEST_CASE("Renderer", "[renderer]")
     SECTION("IfEq - no rightSymbol")
     {
         symbols["x"] = "42";
-        std::vector<std::unique_ptr<Node>> nodes;
-        nodes.push_back(std::make_unique<IfEqNode>(IfEqNode("x", "x2", Context(1, 10))));
+        auto nodes = Ast();
+        nodes.OpenIfEq("x", "x2");
+        nodes.Close(Context(1, 10));
 
         auto renderer = Renderer(symbols, rangeSymbols, dump, error);
         for (auto const &n : nodes)
         {
-            n->accept(renderer);
+            n.accept(renderer);
         }
 
         expectedDump = "";
@@ -276,13 +286,13 @@ TEST_CASE("Renderer", "[renderer]")
 
     SECTION("Print - no symbol")
     {
-        std::vector<std::unique_ptr<Node>> nodes;
-        nodes.push_back(std::make_unique<PrintNode>(PrintNode("x", Context(12, 19))));
+        auto nodes = Ast();
+        nodes.AddPrint("x", Context(12, 19));
 
         auto renderer = Renderer(symbols, rangeSymbols, dump, error);
         for (auto const &n : nodes)
         {
-            n->accept(renderer);
+            n.accept(renderer);
         }
 
         expectedDump = "";
@@ -292,14 +302,14 @@ TEST_CASE("Renderer", "[renderer]")
 
     SECTION("Print - no symbol, Text")
     {
-        std::vector<std::unique_ptr<Node>> nodes;
-        nodes.push_back(std::make_unique<PrintNode>(PrintNode("x", Context(2, 9))));
-        nodes.push_back(std::make_unique<TextNode>(TextNode("ABC", Context(12, 19))));
+        auto nodes = Ast();
+        nodes.AddPrint("x", Context(2, 9));
+        nodes.AddText("ABC", Context(12, 19));
 
         auto renderer = Renderer(symbols, rangeSymbols, dump, error);
         for (auto const &n : nodes)
         {
-            n->accept(renderer);
+            n.accept(renderer);
         }
 
         expectedDump = "";
@@ -309,14 +319,15 @@ TEST_CASE("Renderer", "[renderer]")
 
     SECTION("Print - no symbol, Loop")
     {
-        std::vector<std::unique_ptr<Node>> nodes;
-        nodes.push_back(std::make_unique<PrintNode>(PrintNode("x", Context(2, 9))));
-        nodes.push_back(std::make_unique<LoopNode>(LoopNode("xs", "x", Context(10, 20))));
+        auto nodes = Ast();
+        nodes.AddPrint("x", Context(2, 9));
+        nodes.OpenLoop("xs", "x");
+        nodes.Close(Context(10, 20));
 
         auto renderer = Renderer(symbols, rangeSymbols, dump, error);
         for (auto const &n : nodes)
         {
-            n->accept(renderer);
+            n.accept(renderer);
         }
 
         expectedDump = "";
@@ -326,14 +337,15 @@ TEST_CASE("Renderer", "[renderer]")
 
     SECTION("Print - no symbol, IfEq")
     {
-        std::vector<std::unique_ptr<Node>> nodes;
-        nodes.push_back(std::make_unique<PrintNode>(PrintNode("x", Context(2, 9))));
-        nodes.push_back(std::make_unique<IfEqNode>(IfEqNode("x", "x2", Context(1, 10))));
+        auto nodes = Ast();
+        nodes.AddPrint("x", Context(2, 9));
+        nodes.OpenIfEq("x", "x2");
+        nodes.Close(Context(1, 10));
 
         auto renderer = Renderer(symbols, rangeSymbols, dump, error);
         for (auto const &n : nodes)
         {
-            n->accept(renderer);
+            n.accept(renderer);
         }
 
         expectedDump = "";
@@ -347,7 +359,7 @@ TEST_CASE("Renderer", "[renderer]")
         rangeSymbols["hello"] = {"hi", "hello", "nihao"};
         symbols["name"] = "Aragorn";
 
-        auto nodes = parseNodes(R"({{#loop hello h}}{{h}} {{name}}!
+        auto nodes = parseNodes(lexer, R"({{#loop hello h}}{{h}} {{name}}!
 {{#loop bottles count}}{{count}} bottles on the wall, take one out, pass it around,
 {{/loop}}
 {{/loop}}
@@ -356,7 +368,7 @@ TEST_CASE("Renderer", "[renderer]")
         auto renderer = Renderer(symbols, rangeSymbols, dump, error);
         for (auto const &n : nodes)
         {
-            n->accept(renderer);
+            n.accept(renderer);
         }
 
         expectedError = "";
@@ -377,4 +389,327 @@ nihao Aragorn!
     }
 }
 
+namespace
+{
+
+bool renderIfNe(const BlockNode &, BlockScope &scope)
+{
+    if (scope.Value(0) != scope.Value(1))
+    {
+        scope.RenderChildren();
+    }
+    return true;
+}
+
+bool renderTwice(const BlockNode &node, BlockScope &scope)
+{
+    if (node.Children().size() > 2)
+    {
+        scope.Error() << "Too many children." << std::endl;
+        return false;
+    }
+
+    scope.Output() << "<";
+    scope.RenderChildren();
+    scope.RenderChildren();
+    return true;
+}
+
+bool renderCount(const BlockNode &, BlockScope &scope)
+{
+    static auto count = 0;
+    scope.Output() << count++;
+    return true;
+}
+
+} // namespace
+
+TEST_CASE("Renderer registered blocks", "[renderer]")
+{
+    std::stringstream dump;
+    std::stringstream error;
+    auto symbols = std::unordered_map<std::string, std::string>({{"x", "X"}, {"y", "Y"}});
+    auto rangeSymbols = std::unordered_map<std::string, std::vector<std::string>>({{"xs", {"1", "2"}}});
+    BlockRegistry blocks;
+    const auto &ifne = *blocks.Register(BlockType{"ifne", 2, nullptr, renderIfNe});
+    const auto &twice = *blocks.Register(BlockType{"twice", 0, nullptr, renderTwice});
+    const auto &plain = *blocks.Register(BlockType{"plain", 1, nullptr, nullptr});
+    std::string expectedDump;
+    std::string expectedError;
+
+    SECTION("Render hooks")
+    {
+        auto nodes = Ast();
+        nodes.OpenBlock(ifne, "x", "y");
+        nodes.OpenBlock(twice);
+        nodes.OpenLoop("xs", "e");
+        nodes.AddPrint("e", Context(0, 1));
+        nodes.Close(Context(0, 1));
+        nodes.AddText("-", Context(0, 1));
+        nodes.Close(Context(0, 1));
+        nodes.Close(Context(0, 1));
+        nodes.OpenBlock(ifne, "x", "x");
+        nodes.AddText("never", Context(0, 1));
+        nodes.Close(Context(0, 1));
+        nodes.OpenBlock(plain, "y");
+        nodes.AddPrint("y", Context(0, 1));
+        nodes.Close(Context(0, 1));
+
+        auto renderer = Renderer(symbols, rangeSymbols, dump, error);
+        for (auto const &n : nodes)
+        {
+            n.accept(renderer);
+        }
+
+        expectedDump = "<12-12-Y";
+        ASSERT_RESULTS()
+    }
+
+    SECTION("Hook error")
+    {
+        auto nodes = Ast();
+        nodes.OpenBlock(twice);
+        nodes.AddText("a", Context(0, 1));
+        nodes.AddText("b", Context(0, 1));
+        nodes.AddText("c", Context(0, 1));
+        nodes.Close(Context(0, 1));
+
+        auto renderer = Renderer(symbols, rangeSymbols, dump, error);
+        for (auto const &n : nodes)
+        {
+            n.accept(renderer);
+        }
+
+        REQUIRE(renderer.HasError());
+        expectedError = "Too many children.\n";
+        ASSERT_RESULTS()
+    }
+
+    SECTION("Symbol not found")
+    {
+        auto nodes = Ast();
+        nodes.OpenBlock(ifne, "x", "z");
+        nodes.AddText("a", Context(0, 1));
+        nodes.Close(Context(0, 1));
+
+        auto renderer = Renderer(symbols, rangeSymbols, dump, error);
+        for (auto const &n : nodes)
+        {
+            n.accept(renderer);
+        }
+
+        expectedError = "Symbol not found: `z`\n";
+        ASSERT_RESULTS()
+    }
+}
+
+TEST_CASE("Renderer loop invariants", "[renderer]")
+{
+    // Errors are written to the output to check that they follow the output rendered before them.
+    std::stringstream dump;
+    auto symbols = std::unordered_map<std::string, std::string>({{"x", "X"}, {"y", "Y"}});
+    auto rangeSymbols = std::unordered_map<std::string, std::vector<std::string>>(
+        {{"xs", {"1", "2", "3"}}, {"ys", {"a", "b"}}, {"one", {"!"}}});
+    auto lexer = Lexer();
+
+    // Templates are not checked by the parser, they fail while rendering.
+    auto parse = [&](const std::string &text) {
+        std::stringstream input(text);
+        std::stringstream error;
+        auto tokens = std::vector<Token>();
+        auto nodes = Ast();
+        lexer.lex(input, tokens, error);
+        Parser(ParserOptions()).parse(tokens, nodes, error);
+        REQUIRE(error.str() == "");
+        return nodes;
+    };
+
+    auto render = [&](const Ast &nodes) {
+        dump.str(std::string());
+        auto renderer = Renderer(symbols, rangeSymbols, dump, dump);
+        for (auto const &n : nodes)
+        {
+            n.accept(renderer);
+        }
+        return dump.str();
+    };
+
+    SECTION("Invariant runs")
+    {
+        auto nodes = parse("{{#loop xs e}}{{e}} {{x}}{{#ifeq x y}}never{{/ifeq}}{{#ifeq x x}}{{y}}{{/ifeq}};{{/loop}}");
+        REQUIRE(render(nodes) == "1 XY;2 XY;3 XY;");
+
+        nodes = parse("{{#loop xs e}}{{#loop ys f}}{{e}}{{f}}{{x}}.{{/loop}}{{#loop ys f}}{{f}}{{x}}{{/loop}}|{{/loop}}");
+        REQUIRE(render(nodes) == "1aX.1bX.aXbX|2aX.2bX.aXbX|3aX.3bX.aXbX|");
+
+        nodes = parse("{{#loop one e}}{{x}}{{y}}{{/loop}}{{#loop xs e}}{{#loop one f}}{{e}}{{f}}{{/loop}}{{/loop}}");
+        REQUIRE(render(nodes) == "XY1!2!3!");
+    }
+
+    SECTION("Errors")
+    {
+        auto nodes = parse("{{#loop xs e}}{{e}}-{{#ifeq x y}}.{{/ifeq}}{{#ifeq x z}}.{{/ifeq}}{{/loop}}");
+        REQUIRE(render(nodes) == "1-Symbol not found: `z`\n");
+
+        nodes = parse("{{#loop xs e}}{{e}}{{x}}{{#loop ys e}}{{x}}{{/loop}}{{/loop}}");
+        REQUIRE(render(nodes) == "1XSymbol names must be unique across the program, redefined `e` at [32, 52)\n");
+    }
+
+    SECTION("Render hooks")
+    {
+        BlockRegistry blocks;
+        const auto &count = *blocks.Register(BlockType{"count", 0, nullptr, renderCount});
+        auto nodes = Ast();
+        nodes.OpenLoop("xs", "e");
+        nodes.AddText("<", Context(0, 1));
+        nodes.OpenBlock(count);
+        nodes.Close(Context(0, 1));
+        nodes.AddText(">", Context(0, 1));
+        nodes.Close(Context(0, 1));
+
+        const auto rendered = render(nodes);
+        REQUIRE(rendered.size() == 9);
+        REQUIRE(rendered[1] != rendered[4]);
+    }
+
+    SECTION("Deep nesting")
+    {
+        // The outer loop captures the loops it contains, which are rendered on the stack of frames.
+        const auto depth = 100000;
+        auto input = std::string("{{#loop ys e}}");
+        for (auto i = 0; i < depth; i++)
+        {
+            input += "{{#loop one e" + std::to_string(i) + "}}{{x}}";
+        }
+        for (auto i = 0; i < depth; i++)
+        {
+            input += "{{/loop}}";
+        }
+        input += "{{/loop}}";
+
+        auto nodes = parse(input);
+        REQUIRE(render(nodes) == std::string(2 * depth, 'X'));
+    }
+}
+
+TEST_CASE("Renderer slots", "[renderer]")
+{
+    std::stringstream dump;
+    auto symbols = std::unordered_map<std::string, std::string>({{"x", "X"}, {"y", "Y"}});
+    auto rangeSymbols = std::unordered_map<std::string, std::vector<std::string>>({{"xs", {"1", "2", "3"}}});
+    auto lexer = Lexer();
+
+    auto parse = [&](const std::string &text) {
+        std::stringstream input(text);
+        std::stringstream error;
+        auto tokens = std::vector<Token>();
+        auto nodes = Ast();
+        lexer.lex(input, tokens, error);
+        Parser(ParserOptions()).parse(tokens, nodes, error);
+        REQUIRE(error.str() == "");
+        return nodes;
+    };
+
+    auto render = [&](const Ast &nodes, const Slots &slots) {
+        dump.str(std::string());
+        auto renderer = Renderer(slots, dump, dump);
+        for (auto const &n : nodes)
+        {
+            n.accept(renderer);
+        }
+        return dump.str();
+    };
+
+    SECTION("Resolved")
+    {
+        auto nodes = parse("{{x}}{{#loop xs e}}{{e}}{{#ifeq e y}}!{{/ifeq}}{{#ifeq x x}}{{y}}{{/ifeq}}{{/loop}}{{x}}");
+        REQUIRE(render(nodes, Slots(nodes, symbols, rangeSymbols)) == "X1Y2Y3YX");
+
+        // Elements are unbound after their loop.
+        nodes = parse("{{#loop xs e}}{{e}}{{/loop}}{{#loop xs e}}{{e}}{{/loop}}{{e}}");
+        REQUIRE(render(nodes, Slots(nodes, symbols, rangeSymbols)) == "123123Symbol not found: `e`\n");
+    }
+
+    SECTION("Errors")
+    {
+        auto nodes = parse("{{x}}{{z}}");
+        REQUIRE(render(nodes, Slots(nodes, symbols, rangeSymbols)) == "XSymbol not found: `z`\n");
+
+        nodes = parse("{{#loop ys e}}{{e}}{{/loop}}");
+        REQUIRE(render(nodes, Slots(nodes, symbols, rangeSymbols)) == "Range symbol not found: `ys`\n");
+
+        nodes = parse("{{#loop xs x}}{{x}}{{/loop}}");
+        REQUIRE(render(nodes, Slots(nodes, symbols, rangeSymbols)) ==
+                "Symbol names must be unique across the program, redefined `x` at [8, 28)\n");
+    }
+
+    SECTION("Bind")
+    {
+        auto nodes = parse("{{#loop xs e}}{{e}}{{x}}{{/loop}}{{#ifeq x y}}={{/ifeq}}");
+        auto slots = Slots(nodes, symbols, rangeSymbols);
+        const auto &names = nodes.Names();
+
+        const auto value = std::string("Y");
+        const auto range = std::vector<std::string>({"a", "b"});
+        slots.Bind(names.Find("x"), &value);
+        slots.BindRange(names.Find("xs"), &range);
+        REQUIRE(render(nodes, slots) == "aYbY=");
+
+        slots.Bind(names.Find("y"), nullptr);
+        REQUIRE(render(nodes, slots) == "aYbYSymbol not found: `y`\n");
+    }
+}
+
+TEST_CASE("Renderer deep nesting", "[renderer]")
+{
+    std::stringstream dump;
+    std::stringstream error;
+    auto symbols = std::unordered_map<std::string, std::string>();
+    auto rangeSymbols = std::unordered_map<std::string, std::vector<std::string>>();
+    auto lexer = Lexer();
+    const auto depth = 100000;
+
+    symbols["x"] = "X";
+    rangeSymbols["xs"] = {"1", "2"};
+
+    auto input = std::string();
+    for (auto i = 0; i < depth; i++)
+    {
+        input += "{{#ifeq x x}}";
+    }
+    input += "{{#loop xs e}}{{e}}{{/loop}}";
+    for (auto i = 0; i < depth; i++)
+    {
+        input += "{{/ifeq}}";
+    }
+
+    SECTION("Rendered")
+    {
+        auto nodes = parseNodes(lexer, input, symbols, rangeSymbols);
+        auto renderer = Renderer(symbols, rangeSymbols, dump, error);
+        for (auto const &n : nodes)
+        {
+            n.accept(renderer);
+        }
+
+        REQUIRE(error.str().size() == 0);
+        REQUIRE(dump.str() == "12");
+    }
+
+    SECTION("Error")
+    {
+        auto nodes = parseNodes(lexer, input, symbols, rangeSymbols);
+        rangeSymbols.erase("xs");
+        auto renderer = Renderer(symbols, rangeSymbols, dump, error);
+        for (auto const &n : nodes)
+        {
+            n.accept(renderer);
+        }
+
+        REQUIRE(renderer.HasError());
+        REQUIRE(error.str() == "Range symbol not found: `xs`\n");
+        REQUIRE(dump.str().size() == 0);
+    }
+}
+
 } // namespace car
\ No newline at end of file
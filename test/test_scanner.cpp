@@ -0,0 +1,93 @@
+#include "catch.hpp"
+
+#include <string>
+#include <vector>
+#include "scanner.hpp"
+
+using car::scanner::Find;
+using car::scanner::FindPair;
+using car::scanner::Isa;
+using car::scanner::IsSupported;
+
+namespace car
+{
+
+TEST_CASE("scanner::Find", "[scanner]")
+{
+    auto isas = std::vector<Isa>();
+    for (auto isa : {Isa::Scalar, Isa::SSE2, Isa::AVX2})
+    {
+        if (IsSupported(isa))
+        {
+            isas.push_back(isa);
+        }
+    }
+    REQUIRE(isas.size() > 0);
+
+    SECTION("Empty")
+    {
+        std::string input;
+        for (auto isa : isas)
+        {
+            REQUIRE(Find(input.data(), input.data(), '{', isa) == input.data());
+        }
+    }
+
+    SECTION("Not found")
+    {
+        std::string input(100, 'x');
+        for (auto isa : isas)
+        {
+            REQUIRE(Find(input.data(), input.data() + input.size(), '{', isa) == input.data() + input.size());
+        }
+    }
+
+    SECTION("Every position")
+    {
+        for (auto isa : isas)
+        {
+            for (size_t size = 1; size < 100; size++)
+            {
+                for (size_t pos = 0; pos < size; pos++)
+                {
+                    std::string input(size, 'x');
+                    input[pos] = '{';
+                    input[size - 1] = '{';
+                    REQUIRE(Find(input.data(), input.data() + size, '{', isa) == input.data() + pos);
+                }
+            }
+        }
+    }
+
+    SECTION("Unaligned start and high bytes")
+    {
+        std::string input(80, '\xfb');
+        input[70] = '{';
+        for (auto isa : isas)
+        {
+            for (size_t start = 0; start <= 70; start++)
+            {
+                REQUIRE(Find(input.data() + start, input.data() + input.size(), '{', isa) == input.data() + 70);
+            }
+        }
+    }
+
+    SECTION("Best")
+    {
+        std::string input = "lorem ipsum dolor sit amet, consectetur adipiscing elit {{x}}";
+        REQUIRE(IsSupported(car::scanner::BestIsa()));
+        REQUIRE(Find(input.data(), input.data() + input.size(), '{') == input.data() + input.find('{'));
+    }
+}
+
+TEST_CASE("scanner::FindPair", "[scanner]")
+{
+    for (const auto &text : std::vector<std::string>{"", "{", "}}", "x{y{z{", "abc{{d", "{{", "{x{{", "{{{", std::string(100, 'x') + "{{"})
+    {
+        auto pos = text.find("{{");
+        auto expected = pos == std::string::npos ? text.data() + text.size() : text.data() + pos;
+        REQUIRE(FindPair(text.data(), text.data() + text.size(), '{', '{') == expected);
+    }
+}
+
+} // namespace car
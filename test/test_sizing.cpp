@@ -0,0 +1,192 @@
+#include "catch.hpp"
+
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "lexer.hpp"
+#include "parser.hpp"
+#include "renderer.hpp"
+#include "sizing.hpp"
+
+using car::lexer::Lexer;
+using car::lexer::Token;
+using car::parser::Ast;
+using car::parser::BlockNode;
+using car::parser::BlockRegistry;
+using car::parser::BlockScope;
+using car::parser::BlockType;
+using car::parser::Parser;
+using car::parser::ParserOptions;
+using car::renderer::Slots;
+using car::sizing::Accuracy;
+using car::sizing::Size;
+using car::sizing::SizeFormula;
+using car::sizing::StringBuffer;
+
+namespace car
+{
+
+namespace
+{
+
+bool renderTwice(const BlockNode &, BlockScope &scope)
+{
+    scope.RenderChildren();
+    scope.RenderChildren();
+    return true;
+}
+
+const auto symbols = std::unordered_map<std::string, std::string>({
+    {"name", "Aragorn"},
+    {"greeting", "Hi"},
+    {"favorite", "bb"},
+});
+
+const auto rangeSymbols = std::unordered_map<std::string, std::vector<std::string>>({
+    {"items", {"a", "bb", "ccc"}},
+    {"rows", {"1", "22"}},
+    {"empty", {}},
+});
+
+Ast parseTemplate(const std::string &text, const BlockRegistry &blocks)
+{
+    std::stringstream error;
+    auto tokens = std::vector<Token>();
+    auto nodes = Ast();
+    REQUIRE(Lexer().lex(text.data(), text.data() + text.size(), tokens, error));
+    REQUIRE(Parser(ParserOptions({}, blocks)).parse(tokens, nodes, error));
+    return nodes;
+}
+
+/**
+* Evaluates the size of `text` and renders it, the output is returned in `output`.
+*/
+Size measure(const std::string &text, const BlockRegistry &blocks, std::string &output)
+{
+    const auto nodes = parseTemplate(text, blocks);
+    const auto formula = SizeFormula(nodes);
+    const auto slots = Slots(nodes, symbols, rangeSymbols);
+    std::stringstream error;
+    car::sizing::Render(nodes, formula, slots, output, error);
+    return formula.Evaluate(slots);
+}
+
+} // namespace
+
+TEST_CASE("SizeFormula", "[sizing]")
+{
+    BlockRegistry blocks;
+    blocks.Register(BlockType{"twice", 0, nullptr, renderTwice});
+    blocks.Register(BlockType{"with", 1, nullptr, nullptr});
+    auto output = std::string();
+
+    SECTION("Exact")
+    {
+        const auto templates = std::vector<std::string>({
+            "",
+            "Hello {{name}}, {{greeting}} {{name}}!",
+            "{{#loop items item}}<{{item}} {{name}}>{{/loop}}",
+            "{{#loop rows row}}{{#loop items item}}{{row}}{{item}}.{{/loop}}{{row}}{{/loop}}",
+            "{{#ifeq name name}}same{{/ifeq}}{{#ifeq name favorite}}other{{/ifeq}}",
+            "{{#loop items item}}{{#ifeq name greeting}}{{item}}{{/ifeq}}{{#ifeq name name}}{{item}}!{{/ifeq}}{{/loop}}",
+            "{{#loop empty e}}never{{/loop}}",
+            "{{#loop items item}}{{#with item}}[{{item}}]{{/with}}{{/loop}}{{#with name}}{{name}}{{/with}}",
+        });
+        for (const auto &text : templates)
+        {
+            const auto size = measure(text, blocks, output);
+            INFO(text);
+            REQUIRE(size.accuracy == Accuracy::Exact);
+            REQUIRE(size.bytes == output.size());
+        }
+    }
+
+    SECTION("Upper bound")
+    {
+        // Ifeqs on elements are counted for each value.
+        auto size = measure("{{#loop items item}}{{item}}{{#ifeq item favorite}} very much{{/ifeq}}{{/loop}}", blocks, output);
+        REQUIRE(output == "abb very muchccc");
+        REQUIRE(size.bytes == 6 + 3 * 10);
+        REQUIRE(size.accuracy == Accuracy::UpperBound);
+
+        // Rendering stops at errors.
+        size = measure("a{{missing}}bc", blocks, output);
+        REQUIRE(output == "a");
+        REQUIRE(size.bytes == 3);
+        REQUIRE(size.accuracy == Accuracy::UpperBound);
+
+        size = measure("a{{#loop items name}}.{{/loop}}{{#loop missing e}}.{{/loop}}{{#ifeq name missing}}.{{/ifeq}}", blocks, output);
+        REQUIRE(output == "a");
+        REQUIRE(size.bytes == 1);
+        REQUIRE(size.accuracy == Accuracy::UpperBound);
+
+        size = measure("{{#loop items e}}{{#loop rows e}}{{e}}{{/loop}}{{/loop}}", blocks, output);
+        REQUIRE(output == "");
+        REQUIRE(size.bytes == 0);
+        REQUIRE(size.accuracy == Accuracy::UpperBound);
+    }
+
+    SECTION("Estimate")
+    {
+        // Hooks decide how often the children are rendered, they are counted once.
+        const auto size = measure("{{#twice}}{{name}}{{/twice}}", blocks, output);
+        REQUIRE(output == "AragornAragorn");
+        REQUIRE(size.bytes == 7);
+        REQUIRE(size.accuracy == Accuracy::Estimate);
+    }
+
+    SECTION("Single allocation")
+    {
+        auto range = std::vector<std::string>();
+        for (auto i = 0; i < 10000; i++)
+        {
+            range.push_back(std::to_string(i));
+        }
+        const auto nodes = parseTemplate("{{#loop rows row}}Row {{row}} of {{name}}\n{{/loop}}", blocks);
+        const auto formula = SizeFormula(nodes);
+        auto slots = Slots(nodes, symbols, rangeSymbols);
+        slots.BindRange(nodes.Names().Find("rows"), &range);
+        const auto size = formula.Evaluate(slots);
+
+        auto reserved = std::string();
+        reserved.reserve(size.bytes);
+        std::stringstream error;
+        REQUIRE(car::sizing::Render(nodes, formula, slots, output, error));
+        REQUIRE(size.accuracy == Accuracy::Exact);
+        REQUIRE(output.size() == size.bytes);
+        REQUIRE(output.capacity() == reserved.capacity());
+    }
+
+    SECTION("Deep nesting")
+    {
+        const auto depth = 100000;
+        auto input = std::string();
+        for (auto i = 0; i < depth; i++)
+        {
+            input += "{{#ifeq name name}}";
+        }
+        input += "{{#loop items item}}{{item}}{{/loop}}";
+        for (auto i = 0; i < depth; i++)
+        {
+            input += "{{/ifeq}}";
+        }
+
+        const auto size = measure(input, blocks, output);
+        REQUIRE(output == "abbccc");
+        REQUIRE(size.bytes == 6);
+        REQUIRE(size.accuracy == Accuracy::Exact);
+    }
+}
+
+TEST_CASE("StringBuffer", "[sizing]")
+{
+    auto text = std::string("> ");
+    StringBuffer buffer(text);
+    std::ostream stream(&buffer);
+    stream << "Hello " << 'w' << "orld" << std::string(", ") << 42;
+    REQUIRE(text == "> Hello world, 42");
+}
+
+} // namespace car